@@ -25,29 +25,41 @@ static constexpr storage::page_off_t INDEX_PAGE_DATA_OFFSET =
     INDEX_PAGE_HDR_LEN;
 static constexpr storage::page_off_t INDEX_PAGE_FIRST_RECORD_OFFSET =
     INDEX_PAGE_DATA_OFFSET + INFI_SUPRE_LEN;
-#ifdef DEBUG
-static constexpr size_t MAX_NUMBER_OF_RECORDS_PER_PAGE = 16;
-#else
-static constexpr size_t MAX_NUMBER_OF_RECORDS_PER_PAGE = 32;
-#endif // DEBUG
-static constexpr int max_number_of_records() {
-    return config::MAX_NUMBER_OF_RECORDS_PER_PAGE;
-}
-static constexpr int min_number_of_records() {
-    return config::MAX_NUMBER_OF_RECORDS_PER_PAGE / 2;
-}
-
-// NOTE: in this implementation, the number of records == the number of
-// childs.
-static constexpr int max_number_of_childs() {
-    return max_number_of_records() + 1;
-}
-static constexpr int min_number_of_childs() {
-    return min_number_of_records() + 1;
-}
+// the percentage of an index page filled before it splits. the rest is left
+// for the records to grow in place and for the keys of the child splits.
+static constexpr size_t INDEX_PAGE_FILL_FACTOR = 90;
+// the memory for the rows of an index build sorted in memory, past which the
+// sorted runs spill into run files, see IndexBuilder.
+static constexpr size_t INDEX_BUILD_MEMORY = size_t(64) << 20;
+// the number of threads sorting the runs of an index build.
+static constexpr size_t INDEX_BUILD_THREADS = 4;
+// the default number of records an IndexIterator reads per descent.
+static constexpr size_t INDEX_SCAN_BATCH = 256;
+// the max number of pages of a level Index::multi_get() prefetches at once,
+// and a quarter of the pool at most.
+static constexpr size_t INDEX_MULTI_GET_WINDOW = 64;
 
 // buffer pool specs
 constexpr size_t DEFAULT_POOL_SIZE = 300;
+// the max number of frames retired in one step when the pool shrinks.
+constexpr size_t POOL_SHRINK_BATCH = 16;
+// the number of per-thread shards of the buffer pool statistics.
+constexpr size_t POOL_STATS_SHARDS = 8;
+// the default share of the pool for protected frames, which ordinary
+// replacement never evicts.
+constexpr size_t PROTECTED_POOL_SHARE_PERCENT = 25;
+// the number of upper levels of an index kept resident in the protected
+// frames; internal levels only, and up to the protected budget.
+constexpr int PINNED_INDEX_LEVELS = 8;
+// the number of pages loaded under one latch hold when warming the pool up.
+constexpr size_t WARM_UP_BATCH = 256;
+// the max number of consecutive pages read in one disk read.
+constexpr size_t MAX_READ_RUN = 64;
+// the number of per-thread shards of the reader counts guarding frames from
+// reclamation.
+constexpr size_t POOL_READER_SHARDS = 8;
+// the number of direct-mapped slots for swizzled child references per frame.
+constexpr size_t SWIZZLE_SLOTS = 64;
 
 } // namespace config
 
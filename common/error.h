@@ -16,6 +16,8 @@ enum class ErrorCode : size_t {
     KeyNotPinned,
     KeyAlreadyPinned,
     InvalidInsertPos,
+    // a bulk load into an index holding records already.
+    IndexNotEmpty,
 
     DiskWriteError,
     DiskReadError,
@@ -23,6 +25,8 @@ enum class ErrorCode : size_t {
     DiskWriteOverflow,
 
     FrameNotPinned,
+    // a frame is pinned where it must not be.
+    FramePinned,
 
     // cache error
     CacheNoMoreVictim,
@@ -37,11 +41,17 @@ enum class ErrorCode : size_t {
     PoolNoFreeFrame,
     DeletedPageNotExist,
     GetRootParent,
+    InvalidPoolSize,
+    PoolProtectedFull,
 
     // node error
     NodeNotFull,
+    // the page has no room for a record, even after a split.
+    NodeFull,
     PopEmptyNode,
     RootHeightDecrease,
+    // an optimistic read went invalid, restart it.
+    ReadConflict,
 
     UnknownException,
 };
@@ -63,11 +73,12 @@ private:
             "KeyAlreadyExist", "InvalidKeyType",
 
             "KeyNotPinned", "KeyAlreadyPinned", "InvalidInsertPos",
+            "IndexNotEmpty",
 
             "DiskWriteError", "DiskReadError", "DiskReadOverflow",
             "DiskWriteOverflow",
 
-            "FrameNotPinned",
+            "FrameNotPinned", "FramePinned",
 
             // cache error
             "CacheNoMoreVictim", "CacheEntryNotFound",
@@ -77,8 +88,9 @@ private:
 
             // pool error
             "PoolNoFreeFrame", "DeletedPageNotExist", "GetRootParent",
-            "NodeNotFull", "PopEmptyNode", "RootHeightDecrease",
-            "UnknownException"};
+            "InvalidPoolSize", "PoolProtectedFull",
+            "NodeNotFull", "NodeFull", "PopEmptyNode", "RootHeightDecrease",
+            "ReadConflict", "UnknownException"};
 };
 
 // class MyException : public std::runtime_error {
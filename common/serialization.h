@@ -3,6 +3,7 @@
 
 #include "error.h"
 #include "indexer.h"
+#include "types.h"
 #include <cereal/archives/binary.hpp>
 #include <iostream>
 #include <istream>
@@ -32,6 +33,19 @@ std::ostream &operator<<(std::ostream &os,
     return os;
 }
 
+inline std::ostream &operator<<(std::ostream &os, const CompositeKey &key) {
+    os << "(";
+    for (size_t i = 0; i < key.columns.size(); i++) {
+        if (i != 0)
+            os << ", ";
+        os << key.columns[i];
+        if (key.orders[i] == KeyOrder::Desc)
+            os << " desc";
+    }
+    os << ")";
+    return os;
+}
+
 // print error
 inline std::ostream &operator<<(std::ostream &os, ErrorCode ec) {
     os << ErrorHandler::print_error(ec);
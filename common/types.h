@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <functional>
 #include <string>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -18,6 +19,10 @@ using index_t = uint8_t;
 using frame_id_t = size_t;
 // type for page number
 using page_id_t = uint32_t;
+// type for the database files served by a buffer pool
+using file_id_t = uint32_t;
+// type for a page of any file served by a buffer pool, see make_page_key().
+using page_key_t = uint64_t;
 // page offset in bytes
 using page_off_t = uint32_t;
 // type for record number in a page
@@ -27,7 +32,7 @@ using index_id_t = uint8_t;
 using key_t = uint8_t;
 using value_t = uint8_t;
 using record_t = uint8_t;
-enum class KeyType : key_t { Int = 0, Double, String };
+enum class KeyType : key_t { Int = 0, Double, String, Composite };
 enum class ValueType : value_t { Int = 0, Double, String, Bool };
 
 enum class RecordType : record_t { Infi, Supre, Leaf, Internal };
@@ -36,7 +41,38 @@ enum class RecordType : record_t { Infi, Supre, Leaf, Internal };
 // std::string, Record*.
 // NOTE: any is a dressed-up void*. variant is a dressed-up
 // union any cannot store non-copy or non-move able types. variant can.
-using Key = std::variant<int, double, std::string>;
+// a column of a composite key.
+using KeyColumn = std::variant<int, double, std::string>;
+// the sort order of a column of a composite key.
+enum class KeyOrder : uint8_t { Asc = 0, Desc };
+
+// CompositeKey is a key of several columns, ordered by its first column, then
+// by the second one and so on, every column in its own order.
+// NOTE: a key of the first columns of another key is a prefix of it, and
+// ordered before every key it's a prefix of, see NormalizedKey.
+struct CompositeKey {
+    std::vector<KeyColumn> columns;
+    // the order of every column.
+    std::vector<KeyOrder> orders;
+
+    CompositeKey() = default;
+    // the key of @columns, ascending unless @orders tells otherwise.
+    explicit CompositeKey(std::vector<KeyColumn> columns,
+                          std::vector<KeyOrder> orders = {})
+        : columns(std::move(columns)), orders(std::move(orders)) {
+        this->orders.resize(this->columns.size(), KeyOrder::Asc);
+    }
+
+    template <class Archive>
+    void serialize(Archive &archive) {
+        archive(columns, orders);
+    }
+
+    friend bool operator==(const CompositeKey &lhs,
+                           const CompositeKey &rhs) = default;
+};
+
+using Key = std::variant<int, double, std::string, CompositeKey>;
 using Value = std::variant<bool, int, double, std::string>;
 using Column = std::vector<Value>;
 using Comparator = std::function<int(const Value &, const Value &)>;
@@ -2,57 +2,148 @@
 #define STORAGE_INCLUDE_BUFFER_BUFFER_POOL_H
 
 #include "buffer/frame.h"
+#include "buffer/free_list.h"
 #include "buffer/lru_cache.h"
+#include "buffer/pool_stats.h"
+#include "buffer/secondary_cache.h"
 #include "error.h"
 #include "log.h"
 #include "noncopyable.h"
 #include "tl/expected.hpp"
 #include "types.h"
+#include <array>
 #include <cstddef>
+#include <deque>
 #include <format>
 #include <functional>
-#include <list>
+#include <atomic>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
 // #include <memory>
 namespace storage {
 
 class DiskManager;
 class Frame;
+class WriteScope;
+class ReadGuard;
 
 class BufferPoolManager : NonCopyable {
 public:
     using TraverseFunc = std::function<ErrorCode(Frame *)>;
 
 public:
-    BufferPoolManager(size_t pool_size,
-                      std::shared_ptr<DiskManager> disk_manager)
-        : pool_size_(pool_size), pool_(), cache_(pool_size),
-          disk_manager_(std::move(disk_manager)) {
-        pool_.reserve(pool_size_);
+    // a pool serving no file yet, see add_file().
+    explicit BufferPoolManager(size_t pool_size)
+        : pool_size_(pool_size), pool_(), retired_from_(pool_size),
+          cache_(pool_size),
+          protected_budget_(pool_size *
+                            config::PROTECTED_POOL_SHARE_PERCENT / 100) {
+        free_list_.reserve(pool_size_);
         for (size_t i = 0; i < pool_size_; i++) {
-            pool_.push_back(Frame(this, i));
+            pool_.emplace_back(this, i);
             free_list_.push_back(i);
         }
     }
 
+    // a pool serving @disk_manager as its file 0.
+    BufferPoolManager(size_t pool_size,
+                      std::shared_ptr<DiskManager> disk_manager)
+        : BufferPoolManager(pool_size) {
+        add_file(std::move(disk_manager));
+    }
+
     ~BufferPoolManager() { // page_table_.clear();
+        stop_warm_up_ = true;
+        if (warm_up_thread_.joinable())
+            warm_up_thread_.join();
+        if (!dump_file_.empty())
+            dump_resident(dump_file_);
+
+        // write back before the disk manager goes away.
+        flush_all();
         free_list_.clear();
     }
 
+    // the process-wide pool shared by all the indices by default, of
+    // config::DEFAULT_POOL_SIZE frames.
+    static std::shared_ptr<BufferPoolManager> shared();
+
+    // serve the pages of one more database file, return its file id.
+    // NOTE: file ids are never reused.
+    file_id_t add_file(std::shared_ptr<DiskManager> disk_manager);
+    // write back and drop all the pages of the file, and stop serving it.
+    // if some page of the file is pinned, return FramePinned error, and if a
+    // page fails to be written back, its error: the file is left served and
+    // its pages cached then.
+    ErrorCode remove_file(file_id_t file);
+
+    // keep at least @frames frames for the pages of @file: while the file
+    // holds no more frames than that, ordinary replacement prefers frames of
+    // other files. 0 to drop the reservation.
+    ErrorCode reserve(file_id_t file, size_t frames);
+    // the number of frames holding pages of @file.
+    size_t resident_size(file_id_t file) const;
+
     // get an existing page from the disk file and put into the buffer.
-    tl::expected<Frame *, ErrorCode> get_frame(page_id_t pgno);
+    tl::expected<Frame *, ErrorCode> get_frame(file_id_t file,
+                                               page_id_t pgno);
+    // get a page of the file 0.
+    tl::expected<Frame *, ErrorCode> get_frame(page_id_t pgno) {
+        return get_frame(0, pgno);
+    }
+
+    // get the child page @pgno of @parent, following the swizzled reference
+    // of @parent if the child is resident: no page table lookup nor LRU
+    // update then. otherwise get it as get_frame() does and swizzle it.
+    // NOTE: for optimistic readers only, the caller must validate the child.
+    tl::expected<Frame *, ErrorCode> get_child_frame(Frame *parent,
+                                                     page_id_t pgno);
+
+    // reference @root from @ref directly, like a swizzled child without a
+    // parent frame; @ref gets cleared once the frame is evicted.
+    // nullptr to drop the reference.
+    void swizzle_root(std::atomic<Frame *> &ref, Frame *root) {
+        std::scoped_lock lock(latch_);
+        Frame::swizzle_root(ref, root);
+    }
 
     // create a new page in the file and put it into the buffer.
     // if the file has free pages, pick and use one; else, extends  the file.
     // every new page allocated is marked dirty.
-    tl::expected<Frame *, ErrorCode> allocate_frame();
+    tl::expected<Frame *, ErrorCode> allocate_frame(file_id_t file);
+    // create a new page in the file 0.
+    tl::expected<Frame *, ErrorCode> allocate_frame() {
+        return allocate_frame(0);
+    }
 
     // dispose a page and set it free.
     ErrorCode remove_frame(Frame *frame);
 
     // pin an in-use page so that it can't get page-out.
-    ErrorCode pin_frame(page_id_t pgno);
+    ErrorCode pin_frame(file_id_t file, page_id_t pgno);
+    ErrorCode pin_frame(page_id_t pgno) { return pin_frame(0, pgno); }
     // unpin an in-use page so that it can get page-out.
-    ErrorCode unpin_frame(page_id_t pgno);
+    ErrorCode unpin_frame(file_id_t file, page_id_t pgno);
+    ErrorCode unpin_frame(page_id_t pgno) { return unpin_frame(0, pgno); }
+
+    // move the frame into the protected region of the pool so that ordinary
+    // replacement never evicts it.
+    // if the protected region is full, return PoolProtectedFull error.
+    ErrorCode protect_frame(Frame *frame);
+    // give the frame back to ordinary replacement.
+    ErrorCode unprotect_frame(Frame *frame);
+    // the max number of protected frames.
+    void set_protected_budget(size_t frames) {
+        std::scoped_lock lock(latch_);
+        protected_budget_ = frames;
+    }
+    size_t protected_size() const {
+        std::scoped_lock lock(latch_);
+        return cache_.protected_size();
+    }
 
     // flush the dirty page, if not dirty, do nothing.
     ErrorCode flush_frame(Frame *frame);
@@ -63,25 +154,224 @@ public:
     ErrorCode for_each(const TraverseFunc &func);
     // Frame **pool() { return pool_.get(); }
 
+    // change the number of frames while the pool keeps serving.
+    // growing takes effect at once; shrinking only sets the target size and
+    // retires frames from the tail of the pool gradually, at most
+    // config::POOL_SHRINK_BATCH frames per step, flushing dirty ones first.
+    // a pinned frame holds the shrinking back until it gets unpinned.
+    ErrorCode resize(size_t pool_size);
+
+    // the number of frames currently serving the pool.
+    size_t size() const {
+        std::scoped_lock lock(latch_);
+        return retired_from_;
+    }
+
+    // the size the pool is growing or shrinking to.
+    size_t target_size() const {
+        std::scoped_lock lock(latch_);
+        return pool_size_;
+    }
+
+    // write the keys of all cached pages, see make_page_key(), from the
+    // hottest to the coldest, into the file @path. the files are named by
+    // their paths, so that the dump survives the files being added in
+    // another order.
+    ErrorCode dump_resident(const std::string &path) const;
+    // dump the cached pages into @path when the pool shuts down.
+    void set_dump_file(const std::string &path) { dump_file_ = path; }
+
+    // reload the pages listed in the dump file @path into free frames only,
+    // from the hottest to the coldest, config::WARM_UP_BATCH pages a time with
+    // each batch read by sorted runs of consecutive pages. the latch is
+    // released between batches so that the pool keeps serving meanwhile.
+    // the LRU order of the dump is kept: every page warmed up is colder than
+    // any page cached before. the pages of files not served by the pool are
+    // skipped, and a dump that doesn't hold what it claims fails with
+    // DiskReadError.
+    ErrorCode warm_up(const std::string &path);
+    // run warm_up() in a background thread.
+    void start_warm_up(const std::string &path);
+    // wait for the background warm-up and return its result.
+    ErrorCode wait_warm_up();
+
+    // read the pages @pgnos of @file not cached yet, by sorted runs of
+    // consecutive pages like warm_up(), but taking frames like get_frame():
+    // for the pages a reader is about to get, so that their misses share
+    // the disk reads.
+    ErrorCode prefetch(file_id_t file, std::span<const page_id_t> pgnos);
+
+    // put a second-level cache of @pages pages in the file @path, on a
+    // faster local disk, under the pool: clean victims are written into it
+    // and misses read it before the database files. 0 pages to drop it.
+    ErrorCode set_secondary_cache(const std::string &path, size_t pages);
+    // the number of pages held by the second-level cache.
+    size_t secondary_size() const {
+        std::scoped_lock lock(latch_);
+        return secondary_ ? secondary_->size() : 0;
+    }
+
+    // take a snapshot of the pool statistics.
+    BufferPoolStats stats() const;
+    // export the pool statistics in the prometheus text format.
+    void export_stats(std::ostream &os) const { stats().export_text(os); }
+    void reset_stats() { stats_.reset(); }
+
 private:
+    friend class WriteScope;
+    friend class ReadGuard;
+
+    // latch and pin @frame if the thread is writing in a WriteScope.
+    void acquire_for_write(Frame *frame);
+
     tl::expected<frame_id_t, ErrorCode> get_free_frame_id();
-    tl::expected<Frame *, ErrorCode> get_free_frame(std::shared_ptr<Page> page);
+    // take a frame from the free list only, never victimize.
+    tl::expected<frame_id_t, ErrorCode> take_free_frame_id();
+    // @return PoolNoFreeFrame error once there is no more free frames.
+    // @victimize to take the frames of other pages too, and cache the pages
+    // as the hottest ones.
+    // NOTE: the pages are read into batch_buf_ and copied into the frames
+    // taken, nothing is allocated once the scratch has grown to a batch.
+    ErrorCode warm_up_batch(std::span<const page_key_t> keys,
+                            bool victimize = false);
+    // take a frame for the page @pgno of @file, and read the page from the
+    // disk into it if @read, else leave it with a fresh header.
+    tl::expected<Frame *, ErrorCode> get_free_frame(file_id_t file,
+                                                    page_id_t pgno, bool read);
+    DiskManager *disk(file_id_t file) const {
+        return file < files_.size() ? files_[file].get() : nullptr;
+    }
+
+    // write the clean victim into the second-level cache, if any.
+    void admit_secondary(Frame *victim);
+
+    // cache the frame of a page, keeping the number of resident frames of
+    // every file.
+    ErrorCode cache_put(Frame *frame);
+    ErrorCode cache_put_back(Frame *frame);
+    ErrorCode cache_remove(Frame *frame);
+    // whether the victim should be kept by the reservation of its file.
+    bool is_reserved(const Frame *frame) const {
+        return resident_[frame->file()] <= reserved_[frame->file()];
+    }
+
+    ErrorCode flush_frame_unlocked(Frame *frame);
+
+    void record(PoolEvent event, const Page &page, uint64_t ns = 0) {
+        stats_.record(event, page.hdr.is_leaf, page.hdr.index, ns);
+    }
+    // evict and retire up to @batch frames beyond the target size.
+    // return true if the pool has reached its target size.
+    bool shrink_step(size_t batch);
+    // destroy the retired frames once no ReadGuard may reference them.
+    void reclaim();
+    std::atomic<int64_t> &readers(uint64_t epoch);
 
     using PageTable = std::unordered_map<page_id_t, frame_id_t>;
-    using FrameLRUCache = LRUCacheWithPin<page_id_t, Frame *>;
-    using MemPool = std::vector<Frame>;
+    // NOTE: keyed by make_page_key(file, page).
+    using FrameLRUCache = LRUCacheWithPin<page_key_t, Frame *>;
+    // NOTE: a deque keeps the address of every frame stable when the pool
+    // grows or shrinks at the back.
+    using MemPool = std::deque<Frame>;
+
+    // guard the frame pool, the cache and the free list.
+    // NOTE: recursive since a frame calls back into the pool.
+    mutable std::recursive_mutex latch_;
+    // serialize the writers of all the files, see WriteScope.
+    std::recursive_mutex writer_latch_;
 
+    // the target pool size, retired_from_ may still be larger while shrinking.
     size_t pool_size_;
     MemPool pool_;
+    // frames from retired_from_ on are retired, destroyed by reclaim().
+    size_t retired_from_;
+    // readers are counted by the parity of the epoch they entered in, see
+    // ReadGuard.
+    std::atomic<uint64_t> epoch_{0};
+    uint64_t retire_epoch_ = 0;
+    struct alignas(64) ReaderShard {
+        std::atomic<int64_t> readers[2] = {0, 0};
+    };
+    std::array<ReaderShard, config::POOL_READER_SHARDS> reader_shards_;
     FrameLRUCache cache_;
     // PageTable page_table_;
 
-    std::shared_ptr<DiskManager> disk_manager_;
+    // the database files served, by file id. removed ones are nullptr.
+    std::vector<std::shared_ptr<DiskManager>> files_;
+    // the number of frames holding pages of each file.
+    std::vector<size_t> resident_;
+    // the number of frames reserved for each file.
+    std::vector<size_t> reserved_;
+    size_t protected_budget_;
 
     // available frame_id_t
-    std::list<frame_id_t> free_list_;
-    // use MemPool instead.
-    // std::list<frame_id_t> free_list_;
+    FreeFrameList free_list_;
+
+    PoolStatsCollector stats_;
+    // the second-level cache, nullptr if none.
+    std::unique_ptr<SecondaryCache> secondary_;
+
+    std::string dump_file_;
+    std::thread warm_up_thread_;
+    std::atomic<bool> stop_warm_up_{false};
+    ErrorCode warm_up_result_ = ErrorCode::Success;
+    // the scratch of warm_up_batch() and prefetch(), under the latch: the
+    // keys asked for, the keys read in order, the time of each read and
+    // the pages read.
+    std::vector<page_key_t> batch_keys_, batch_sorted_;
+    std::vector<uint64_t> batch_ns_;
+    std::vector<char> batch_buf_;
+};
+
+// ReadGuard keeps the frames a thread may reference without any latch or pin,
+// for optimistic reads or swizzled references, from being destroyed when the
+// pool shrinks. a retired frame is destroyed only after every guard entered
+// before its retirement has gone, an epoch-based reclamation.
+class ReadGuard : NonCopyable {
+public:
+    explicit ReadGuard(BufferPoolManager *pool);
+    ~ReadGuard();
+
+private:
+    BufferPoolManager *pool_;
+    uint64_t epoch_;
+};
+
+// WriteScope serves a writer against optimistic readers of the pool.
+// from its first successful upgrade() on, every frame the thread gets from
+// the pool is latched exclusively and pinned until the scope ends, so that
+// a reader validating its read on such a frame always restarts and the frame
+// never gets replaced under the writer.
+// NOTE: a frame found latched is taken as latched by the writer itself, so
+// the writers of a pool take turns: a scope holds the writer latch of the
+// pool from its construction on, whatever files or indices the writers
+// write. scopes of a thread on the same pool nest.
+class WriteScope : NonCopyable {
+public:
+    explicit WriteScope(BufferPoolManager *pool);
+    ~WriteScope();
+
+    // latch @frame, which was read optimistically at @version, for writing.
+    // return false if the frame has been written or replaced since then.
+    bool upgrade(Frame *frame, uint64_t version);
+
+    // the active scope of the thread on @pool, nullptr if none.
+    static WriteScope *current(const BufferPoolManager *pool) {
+        if (current_ && current_->active_ && current_->pool_ == pool)
+            return current_;
+        return nullptr;
+    }
+
+private:
+    friend class BufferPoolManager;
+
+    BufferPoolManager *pool_;
+    WriteScope *outer_;
+    bool active_ = false;
+    // the frames latched by the scope.
+    std::vector<Frame *> frames_;
+
+    static thread_local WriteScope *current_;
 };
 
 } // namespace storage
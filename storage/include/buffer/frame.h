@@ -2,143 +2,245 @@
 #define STORAGE_INCLUDE_BUFFER_FRAME_H
 
 // #include "buffer/buffer_pool.h"
+#include "buffer/latch.h"
 #include "config.h"
 #include "disk/page.h"
 #include "index/cursor.h"
 #include "index/record.h"
 #include "log.h"
-#include "membuf.h"
-#include "serialization.h"
 #include "tl/expected.hpp"
 #include "types.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <memory>
+#include <string_view>
 
 namespace storage {
 
 class BufferPoolManager;
 
+inline page_key_t make_page_key(file_id_t file, page_id_t pgno) {
+    return static_cast<page_key_t>(file) << 32 | pgno;
+}
+
 // Frame is in-memory representation of a page.
-class Frame {
+// NOTE: a frame owns the same page storage for its whole life and every page
+// is read into it in place, so that an optimistic reader racing with a
+// replacement reads stale bytes instead of freed memory and fails the version
+// validation, and a replacement never allocates.
+// NOTE: the descriptor takes two cache lines. the first one holds everything
+// a lookup touches: the version latch, the page header and the pointer to the
+// payload, which lives in a buffer of its own; the second one is touched by
+// replacement only.
+class alignas(64) Frame {
 public:
     // for buffer pool initialization only
     // Frame(frame_id_t id) : id_(id), page_(nullptr), dirty_(false) {}
     Frame(BufferPoolManager *pool, frame_id_t id)
-        : pool_(pool), id_(id), page_(nullptr), dirty_(false) {}
+        : page_(page_id_t(0)), id_(id), pool_(pool),
+          swips_(std::make_unique<SwipTable>()) {}
 
     ~Frame();
-    void reassign(std::shared_ptr<Page> page);
+    // take the page @pgno of @file, with a fresh header only; it's the
+    // caller's responsibility to read or init the page.
+    void reassign(file_id_t file, page_id_t pgno);
+    // drop the page held by the frame.
+    // NOTE: it's the caller's responsibility to flush the dirty page first.
+    void reset();
+    // whether the frame holds no page.
+    bool is_empty() const { return page_.pgno() == 0; }
 
     void set_id(frame_id_t id) { id_ = id; }
     frame_id_t id() const { return id_; }
 
+    // whether the frame is in the protected region of the pool.
+    bool is_protected() const { return test_flag(PROTECTED); }
+    void set_protected(bool value) { set_flag(PROTECTED, value); }
+
+    // the version to validate an optimistic read against, see OptimisticLatch.
+    uint64_t read_version() const { return latch_.read_begin(); }
+    bool validate(uint64_t version) const { return latch_.validate(version); }
+    // latch the frame exclusively against optimistic readers.
+    void write_lock() { latch_.lock(); }
+    void write_unlock() { latch_.unlock(); }
+    // latch the frame exclusively only if nothing has been written since
+    // @version.
+    bool try_upgrade(uint64_t version) { return latch_.try_upgrade(version); }
+    bool is_write_locked() const { return latch_.is_locked(); }
+
+    // the resident frame of the child page @pgno if the frame references it
+    // directly, nullptr otherwise.
+    // NOTE: read without any latch, the caller must check that the child
+    // still holds @pgno.
+    Frame *swizzled_child(page_id_t pgno) const {
+        auto &swip = (*swips_)[pgno % config::SWIZZLE_SLOTS];
+        if (swip.pgno.load(std::memory_order_acquire) != pgno)
+            return nullptr;
+        return swip.frame.load(std::memory_order_acquire);
+    }
+    // reference the resident @child directly.
+    // NOTE: under the pool latch only.
+    void swizzle(Frame *child);
+    // drop the references to and from the frame before it gets another page.
+    // NOTE: under the pool latch only.
+    void unswizzle();
+    // reference the frame from @ref, an external root reference, which gets
+    // cleared once the frame is unswizzled. nullptr to drop it.
+    // NOTE: under the pool latch only.
+    static void swizzle_root(std::atomic<Frame *> &ref, Frame *root);
+
+    // mark the frame accessed bypassing the replacer, which gives it a second
+    // chance once chosen as a victim.
+    void mark_referenced() {
+        if (!test_flag(REFERENCED))
+            set_flag(REFERENCED, true);
+    }
+    bool test_and_clear_referenced() {
+        return flags_.fetch_and(~REFERENCED, std::memory_order_relaxed) &
+               REFERENCED;
+    }
+
     bool is_leaf() const { return page()->hdr.is_leaf; }
     bool is_root(int depth) const { return depth == page()->hdr.level + 1; }
 
-    template <typename R>
-    void init_list() {
-        R infi{};
-        infi.hdr.order = 0;
-        R supre{};
-        supre.hdr.order = -1;
-        infi.hdr.length = dump_at(0, infi);
-
-        supre.hdr.length = dump(supre);
-
-        infi.hdr.next_record_offset = 0;
-        supre.hdr.prev_record_offset = -supre.hdr.length - infi.hdr.length;
-        // Log::GlobalLog() << "infi: " << infi.hdr.length << std::endl;
-        // Log::GlobalLog() << "supre: " << supre.hdr.length << std::endl;
-
-        // FIXME: serialization determination for infi and supre.
-        dump_at(0, infi);
-        dump(supre);
-        set_last_inserted(ppos());
-
-        // Log::GlobalLog()
-        // << "[Frame]: dump infimum and supremum in the new frame" <<
-        // std::endl;
-    }
-
-    template <typename T>
-    page_off_t load(T &value) {
-        // Log::GlobalLog() << "	going to load from " << gpos() << std::endl;
-        page_off_t before = gpos();
-        std::istream is(&membuf_);
-        serialization::deserialize(is, value);
-        return gpos() - before;
-    }
-
-    // a generic function to load a Type from the physical page after the
-    // specific offset(compared with current input pointer) using cereal's
-    // serialization support.
-    // @return is the size of the load.
-    template <typename T>
-    page_off_t load(int offset, T &value) {
-        membuf_.seekg(offset);
-        return load(value);
-    }
-
-    template <typename T>
-    page_off_t dump(const T &value) {
-        // Log::GlobalLog() << "	going to dump at " << ppos() << std::endl;
-        page_off_t before = ppos();
-        std::ostream os(&membuf_);
-        serialization::serialize(os, value);
+    // the record at the payload offset @offset, read in place.
+    // NOTE: throws std::out_of_range if it doesn't fit in the page, which
+    // only happens to a torn read, see RecordView.
+    RecordView record_at(page_off_t offset) const {
+        page_off_t limit = offset < Page::payload_len()
+                               ? Page::payload_len() - offset
+                               : 0;
+        return RecordView(page_.payload + offset, limit, key_prefix());
+    }
+
+    // the key prefix of an index page, the common prefix of the normalized
+    // keys of all its records, stored once at the start of the payload and
+    // stripped from every record. the records follow it.
+    // NOTE: throws std::out_of_range if it doesn't fit in the page, which
+    // only happens to a torn read.
+    std::string_view key_prefix() const {
+        page_off_t len = page()->hdr.key_prefix_len;
+        record_format::check(len <= Page::payload_len());
+        return {page_.payload, len};
+    }
+
+    // the slot directory of an index page, the offsets of its records in key
+    // order. it grows from the end of the payload down, the slot 0 last,
+    // while the records grow from the key prefix up to last_inserted().
+    // there are number_of_records() slots.
+    // NOTE: throws std::out_of_range for a slot beyond the page, which only
+    // happens to a torn read.
+    page_off_t slot(int i) const {
+        record_format::check(i >= 0 && i < MAX_SLOTS);
+        return record_format::read<uint16_t>(slot_ptr(i));
+    }
+    void set_slot(int i, page_off_t offset) {
+        record_format::write(slot_ptr(i), static_cast<uint16_t>(offset));
         mark_dirty();
-        return ppos() - before;
-    }
-
-    // a generic function to dump a Type into the physical page at the specific
-    // offset using cereal's serialization support.
-    // @return is the size of the dump.
-    template <typename T>
-    page_off_t dump(page_off_t offset, const T &value) {
-        membuf_.seekp(offset);
-        return dump(value);
-    }
-
-    // load the @value at the global offset @absolute by @lib cereal.
-    // @return is the size of the load.
-    template <typename T>
-    page_off_t load_at(page_off_t absolute, T &value) {
-        membuf_.setg(absolute);
-        // Log::GlobalLog() << "	going to load from " << gpos() << std::endl;
-        std::istream is(&membuf_);
-        serialization::deserialize(is, value);
-        return gpos() - absolute;
-    }
-
-    // dump the @value at the absolute offset @absolute by @lib cereal.
-    // @return is the size of the dump.
-    template <typename T>
-    page_off_t dump_at(page_off_t absolute, const T &value) {
-        membuf_.setp(absolute);
-        // Log::GlobalLog() << "	going to dump at " << ppos() << std::endl;
-        std::ostream os(&membuf_);
-        serialization::serialize(os, value);
+    }
+    // insert the slot of the record at @offset before the slot @i.
+    void insert_slot(int i, page_off_t offset) {
+        int n = page()->hdr.number_of_records;
+        std::memmove(slot_ptr(n), slot_ptr(n - 1), (n - i) * SLOT_LEN);
+        page()->hdr.number_of_records++;
+        set_slot(i, offset);
+    }
+    void erase_slot(int i) {
+        int n = page()->hdr.number_of_records;
+        std::memmove(slot_ptr(n - 2), slot_ptr(n - 1),
+                     (n - 1 - i) * SLOT_LEN);
+        page()->hdr.number_of_records--;
         mark_dirty();
-        return ppos() - absolute;
+    }
+    // the bytes between the records and the slot directory.
+    page_off_t free_space() const {
+        return Page::payload_len() - page()->hdr.number_of_records * SLOT_LEN -
+               page()->hdr.last_inserted;
+    }
+    // the bytes of the deleted records, free once the page is repacked.
+    page_off_t deleted_bytes() const { return page()->hdr.deleted_bytes; }
+    void set_deleted_bytes(page_off_t bytes) {
+        page()->hdr.deleted_bytes = bytes;
+        mark_dirty();
+    }
+    // mark the record at @offset deleted, its slot dropped already.
+    // NOTE: the record stays readable until the page is repacked.
+    void delete_record(page_off_t offset) {
+        auto record = record_at(offset);
+        record.set_status(config::RecordStatus::Deleted);
+        set_deleted_bytes(deleted_bytes() + record.length());
     }
 
-    // put pointer's position for the page's memory buffer
-    page_off_t ppos() const { return membuf_.tellp(); }
-    // get pointer's position for the page's memory buffer
-    page_off_t gpos() const { return membuf_.tellg(); }
-
-    void mark_dirty() { dirty_ = true; }
-    void clear_dirty() { dirty_ = false; }
-    bool is_dirty() { return dirty_; }
+    static constexpr page_off_t SLOT_LEN = sizeof(uint16_t);
 
-    bool is_full() const {
-        return page()->hdr.number_of_records >= config::max_number_of_records();
+    void mark_dirty() {
+        if (!test_flag(DIRTY))
+            set_flag(DIRTY, true);
     }
+    void clear_dirty() { set_flag(DIRTY, false); }
+    bool is_dirty() const { return test_flag(DIRTY); }
 
-    bool is_half_full() const {
-        return page()->hdr.number_of_records <= config::min_number_of_records();
+    // the bytes of an index page filled before it splits, see
+    // config::INDEX_PAGE_FILL_FACTOR.
+    static constexpr size_t capacity() {
+        return Page::payload_len() * config::INDEX_PAGE_FILL_FACTOR / 100;
+    }
+    // the bytes taken by the key prefix, the live records and their slots.
+    // NOTE: the deleted records take room until the page is repacked, but
+    // don't count, see deleted_bytes().
+    size_t live_bytes() const {
+        return page()->hdr.last_inserted - deleted_bytes() +
+               page()->hdr.number_of_records * SLOT_LEN;
+    }
+    // live_bytes() with the key prefix cut to @prefix_len, which the records
+    // then take back in their keys.
+    size_t live_bytes(size_t prefix_len) const {
+        size_t cut = page()->hdr.key_prefix_len - prefix_len;
+        return live_bytes() - cut + page()->hdr.number_of_records * cut;
+    }
+    // the length of the common prefix of the key prefix and the normalized
+    // @key, the key prefix once a record of @key is in the page.
+    size_t shared_prefix_len(std::string_view key) const {
+        auto prefix = key_prefix();
+        return std::mismatch(prefix.begin(), prefix.end(), key.begin(),
+                             key.end())
+                   .first -
+               prefix.begin();
+    }
+    // the live bytes once a record of the normalized key @key is in, which
+    // takes @len bytes with its slot and the whole key.
+    size_t live_bytes_with(std::string_view key, size_t len) const {
+        size_t prefix_len = shared_prefix_len(key);
+        return live_bytes(prefix_len) + len - prefix_len;
+    }
+    // whether the page is filled up to its capacity.
+    bool is_full() const { return live_bytes() >= capacity(); }
+    // whether the page has no room left within its capacity for a record of
+    // the normalized key @key, see live_bytes_with().
+    bool is_full(std::string_view key, size_t len) const {
+        return live_bytes_with(key, len) > capacity();
+    }
+    // whether a record of the normalized key @key fits in the page at all,
+    // once its deleted records are dropped, see live_bytes_with().
+    bool has_room(std::string_view key, size_t len) const {
+        return live_bytes_with(key, len) <= Page::payload_len();
     }
+    bool is_half_full() const { return live_bytes() <= capacity() / 2; }
 
-    std::shared_ptr<Page> page() const { return page_; }
+    Page *page() const { return &page_; }
     page_id_t pgno() const { return page()->pgno(); }
+    // the file of the page in the pool.
+    file_id_t file() const { return file_; }
+    page_key_t key() const { return make_page_key(file_, pgno()); }
+    // whether the frame holds the page @pgno of @file.
+    // NOTE: a frame of a pool shared by several files may get the page of
+    // the same number of another file, an optimistic reader checks both.
+    bool holds(file_id_t file, page_id_t pgno) const {
+        return file_ == file && this->pgno() == pgno;
+    }
     index_id_t index() const { return page()->hdr.index; }
     uint8_t level() const { return page()->hdr.level; }
     auto number_of_records() const { return page()->hdr.number_of_records; }
@@ -155,29 +257,67 @@ public:
 
     tl::expected<Frame *, ErrorCode> parent_frame() const;
 
-    tl::expected<Cursor<InternalClusteredRecord>, ErrorCode>
-    parent_record() const;
+    // the record referencing the frame in its parent.
+    tl::expected<Cursor<RecordView>, ErrorCode> parent_record() const;
+    // the offset of the record referencing the page @child, the frame being
+    // an internal page.
+    // NOTE: looked up by the child rather than kept in the child, records
+    // move whenever their page is repacked.
+    tl::expected<page_off_t, ErrorCode> child_record_off(page_id_t child) const;
 
     BufferPoolManager *pool() const { return pool_; }
 
     tl::expected<Frame *, ErrorCode> prev_frame();
     tl::expected<Frame *, ErrorCode> next_frame();
-    void set_parent(page_id_t parent, page_off_t offset);
+    void set_parent(page_id_t parent);
 
     // static tl::expected<Frame *, ErrorCode>
     // allocate_frame(index_id_t id, uint8_t order, bool is_leaf);
 
 private:
+    static constexpr int MAX_SLOTS = Page::payload_len() / SLOT_LEN;
+    char *slot_ptr(int i) const {
+        return page_.payload + Page::payload_len() - (i + 1) * SLOT_LEN;
+    }
+
+    enum Flag : uint8_t { DIRTY = 1, PROTECTED = 2, REFERENCED = 4 };
+    bool test_flag(Flag flag) const {
+        return flags_.load(std::memory_order_relaxed) & flag;
+    }
+    void set_flag(Flag flag, bool value) {
+        if (value)
+            flags_.fetch_or(flag, std::memory_order_relaxed);
+        else
+            flags_.fetch_and(~flag, std::memory_order_relaxed);
+    }
+
+    // the hot cache line.
+    OptimisticLatch latch_;
+    // the header is kept in the descriptor, the payload is not.
+    // NOTE: mutable since the header is updated through const frames too.
+    mutable Page page_;
     // NOTE: no boundry check, set carefully.
+    uint32_t id_;
+    file_id_t file_ = 0;
+    std::atomic<uint8_t> flags_ = 0;
+
+    // the cold cache line.
     BufferPoolManager *pool_;
-    frame_id_t id_;
-    std::shared_ptr<Page> page_;
 
-    // make page payload field a membuf so that it's easier to do serialization.
-    // NOTE: max_size = Page size - PageHdr size.
-    common::MemBuf membuf_;
-    bool dirty_;
+    // a child reference swizzled into a frame pointer.
+    struct Swip {
+        std::atomic<page_id_t> pgno{0};
+        std::atomic<Frame *> frame{nullptr};
+    };
+    using SwipTable = std::array<Swip, config::SWIZZLE_SLOTS>;
+    // NOTE: out of the descriptor, only parents of swizzled children use it.
+    std::unique_ptr<SwipTable> swips_;
+    // the frame which references this one directly.
+    Frame *swizzled_in_ = nullptr;
+    // the root reference which references this one directly.
+    std::atomic<Frame *> *root_ref_ = nullptr;
 };
+static_assert(sizeof(Frame) == 2 * 64, "a frame descriptor takes two lines");
 
 } // namespace storage
 #endif // !STORAGE_INCLUDE_BUFFER_FRAME_H
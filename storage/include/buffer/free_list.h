@@ -0,0 +1,86 @@
+#ifndef STORAGE_INCLUDE_BUFFER_FREE_LIST_H
+#define STORAGE_INCLUDE_BUFFER_FREE_LIST_H
+
+#include "types.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace storage {
+
+// FreeFrameList is a FIFO queue of free frame ids over a ring buffer, which
+// never allocates as long as it holds no more ids than reserved.
+class FreeFrameList {
+public:
+    FreeFrameList() = default;
+
+    // make room for @capacity ids, keeping the queued ones in order.
+    void reserve(size_t capacity) {
+        if (capacity <= ids_.size())
+            return;
+        std::vector<frame_id_t> ids(capacity);
+        for (size_t i = 0; i < size_; i++)
+            ids[i] = at(i);
+        ids_.swap(ids);
+        head_ = 0;
+    }
+
+    void push_back(frame_id_t id) {
+        if (size_ == ids_.size())
+            reserve(std::max<size_t>(2 * size_, 16));
+        ids_[(head_ + size_) % ids_.size()] = id;
+        size_++;
+    }
+
+    // take the first id satisfying @pred out of the queue.
+    // return false if there is none.
+    template <typename Pred>
+    bool take_if(Pred &&pred, frame_id_t &id) {
+        for (size_t i = 0; i < size_; i++) {
+            if (pred(at(i))) {
+                id = at(i);
+                erase_at(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // remove @id from the queue if it's there.
+    void remove(frame_id_t id) {
+        for (size_t i = 0; i < size_; i++) {
+            if (at(i) == id) {
+                erase_at(i);
+                return;
+            }
+        }
+    }
+
+    void clear() { head_ = size_ = 0; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+private:
+    frame_id_t &at(size_t i) { return ids_[(head_ + i) % ids_.size()]; }
+
+    // NOTE: the front is taken in O(1), the others shift the ids behind.
+    void erase_at(size_t i) {
+        assert(i < size_);
+        if (i == 0) {
+            head_ = (head_ + 1) % ids_.size();
+        } else {
+            for (; i + 1 < size_; i++)
+                at(i) = at(i + 1);
+        }
+        size_--;
+    }
+
+    std::vector<frame_id_t> ids_;
+    size_t head_ = 0;
+    size_t size_ = 0;
+};
+
+} // namespace storage
+
+#endif // !STORAGE_INCLUDE_BUFFER_FREE_LIST_H
@@ -0,0 +1,66 @@
+#ifndef STORAGE_INCLUDE_BUFFER_LATCH_H
+#define STORAGE_INCLUDE_BUFFER_LATCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace storage {
+
+// OptimisticLatch is a version word for optimistic lock coupling.
+// readers take no lock and write nothing: they remember the version before
+// reading and validate it afterwards, restarting if it has changed. a writer
+// makes the version odd while holding the latch exclusively, and bumps it to
+// the next even one on release.
+class OptimisticLatch {
+public:
+    OptimisticLatch() = default;
+
+    // wait until no writer holds the latch and return the version to be
+    // validated against.
+    uint64_t read_begin() const {
+        uint64_t version = version_.load(std::memory_order_acquire);
+        while (version & 1) {
+            std::this_thread::yield();
+            version = version_.load(std::memory_order_acquire);
+        }
+        return version;
+    }
+
+    // whether nothing has been written since read_begin() returned @version.
+    bool validate(uint64_t version) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return version_.load(std::memory_order_relaxed) == version;
+    }
+
+    void lock() {
+        uint64_t version = version_.load(std::memory_order_relaxed);
+        while (true) {
+            if (!(version & 1) &&
+                version_.compare_exchange_weak(version, version + 1,
+                                               std::memory_order_acquire))
+                return;
+            std::this_thread::yield();
+            version = version_.load(std::memory_order_relaxed);
+        }
+    }
+
+    // latch exclusively only if the version is still @version.
+    bool try_upgrade(uint64_t version) {
+        return version_.compare_exchange_strong(version, version + 1,
+                                                std::memory_order_acquire);
+    }
+
+    void unlock() { version_.fetch_add(1, std::memory_order_release); }
+
+    bool is_locked() const {
+        return version_.load(std::memory_order_relaxed) & 1;
+    }
+
+private:
+    std::atomic<uint64_t> version_{0};
+};
+
+} // namespace storage
+
+#endif // !STORAGE_INCLUDE_BUFFER_LATCH_H
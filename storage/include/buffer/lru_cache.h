@@ -5,11 +5,13 @@
 #include "log.h"
 #include "noncopyable.h"
 #include "tl/expected.hpp"
+#include <algorithm>
+#include <bit>
 #include <cstdint>
-#include <iterator>
-#include <list>
-#include <unordered_map>
+#include <deque>
+#include <functional>
 #include <utility>
+#include <vector>
 
 namespace storage {
 /**
@@ -161,6 +163,9 @@ namespace storage {
 //     uint32_t cur_size_;
 // };
 
+// NOTE: no heap allocation once constructed, as long as the cache doesn't
+// grow: entries live in a node arena preallocated for @max_size entries, and
+// the key lookup is an open addressing table over the nodes.
 template <typename Key, typename Value>
 class LRUCacheWithPin : public NonCopyable {
 public:
@@ -170,22 +175,24 @@ public:
      * required to store
      */
     explicit LRUCacheWithPin(const uint32_t max_size)
-        : max_size_(max_size), cur_size_(0) {}
+        : max_size_(max_size), cur_size_(0) {
+        reserve(max_size);
+    }
 
     /**
      * Destroys the LRUReplacer.
      */
-    ~LRUCacheWithPin() { clear(); }
+    ~LRUCacheWithPin() = default;
 
     // if found, @param value assigned to the found value and return true;
     // else, return CacheEntryNotFound error.
     ErrorCode get(const Key &key, Value &value) {
-        auto it = map_.find(key);
-        if (it == map_.end())
+        auto node = find(key);
+        if (!node)
             return ErrorCode::CacheEntryNotFound;
 
-        value = it->second->entry.value;
-        touch(key);
+        value = node->entry.value;
+        touch(node);
 
         return ErrorCode::Success;
     }
@@ -194,10 +201,9 @@ public:
     // if not exists, ensure enough space and insert the entry.
     // if there is no enough space, return CacheNoMoreVictim error.
     ErrorCode put(const Key &key, const Value &value) {
-        auto it = map_.find(key);
-        if (it != map_.end()) {
-            it->second->entry.value = value;
-            touch(key);
+        if (auto node = find(key)) {
+            node->entry.value = value;
+            touch(node);
             return ErrorCode::Success;
         }
 
@@ -207,8 +213,26 @@ public:
                 return result.error();
         }
 
-        auto node = list_.push_front(key, value);
-        map_.insert({key, node});
+        auto node = new_node(key, value);
+        list_.link_front(node);
+        insert(node);
+        cur_size_++;
+        return ErrorCode::Success;
+    }
+
+    // insert the entry at the cold end without touching existing entries, so
+    // that it's the next to victimize; used to warm the cache up.
+    // if there is no enough space, return CacheNoMoreVictim error instead of
+    // victimizing a hotter entry.
+    ErrorCode put_back(const Key &key, const Value &value) {
+        if (find(key))
+            return ErrorCode::Success;
+        if (is_full())
+            return ErrorCode::CacheNoMoreVictim;
+
+        auto node = new_node(key, value);
+        list_.link_back(node);
+        insert(node);
         cur_size_++;
         return ErrorCode::Success;
     }
@@ -216,109 +240,155 @@ public:
     // if exists, remove the entry and return true;
     // else, return CacheKeyNotFound error.
     ErrorCode remove(const Key &key) {
-        auto it = map_.find(key);
-        if (it == map_.end())
+        auto node = find(key);
+        if (!node)
             return ErrorCode::CacheEntryNotFound;
 
-        auto node = list_.remove(it->second);
-        map_.erase(it);
-        delete node;
+        if (node->is_protected) {
+            protected_.remove(node);
+            protected_size_--;
+        } else {
+            list_.remove(node);
+        }
+        erase(key);
+        free_node(node);
 
         cur_size_--;
 
         return ErrorCode::Success;
     }
 
-    bool exists(const Key &key) const { return map_.find(key) != map_.end(); }
+    // move the entry into the protected list, which is never victimized.
+    // if not found, return KeyNotFound error.
+    ErrorCode protect(const Key &key) {
+        auto node = find(key);
+        if (!node)
+            return ErrorCode::KeyNotFound;
+
+        if (!node->is_protected) {
+            list_.remove(node);
+            protected_.link_front(node);
+            node->is_protected = true;
+            protected_size_++;
+        }
+        return ErrorCode::Success;
+    }
+
+    // move the entry back to the hot end of the LRU list.
+    // if not found, return KeyNotFound error.
+    ErrorCode unprotect(const Key &key) {
+        auto node = find(key);
+        if (!node)
+            return ErrorCode::KeyNotFound;
+
+        if (node->is_protected) {
+            protected_.remove(node);
+            list_.link_front(node);
+            node->is_protected = false;
+            protected_size_--;
+        }
+        return ErrorCode::Success;
+    }
+
+    bool is_protected(const Key &key) const {
+        auto node = find(key);
+        return node && node->is_protected;
+    }
+
+    // look up the entry without touching it.
+    ErrorCode peek(const Key &key, Value &value) const {
+        auto node = find(key);
+        if (!node)
+            return ErrorCode::CacheEntryNotFound;
+
+        value = node->entry.value;
+        return ErrorCode::Success;
+    }
+
+    bool exists(const Key &key) const { return find(key) != nullptr; }
 
     // if key not exists or not pinned, return false;
     // else, return true;
     bool is_pinned(const Key &key) const {
-        auto it = map_.find(key);
-        if (it == map_.end() || !it->second->entry->is_pinned())
-            return false;
-
-        return true;
+        auto node = find(key);
+        return node && node->entry.is_pinned();
     }
 
     // if not found, return KeyNotFound error.
     ErrorCode pin(const Key &key) {
-        auto it = map_.find(key);
-        if (it == map_.end()) {
+        auto node = find(key);
+        if (!node)
             return ErrorCode::KeyNotFound;
-        }
-        it->second->entry.pin_count++;
+        node->entry.pin_count++;
         return ErrorCode::Success;
     }
 
     // if not found, return KeyNotFound error; if not pinned, return
     // KeyNotPinned error.
     ErrorCode unpin(const Key &key) {
-        auto it = map_.find(key);
-        if (it == map_.end())
+        auto node = find(key);
+        if (!node)
             return ErrorCode::KeyNotFound;
-        if (!it->second->entry.is_pinned())
+        if (!node->entry.is_pinned())
             return ErrorCode::KeyNotPinned;
 
-        it->second->entry.pin_count--;
+        node->entry.pin_count--;
         return ErrorCode::Success;
     }
 
+    // visit the entries from the most recently used to the least, protected
+    // entries first.
+    template <typename F>
+    void for_each(F &&func) const {
+        for (auto node = protected_.head->next; node != protected_.tail;
+             node = node->next)
+            func(node->entry.key, node->entry.value);
+        for (auto node = list_.head->next; node != list_.tail;
+             node = node->next)
+            func(node->entry.key, node->entry.value);
+    }
+
     uint32_t size() const { return cur_size_; }
+    uint32_t protected_size() const { return protected_size_; }
     uint32_t max_size() const { return max_size_; }
+    // NOTE: no eviction here, the cache may stay above a smaller @max_size
+    // until later puts make room by victimizing. growing preallocates the
+    // nodes at once.
+    void set_max_size(uint32_t max_size) {
+        max_size_ = max_size;
+        reserve(max_size);
+    }
 
     bool is_empty() const { return size() == 0; }
-    bool is_full() const { return size() == max_size(); }
+    bool is_full() const { return size() >= max_size(); }
 
     // Remove the victim entry as defined by the replacement policy.
     // return victim's value if success; else return CacheNoMoreVictim error.
-    tl::expected<Value, ErrorCode> victim() {
-        // auto last_entry = list_.rbegin();
-        // while (last_entry != list_.rend()) {
-        //     if (last_entry->is_pinned()) {
-        //         last_entry++;
-        //         continue;
-        //     }
-        //     auto it = map_.find(last_entry->key);
-        //     assert(it != map_.end());
-        //     assert(it->second->key == last_entry->key);
-        //     assert(it->second->value == last_entry->value);
-        //     auto value = last_entry->value;
-        //     // assert(std::next(last_entry).base() == it->second);
-        //     list_.erase(it->second);
-        //     map_.erase(it);
-        //
-        //     cur_size_--;
-        //     return value;
-        // }
-        if (!list_.empty()) {
-            auto node = list_.pop_back();
-            // std::cerr << node->entry.key << ": " << node->entry.value
-            //           << std::endl;
-            map_.erase(node->entry.key);
+    // @on_pinned is called with the value of every pinned entry passed over.
+    template <typename OnPinned = void (*)(const Value &)>
+    tl::expected<Value, ErrorCode>
+    victim(OnPinned &&on_pinned = [](const Value &) {}) {
+        // NOTE: pinned entries are skipped, protected ones are not even in the
+        // list.
+        for (auto node = list_.tail->prev; node != list_.head;
+             node = node->prev) {
+            if (node->entry.is_pinned()) {
+                on_pinned(node->entry.value);
+                continue;
+            }
+
+            list_.remove(node);
+            erase(node->entry.key);
             cur_size_--;
 
-            return node->entry.value;
+            auto value = node->entry.value;
+            free_node(node);
+            return value;
         }
         return tl::unexpected(ErrorCode::CacheNoMoreVictim);
     }
 
 private:
-    // "use"/touch the entry.
-    void touch(const Key &key) {
-        auto it = map_.find(key);
-        if (it == map_.end())
-            return;
-
-        //  TODO: reduce copy
-        list_.move_front(it->second);
-    }
-
-    void clear() {
-        list_.clear();
-        map_.clear();
-    }
-
     struct EntryWithPin {
         Key key;
         Value value;
@@ -333,37 +403,33 @@ private:
 
     struct ListNode {
         EntryWithPin entry;
+        // NOTE: a free node is linked to the next free one by @next.
         ListNode *prev, *next;
-
-        ListNode(const Key &key, const Value &value)
-            : entry(key, value), prev(nullptr), next(nullptr) {}
+        bool is_protected = false;
 
         ListNode() : prev(nullptr), next(nullptr) {}
     };
 
-    struct List {
-        using iterator = ListNode *;
+    // an intrusive doubly linked list between two sentinels.
+    struct List : NonCopyable {
+        ListNode sentinels[2];
         ListNode *head, *tail;
 
-        List() : head(new ListNode()), tail(new ListNode()) {
+        List() : head(&sentinels[0]), tail(&sentinels[1]) {
             head->next = tail;
             tail->prev = head;
         }
 
-        ListNode *push_front(const Key &key, const Value &value) {
-            auto node = new ListNode(key, value);
-
+        void link_front(ListNode *node) {
             head->next->prev = node;
 
             node->next = head->next;
             node->prev = head;
 
             head->next = node;
-            return node;
         }
 
-        ListNode *push_back(const Key &key, const Value &value) {
-            auto node = new ListNode(key, value);
+        void link_back(ListNode *node) {
             tail->prev->next = node;
 
             node->prev = tail->prev;
@@ -380,45 +446,112 @@ private:
         }
 
         void move_front(ListNode *node) {
-            node->prev->next = node->next;
-            node->next->prev = node->prev;
+            remove(node);
+            link_front(node);
+        }
 
-            head->next->prev = node;
+        bool empty() const { return tail->prev == head; }
+    };
 
-            node->prev = head;
-            node->next = head->next;
+    // "use"/touch the entry.
+    void touch(ListNode *node) {
+        if (node->is_protected)
+            protected_.move_front(node);
+        else
+            list_.move_front(node);
+    }
 
-            head->next = node;
-        }
+    ListNode *new_node(const Key &key, const Value &value) {
+        if (!free_nodes_)
+            reserve(nodes_.size() + 1);
+        ListNode *node = free_nodes_;
+        free_nodes_ = node->next;
 
-        ListNode *pop_back() {
-            if (empty())
-                return nullptr;
+        node->entry = EntryWithPin(key, value);
+        node->prev = node->next = nullptr;
+        node->is_protected = false;
+        return node;
+    }
+
+    void free_node(ListNode *node) {
+        node->next = free_nodes_;
+        free_nodes_ = node;
+    }
+
+    // preallocate the nodes of @n entries, and keep the table at most half
+    // full with them.
+    void reserve(size_t n) {
+        while (nodes_.size() < n)
+            free_node(&nodes_.emplace_back());
+        if (slots_.empty() || slots_.size() < 2 * nodes_.size())
+            rehash(std::bit_ceil(std::max<size_t>(2 * nodes_.size(), 8)));
+    }
+
+    size_t home(const Key &key) const {
+        // fibonacci hashing spreads the identity hash of integer keys.
+        return (std::hash<Key>{}(key) * 0x9E3779B97F4A7C15ull) >> shift_;
+    }
 
-            auto node = tail->prev;
-            return remove(node);
+    ListNode *find(const Key &key) const {
+        for (size_t i = home(key);; i = (i + 1) & mask_) {
+            ListNode *node = slots_[i];
+            if (!node || node->entry.key == key)
+                return node;
         }
+    }
 
-        bool empty() { return tail->prev == head; }
+    void insert(ListNode *node) {
+        size_t i = home(node->entry.key);
+        while (slots_[i])
+            i = (i + 1) & mask_;
+        slots_[i] = node;
+    }
 
-        void clear() {
-            ListNode *node = head;
-            while (node != tail) {
-                ListNode *next = node->next;
-                delete node;
-                node = next;
-            }
+    // remove the key by shifting the following entries of its cluster back,
+    // so that no tombstone is left behind.
+    void erase(const Key &key) {
+        size_t i = home(key);
+        while (slots_[i] && !(slots_[i]->entry.key == key))
+            i = (i + 1) & mask_;
+        if (!slots_[i])
+            return;
+
+        slots_[i] = nullptr;
+        for (size_t j = (i + 1) & mask_; slots_[j]; j = (j + 1) & mask_) {
+            size_t k = home(slots_[j]->entry.key);
+            // the entry at @j stays if its home lies cyclically in (i, j].
+            bool stays = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+            if (stays)
+                continue;
+            slots_[i] = slots_[j];
+            slots_[j] = nullptr;
+            i = j;
         }
-    };
+    }
 
-    // using CacheList = std::list<EntryWithPin>;
-    using CacheList = List;
-    using CacheMap = std::unordered_map<Key, typename CacheList::iterator>;
+    void rehash(size_t capacity) {
+        std::vector<ListNode *> old(capacity, nullptr);
+        old.swap(slots_);
+        mask_ = capacity - 1;
+        shift_ = 64 - std::countr_zero(capacity);
+        for (auto node : old) {
+            if (node)
+                insert(node);
+        }
+    }
 
-    CacheList list_;
-    CacheMap map_;
+    List list_;
+    // entries out of replacement.
+    List protected_;
+    // NOTE: a deque never moves the nodes when it grows.
+    std::deque<ListNode> nodes_;
+    ListNode *free_nodes_ = nullptr;
+    std::vector<ListNode *> slots_;
+    size_t mask_ = 0;
+    int shift_ = 64;
     uint32_t max_size_;
     uint32_t cur_size_;
+    uint32_t protected_size_ = 0;
 };
 } // namespace storage
 
@@ -0,0 +1,129 @@
+#ifndef STORAGE_INCLUDE_BUFFER_POOL_STATS_H
+#define STORAGE_INCLUDE_BUFFER_POOL_STATS_H
+
+#include "config.h"
+#include "noncopyable.h"
+#include "types.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <ostream>
+
+namespace storage {
+
+// events counted by the buffer pool.
+enum class PoolEvent : uint8_t {
+    Hit = 0,
+    Miss,
+    Eviction,
+    DirtyWriteBack,
+    // a pinned frame passed over by an eviction, or holding a retirement or
+    // the removal of its file back.
+    PinWait,
+    DiskRead,
+    DiskWrite,
+    // a miss served by the secondary cache, or not.
+    SecondaryHit,
+    SecondaryMiss,
+    // a clean victim written into the secondary cache.
+    SecondaryWrite,
+};
+static constexpr size_t NUMBER_OF_POOL_EVENTS = 10;
+
+// counters of a slice of the buffer pool: a page type, an index or all.
+struct PoolCounters {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t dirty_write_backs = 0;
+    uint64_t pin_waits = 0;
+
+    uint64_t disk_reads = 0;
+    uint64_t disk_read_ns = 0;
+    uint64_t disk_writes = 0;
+    uint64_t disk_write_ns = 0;
+
+    uint64_t secondary_hits = 0;
+    uint64_t secondary_read_ns = 0;
+    uint64_t secondary_misses = 0;
+    uint64_t secondary_writes = 0;
+
+    double hit_ratio() const {
+        auto total = hits + misses;
+        return total == 0 ? 0 : static_cast<double>(hits) / total;
+    }
+
+    PoolCounters &operator+=(const PoolCounters &other);
+};
+
+// BufferPoolStats is a point-in-time snapshot of the buffer pool statistics.
+struct BufferPoolStats {
+    PoolCounters total;
+    PoolCounters leaf;
+    PoolCounters internal;
+    // only indices that have seen any event.
+    std::map<index_id_t, PoolCounters> indices;
+
+    size_t pool_size = 0;
+    size_t frames_in_use = 0;
+    size_t dirty_frames = 0;
+
+    // export in the prometheus text exposition format. the page_type series
+    // of a metric add up to its total, the index ones go under a metric of
+    // their own, minidb_buffer_pool_index_*, so that neither is counted
+    // twice by a sum().
+    void export_text(std::ostream &os) const;
+};
+
+// PoolStatsCollector records buffer pool events in per-thread shards of
+// relaxed atomic counters, so that recording never contends on a lock or a
+// shared cache line; a snapshot sums all the shards up.
+class PoolStatsCollector : NonCopyable {
+public:
+    PoolStatsCollector() = default;
+
+    void record(PoolEvent event, bool is_leaf, index_id_t index,
+                uint64_t ns = 0) {
+        auto &shard = shards_[shard_id()];
+        auto e = static_cast<size_t>(event);
+        shard.by_type[is_leaf ? 0 : 1].count[e].fetch_add(
+            1, std::memory_order_relaxed);
+        shard.by_index[index].count[e].fetch_add(1, std::memory_order_relaxed);
+        if (ns != 0) {
+            shard.by_type[is_leaf ? 0 : 1].ns[e].fetch_add(
+                ns, std::memory_order_relaxed);
+            shard.by_index[index].ns[e].fetch_add(ns,
+                                                  std::memory_order_relaxed);
+        }
+    }
+
+    // fill in the counters of @stats.
+    void snapshot(BufferPoolStats &stats) const;
+
+    // NOTE: not atomic with concurrent recording.
+    void reset();
+
+private:
+    struct Slot {
+        std::array<std::atomic<uint64_t>, NUMBER_OF_POOL_EVENTS> count{};
+        // accumulated latency, for disk events only.
+        std::array<std::atomic<uint64_t>, NUMBER_OF_POOL_EVENTS> ns{};
+
+        void add_to(PoolCounters &counters) const;
+    };
+
+    struct alignas(64) Shard {
+        // [0] for leaf pages, [1] for internal pages.
+        std::array<Slot, 2> by_type;
+        std::array<Slot, 1 << (8 * sizeof(index_id_t))> by_index;
+    };
+
+    static size_t shard_id();
+
+    std::array<Shard, config::POOL_STATS_SHARDS> shards_;
+};
+
+} // namespace storage
+
+#endif // !STORAGE_INCLUDE_BUFFER_POOL_STATS_H
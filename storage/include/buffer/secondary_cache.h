@@ -0,0 +1,77 @@
+#ifndef STORAGE_INCLUDE_BUFFER_SECONDARY_CACHE_H
+#define STORAGE_INCLUDE_BUFFER_SECONDARY_CACHE_H
+
+#include "buffer/free_list.h"
+#include "buffer/lru_cache.h"
+#include "disk/page.h"
+#include "error.h"
+#include "noncopyable.h"
+#include "tl/expected.hpp"
+#include "types.h"
+#include <fstream>
+#include <memory>
+#include <string>
+
+namespace storage {
+
+// SecondaryCache is a second-level page cache in a file on a faster local
+// disk, under the buffer pool: clean pages evicted from memory are written
+// into it, and misses of the pool look it up before reading the database
+// file. it's exclusive of the pool: a page hit here moves back into memory
+// and leaves the cache, so that it's never stale when the page gets written.
+// NOTE: a pure cache, the file is truncated when opened and removed when
+// closed. not thread safe, the pool calls it under its latch.
+class SecondaryCache : NonCopyable {
+public:
+    ~SecondaryCache();
+
+    // open a cache of @pages page slots in the file @path.
+    static tl::expected<std::unique_ptr<SecondaryCache>, ErrorCode>
+    open(const std::string &path, size_t pages);
+
+    // read the cached page of @key into @page and drop it from the cache.
+    // if not cached, return CacheEntryNotFound error.
+    ErrorCode get(page_key_t key, Page &page) {
+        auto ec = fetch(key);
+        if (ec == ErrorCode::Success)
+            load_fetched(page);
+        return ec;
+    }
+    // read the cached page of @key into a staging buffer and drop it from
+    // the cache, so that its slot is free for a put() before the page gets
+    // its frame by load_fetched().
+    // if not cached, return CacheEntryNotFound error.
+    ErrorCode fetch(page_key_t key);
+    // copy the page of the last successful fetch() into @page.
+    void load_fetched(Page &page) const { page.deserizalize(read_buf_.get()); }
+    // cache @page by @key, victimizing the least recently cached page if
+    // there is no free slot.
+    ErrorCode put(page_key_t key, const Page &page);
+    // drop the cached page of @key if any.
+    void remove(page_key_t key);
+    // drop every cached page of @file.
+    void remove_file(file_id_t file);
+
+    bool contains(page_key_t key) const { return slots_.exists(key); }
+    size_t size() const { return slots_.size(); }
+    size_t capacity() const { return slots_.max_size(); }
+
+private:
+    SecondaryCache(const std::string &path, size_t pages);
+
+    using slot_id_t = frame_id_t;
+
+    std::string path_;
+    std::fstream io_;
+    // the slot of every cached page, in LRU order.
+    LRUCacheWithPin<page_key_t, slot_id_t> slots_;
+    FreeFrameList free_slots_;
+    // page-size buffers to (de)serialize pages through, apart so that a
+    // fetched page survives a put().
+    std::unique_ptr<char[]> read_buf_;
+    std::unique_ptr<char[]> write_buf_;
+};
+
+} // namespace storage
+
+#endif // !STORAGE_INCLUDE_BUFFER_SECONDARY_CACHE_H
@@ -18,6 +18,7 @@
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <vector>
 namespace storage {
 
 struct DBFileHeader {
@@ -80,9 +81,7 @@ public:
             return;
         }
 
-        char *raw = new char[config::PAGE_SIZE]{0};
-        common::make_scope_guard([&]() { delete[] raw; });
-
+        char *raw = io_buf_.get();
         db_io_.seekg(0);
         db_io_.read(raw, config::PAGE_SIZE);
         if (db_io_.bad())
@@ -98,25 +97,26 @@ public:
 
     // read record pages into std::shared_ptr<Page>
     tl::expected<std::shared_ptr<Page>, ErrorCode> read_page(page_id_t pgno) {
-        int offset = pgno * config::PAGE_SIZE;
-        char *data;
+        auto page = std::make_shared<Page>(pgno);
+        auto ec = read_page(pgno, *page);
+        if (ec != ErrorCode::Success)
+            return tl::unexpected(ec);
+        return page;
+    }
+
+    // read the page @pgno into @page in place, through the staging buffer of
+    // the disk manager so that no allocation is involved.
+    ErrorCode read_page(page_id_t pgno, Page &page) {
         // check if read beyond file length
-        if (offset > std::filesystem::file_size(db_file_)) {
-            // FIXME: debug
-            throw std::runtime_error("DiskReadOverflow");
-            return tl::unexpected(ErrorCode::DiskReadOverflow);
-        }
-        data = new char[config::PAGE_SIZE]();
-        auto data_remove = common::make_scope_guard([&]() {
-            if (data)
-                delete data;
-            data = nullptr;
-        });
+        if (pgno >= file_header_.page_count)
+            return ErrorCode::DiskReadOverflow;
+
+        char *data = io_buf_.get();
         // set read cursor to offset
-        db_io_.seekp(offset);
+        db_io_.seekg(static_cast<size_t>(pgno) * config::PAGE_SIZE);
         db_io_.read(data, config::PAGE_SIZE);
         if (db_io_.bad()) {
-            return tl::unexpected(ErrorCode::DiskReadError);
+            return ErrorCode::DiskReadError;
         }
 
         // if file ends before reading PAGE_SIZE
@@ -124,41 +124,67 @@ public:
         // read less than a page.
         if (read_count < config::PAGE_SIZE) {
             db_io_.clear();
-            // std::cout << "Read less than a page" << std::endl;
+            ::memset(data + read_count, 0, config::PAGE_SIZE - read_count);
         }
-        std::shared_ptr<Page> page = std::make_shared<Page>(data);
-        page->hdr.pgno = pgno;
+        page.deserizalize(data);
+        page.hdr.pgno = pgno;
 
-        return page;
+        return ErrorCode::Success;
+    }
+
+    // read @count consecutive pages starting from @first in a single disk
+    // read, into the @count * PAGE_SIZE bytes of @data, for the caller to
+    // deserialize in place.
+    ErrorCode read_pages(page_id_t first, size_t count, char *data) {
+        if (first == 0 || first + count > file_header_.page_count)
+            return ErrorCode::DiskReadOverflow;
+
+        size_t len = count * config::PAGE_SIZE;
+        db_io_.seekg(static_cast<size_t>(first) * config::PAGE_SIZE);
+        db_io_.read(data, len);
+        if (db_io_.bad()) {
+            return ErrorCode::DiskReadError;
+        }
+        // the file ends before the last page is allocated on disk.
+        size_t read_count = db_io_.gcount();
+        if (read_count < len) {
+            db_io_.clear();
+            ::memset(data + read_count, 0, len - read_count);
+        }
+        return ErrorCode::Success;
     }
 
     ErrorCode write_page(std::shared_ptr<Page> page) {
-        auto result = page->serialize();
-        if (!result) {
+        return write_page(*page);
+    }
+
+    // NOTE: serialized into the staging buffer, no allocation involved.
+    ErrorCode write_page(const Page &page) {
+        auto ec = page.serialize(io_buf_.get());
+        if (ec != ErrorCode::Success) {
             Log::GlobalLog() << "[DiskManager]: failed to serialize page "
-                             << page->pgno() << std::endl;
-            return result.error();
+                             << page.pgno() << std::endl;
+            return ec;
         }
 
-        page_id_t pgno = page->pgno();
-        std::shared_ptr<char> raw = result.value();
+        page_id_t pgno = page.pgno();
         // set write cursor to offset
         uint32_t offset = static_cast<size_t>(pgno) * config::PAGE_SIZE;
         db_io_.seekp(offset);
 
         // write to the file
-        db_io_.write(raw.get(), config::PAGE_SIZE);
+        db_io_.write(io_buf_.get(), config::PAGE_SIZE);
         // check for I/O error
         if (db_io_.bad()) {
             Log::GlobalLog() << "[DiskManager]: failed to write page "
-                             << page->pgno() << std::endl;
+                             << page.pgno() << std::endl;
             return ErrorCode::DiskWriteError;
         }
 
         // flush to keep disk file in sync
         db_io_.flush();
         // Log::GlobalLog() << "[DiskManager]: succeed to write page "
-        //                  << page->pgno() << std::endl;
+        //                  << page.pgno() << std::endl;
         return ErrorCode::Success;
     }
 
@@ -166,6 +192,20 @@ public:
     // NOTE: if a new page is allocated, only the pgno field in its header is
     // set. It's the caller's responsibility to init it and write to the disk!!!
     tl::expected<std::shared_ptr<Page>, ErrorCode> get_free_page() {
+        page_id_t page_count = file_header_.page_count;
+        return allocate_page().and_then(
+            [&](page_id_t pgno) -> tl::expected<std::shared_ptr<Page>,
+                                                ErrorCode> {
+                if (pgno < page_count)
+                    return read_page(pgno);
+                // NOTE: only as a placeholder, no any data on the new page.
+                return std::make_shared<Page>(pgno);
+            });
+    }
+
+    // pick a free page, or allocate a new page if no more free pages, and
+    // return its page number without reading it.
+    tl::expected<page_id_t, ErrorCode> allocate_page() {
         page_id_t free_page = file_header_.page_count;
 
         // FIXME: O(n); use linked list to collect the free page.
@@ -180,7 +220,7 @@ public:
             update_file_header();
             Log::GlobalLog()
                 << "[DiskManager]: found free page " << free_page << std::endl;
-            return read_page(free_page);
+            return free_page;
         }
 
         // no more free pages, allocate a new one
@@ -191,10 +231,6 @@ public:
         std::filesystem::resize_file(
             db_file_, std::filesystem::file_size(db_file_) + config::PAGE_SIZE);
 
-        // NOTE: only as a placeholder, no any data on the new page.
-        std::shared_ptr<Page> page =
-            std::make_shared<Page>(file_header_.page_count);
-
         // Log::GlobalLog() << std::format("[DiskManager]: allocate new page
         // {}",
         //                                 page->pgno())
@@ -205,7 +241,7 @@ public:
         file_header_.use_count++;
         update_file_header();
 
-        return page;
+        return file_header_.page_count - 1;
     }
 
     // NOTE: lazy free: only append the to-be-freed page to the free list. it is
@@ -221,6 +257,9 @@ public:
         return ErrorCode::InvalidPageNum;
     }
 
+    // the path the file was opened by.
+    const std::string &filename() const { return db_file_; }
+
 #ifdef DEBUG
     // debug only
     std::fstream &io() { return db_io_; }
@@ -252,6 +291,9 @@ private:
 
     const std::string db_file_;
     std::fstream db_io_;
+    // a page-size buffer to (de)serialize pages through.
+    std::unique_ptr<char[]> io_buf_ =
+        std::make_unique<char[]>(config::PAGE_SIZE);
 
 #ifdef DEBUG
 public:
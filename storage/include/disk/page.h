@@ -14,6 +14,9 @@ namespace storage {
 // PageHdr is a common header for all type of pages.
 struct PageHdr {
     index_id_t index;
+    // the bytes of the deleted records of an index page, which take room
+    // until the page is repacked, see Frame::delete_record().
+    uint16_t deleted_bytes;
     // the number of the page
     page_id_t pgno;
 
@@ -31,20 +34,22 @@ struct PageHdr {
     uint8_t level;
     // TODO: use page type instead.
     bool is_leaf;
+    // the length of the key prefix of an index page, see Frame::key_prefix().
+    uint16_t key_prefix_len;
     page_id_t parent_page;
-    page_off_t parent_record_off;
 
     // default construction for later deserizaliztion.
     PageHdr(page_id_t pgno)
-        : index(0), pgno(pgno), number_of_records(0),
+        : index(0), deleted_bytes(0), pgno(pgno), number_of_records(0),
           last_inserted(config::INDEX_PAGE_FIRST_RECORD_OFFSET), prev_page(0),
-          next_page(0), level(0), is_leaf(false), parent_page(0),
-          parent_record_off(0) {}
+          next_page(0), level(0), is_leaf(false), key_prefix_len(0),
+          parent_page(0) {}
 
     template <class Archive>
     void serialize(Archive &archive) {
-        archive(pgno, number_of_records, last_inserted, prev_page, next_page,
-                level, is_leaf, parent_page, parent_record_off);
+        archive(deleted_bytes, pgno, number_of_records, last_inserted,
+                prev_page, next_page, level, is_leaf, key_prefix_len,
+                parent_page);
     }
 };
 
@@ -87,6 +92,8 @@ struct Page {
 
     // @return a shared_ptr to a page-size char block
     tl::expected<std::shared_ptr<char>, ErrorCode> serialize() const;
+    // serialize into @raw, a page-size char block.
+    ErrorCode serialize(char *raw) const;
 
     // template<class Archive>
     // void serialize(Archive &archive) {
@@ -1,12 +1,14 @@
 #ifndef STORAGE_INCLUDE_INDEX_CURSOR_H
 #define STORAGE_INCLUDE_INDEX_CURSOR_H
 
+#include "index/record_view.h"
 #include "types.h"
 namespace storage {
 
 template <typename R>
 struct Cursor {
     page_id_t page;
+    // the start of the record in the page.
     page_off_t offset;
     R record;
 
@@ -14,5 +16,15 @@ struct Cursor {
         : page(page), offset(offset), record(record) {}
 };
 
+// NodeCursor is a record of the index page being worked on, read in place.
+struct NodeCursor {
+    // the slot of the record, see Frame::slot(). it's the number of records
+    // of the page for the end of the page, which has no record.
+    int slot;
+    // the start of the record.
+    page_off_t offset;
+    RecordView record;
+};
+
 } // namespace storage
 #endif // !STORAGE_INCLUDE_INDEX_CURSOR_H
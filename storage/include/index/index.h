@@ -12,35 +12,62 @@
 #include "index/index_node.h"
 #include "log.h"
 #include "types.h"
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <stdexcept>
 #include <tl/expected.hpp>
+#include <utility>
 #include <vector>
 
 namespace storage {
 
+class IndexIterator;
+
+// the pages an index takes, see Index::page_usage().
+struct PageUsage {
+    size_t pages = 0;
+    // the payload bytes taken by the key prefixes, the live records and their
+    // slots.
+    size_t used_bytes = 0;
+    // the part of @used_bytes in internal pages.
+    size_t internal_bytes = 0;
+    // the bytes of the deleted records not taken back yet.
+    size_t deleted_bytes = 0;
+};
+
 // Index is the logical structure of a clustered index in the database which is
 // a B+ tree in fact.
 // a Index is built on leaf nodes and non-leaf nodes, both of which are
 // instances of class IndexNode.
 // NOTE: the first record of every index page has the minimum and has no
 // meaning, only to serve as a placeholder for navigation.
-// TODO: bulk-loading
+// NOTE: lookups never latch: they read the frames optimistically and restart
+// once a validation fails. writers are serialized and latch every frame they
+// touch in a WriteScope. traversals and scans are not synchronized yet.
 class Index {
+    friend class IndexIterator;
+
 public:
 #ifdef DEBUG
 #endif // DEBUG
     using RecordTraverseFunc = std::function<void(LeafClusteredRecord &)>;
     template <typename N, typename R>
     using NodeTraverseFunc = std::function<void(IndexNode<N, R> *)>;
+    // a stream of rows: set @key and @value to the next row, or return false
+    // once the stream is exhausted.
+    using RowSource = std::function<bool(Key &key, Column &value)>;
 
 public:
-    Index(const std::string &db_file, const IndexMeta &meta, std::ostream &os)
-        : pool_(std::make_unique<BufferPoolManager>(
-              config::DEFAULT_POOL_SIZE,
-              std::make_shared<DiskManager>(db_file))),
-          meta_(meta), log_(os) {}
+    // the index is served by @pool, the process-wide pool by default.
+    Index(const std::string &db_file, const IndexMeta &meta, std::ostream &os,
+          std::shared_ptr<BufferPoolManager> pool = BufferPoolManager::shared())
+        : meta_(meta), pool_(std::move(pool)),
+          file_(pool_->add_file(std::make_shared<DiskManager>(db_file))),
+          log_(os) {}
 
     // Index(std::shared_ptr<DiskManager> disk, const std::string &config_file)
     //     :
@@ -56,17 +83,19 @@ public:
     // }
 
     // construction for new indices.
-    Index(index_id_t id, const std::string &db_file, std::ostream &log)
-        : pool_(std::unique_ptr<BufferPoolManager>(
-              new BufferPoolManager(config::DEFAULT_POOL_SIZE,
-                                    std::make_shared<DiskManager>(db_file)))),
-          meta_{}, log_(log) {}
+    Index(index_id_t id, const std::string &db_file, std::ostream &log,
+          std::shared_ptr<BufferPoolManager> pool = BufferPoolManager::shared())
+        : meta_{}, pool_(std::move(pool)),
+          file_(pool_->add_file(std::make_shared<DiskManager>(db_file))),
+          log_(log) {}
 
     static std::shared_ptr<Index>
     make_index(index_id_t id, const std::string &db_file, const KeyMeta &key,
-               std::vector<FieldMeta> &fields, std::ostream &log) {
+               std::vector<FieldMeta> &fields, std::ostream &log,
+               std::shared_ptr<BufferPoolManager> pool =
+                   BufferPoolManager::shared()) {
         // FIXME: new_root_frame().
-        auto index = std::make_shared<Index>(id, db_file, log);
+        auto index = std::make_shared<Index>(id, db_file, log, std::move(pool));
         auto result = index->allocate_frame(id, 0, true);
         if (!result) {
             Log::GlobalLog()
@@ -78,53 +107,230 @@ public:
         }
 
         index->meta_ = IndexMeta::make_index_meta(id, key, fields);
-        index->meta_.root_page = result.value()->pgno();
+        index->set_root(result.value(), index->meta_.depth);
         Log::GlobalLog() << "[index]: make new index of id " << id << std::endl;
         return index;
     }
 
-    ~Index() = default;
+    // make a new index of the composite key of @key_columns.
+    static std::shared_ptr<Index>
+    make_index(index_id_t id, const std::string &db_file,
+               const std::vector<KeyMeta> &key_columns,
+               std::vector<FieldMeta> &fields, std::ostream &log,
+               std::shared_ptr<BufferPoolManager> pool =
+                   BufferPoolManager::shared()) {
+        KeyMeta key = {"", storage::key_t(KeyType::Composite)};
+        auto index = make_index(id, db_file, key, fields, log, std::move(pool));
+        index->meta_.record_meta.key_columns = key_columns;
+        return index;
+    }
+
+    // write back and drop the pages of the index from the pool.
+    ~Index() {
+        pool_->swizzle_root(root_frame_, nullptr);
+        auto ec = pool_->remove_file(file_);
+        if (ec != ErrorCode::Success)
+            Log::GlobalLog() << "[Index]: failed to drop the pages of index "
+                             << meta_.id << ", reason: " << ec << std::endl;
+    }
 
     // get the left sibling or the desired record, whose is <= disired recor.
     tl::expected<Cursor<LeafClusteredRecord>, ErrorCode>
     get_cursor(const Key &key);
     // search for the desired record.
     tl::expected<LeafClusteredRecord, ErrorCode> search_record(const Key &key);
+    // search_record() of every key of @keys, the results in the order of
+    // @keys. the keys are searched in key order, level by level: the keys of
+    // a page share its read, and the pages of a level missing from the pool
+    // are prefetched together before any of them is read.
+    std::vector<tl::expected<LeafClusteredRecord, ErrorCode>>
+    multi_get(std::span<const Key> keys);
     // insert a clusterd leaf record.
     ErrorCode insert_record(const Key &key, const Column &value);
+    // insert_record() of every row of @rows, the results in the order of
+    // @rows: the rows are inserted in key order, the ones of a leaf after one
+    // descent to it. a leaf that fills up is split, and the rows left descend
+    // again to its halves, which may be split in turn. a row whose key an
+    // earlier row of @rows takes gets KeyAlreadyExist.
+    std::vector<ErrorCode>
+    insert_batch(std::span<const std::pair<Key, Column>> rows);
     // remove a clusterd leaf record.
     ErrorCode remove_record(const Key &key);
 
+    // build the empty index from the rows of @source in strictly ascending
+    // key order: the leaves are filled left to right up to @fill_factor
+    // percent of a page, and the internal levels built bottom-up over them
+    // as the leaves are done, the pages allocated one after another.
+    // NOTE: for an index nobody reads or writes yet. a row out of order, of
+    // InvalidInsertPos, or a duplicate key stops the load with the rows
+    // before it loaded.
+    ErrorCode bulk_load(const RowSource &source,
+                        size_t fill_factor = config::INDEX_PAGE_FILL_FACTOR);
+
+    // visit the records whose keys start with @prefix in key order. @prefix
+    // is the first columns of a composite key, a key of any other type only
+    // matches itself.
+    ErrorCode scan_prefix(const Key &prefix, const RecordTraverseFunc &func);
+    // NOTE: for the records of a key range, in either order, see
+    // IndexIterator.
+
     template <typename N, typename R>
     ErrorCode full_node_scan(NodeTraverseFunc<N, R> func);
     ErrorCode full_scan(RecordTraverseFunc func);
 
     void traverse(const RecordTraverseFunc &func);
+    // the pages of the index.
+    // NOTE: not synchronized with writers, like traverse().
+    PageUsage page_usage();
+    // visit the records in descending key order.
     void traverse_r(const RecordTraverseFunc &func);
 
-    int depth() const { return meta_.depth; }
+    int depth() const {
+        return std::atomic_ref(const_cast<int &>(meta_.depth))
+            .load(std::memory_order_acquire);
+    }
 
     index_id_t id() const { return meta_.id; }
+    // the key and field types of the index, see RecordMeta::make_key().
+    const RecordMeta &record_meta() const { return meta_.record_meta; }
 
     int number_of_records() const { return meta_.number_of_records; }
 
-private:
-    tl::expected<Frame *, ErrorCode> move_frame(Frame *child);
-    tl::expected<Frame *, ErrorCode> move_frame(Frame *frame, size_t number);
+    // the buffer pool of the index, for resizing and introspection.
+    BufferPoolManager *pool() const { return pool_.get(); }
+    // the file of the index in its pool.
+    file_id_t file() const { return file_; }
+    // keep at least @frames frames of the pool for the index.
+    ErrorCode reserve_frames(size_t frames) {
+        return pool_->reserve(file_, frames);
+    }
 
+private:
     tl::expected<Frame *, ErrorCode> new_nonleaf_root(Frame *child);
-    auto get_root_frame() { return pool_->get_frame(meta_.root_page); }
+    auto get_root_frame() { return get_frame(root_page()); }
+    // get a page of the index.
+    tl::expected<Frame *, ErrorCode> get_frame(page_id_t pgno) {
+        return pool_->get_frame(file_, pgno);
+    }
 
+    // NOTE: the root changes under writers while readers read it.
+    page_id_t root_page() const {
+        return std::atomic_ref(const_cast<page_id_t &>(meta_.root_page))
+            .load(std::memory_order_acquire);
+    }
+    void set_root(Frame *root, int depth) {
+        pool_->swizzle_root(root_frame_, root);
+        std::atomic_ref(meta_.depth).store(depth, std::memory_order_release);
+        std::atomic_ref(meta_.root_page)
+            .store(root->pgno(), std::memory_order_release);
+    }
+
+    // descend to the leaf of @key, latching every frame on the path.
+    // NOTE: for writers inside a WriteScope only.
     tl::expected<Frame *, ErrorCode> search_leaf(const Key &key);
+    // descend to the leaf of @key optimistically, restarting on conflicts.
+    // @version is the version of the leaf to validate the reads on it.
+    // @fence gets the least key of the leaves after it, if asked for.
+    tl::expected<Frame *, ErrorCode>
+    search_leaf(const Key &key, uint64_t &version,
+                std::optional<std::string> *fence = nullptr);
+    // descend to the first leaf of the index, or the @last one,
+    // optimistically like search_leaf().
+    tl::expected<Frame *, ErrorCode> search_edge_leaf(bool last,
+                                                      uint64_t &version);
+    // the leaf of @key, or the first or the @last leaf if @key is null.
+    // return ReadConflict if the descent has to restart.
+    tl::expected<Frame *, ErrorCode>
+    try_search_leaf(const Key *key, bool last, uint64_t &version,
+                    std::optional<std::string> *fence = nullptr);
+    // descend optimistically and latch the leaf of @key in @scope.
+    tl::expected<Frame *, ErrorCode>
+    latch_leaf(const Key &key, WriteScope &scope,
+               std::optional<std::string> *fence = nullptr);
+    void page_usage(Frame *frame, PageUsage &usage);
+    // keep the frame resident if it's an internal page in the upper
+    // config::PINNED_INDEX_LEVELS levels of the tree.
+    void protect_upper_frame(Frame *frame);
     // void rebalance(LeafIndexNode *node);
     template <typename N>
     ErrorCode balance_for_delete(Frame *frame);
+    // split the leaf @frame, and its parents first if they're full.
     ErrorCode balance_for_insert(Frame *frame);
     ErrorCode balance_for_insert_internal(Frame *frame);
     ErrorCode safe_node_split(Frame *frame, Frame *parent_frame);
+    // the number of the last records of @frame a split moves.
+    int split_count(Frame *frame);
+    // the keys of @frame and of the new frame a split of the last @n2
+    // records of @frame sets in the parent.
+    std::pair<Key, Key> split_keys(Frame *frame, int n2);
+    bool parent_fits_split(Frame *frame, Frame *parent_frame);
+    static bool fits_split(Frame *parent_frame, const Key &old_key,
+                           const Key &new_key);
     bool sibling_union_check(Frame *frame);
+    static bool fits_union(Frame *left_frame, Frame *right_frame);
     void union_frame(Frame *, Frame *);
 
+    // the state of a bulk_load().
+    struct BulkLoad {
+        // the bytes of a page filled.
+        size_t fill_bytes = 0;
+        // the rows of the next leaf, their bytes with the slots and the full
+        // keys, and the normalized first key and the key prefix of the leaf.
+        std::vector<std::pair<Key, Column>> rows = {};
+        size_t row_bytes = 0;
+        std::string first = {};
+        size_t prefix_len = 0;
+        // the normalized key of the last row.
+        std::string last = {};
+        // the last leaf written, and its first and last key.
+        page_id_t leaf = 0;
+        Key leaf_first = {}, leaf_last = {};
+        // the last page of every internal level, from the bottom up.
+        std::vector<page_id_t> levels = {};
+    };
+    ErrorCode bulk_add(BulkLoad &load, Key key, Column value);
+    ErrorCode bulk_flush_leaf(BulkLoad &load);
+    // add the record of @key of the page @child to the internal @level.
+    ErrorCode bulk_add_child(BulkLoad &load, size_t level, const Key &key,
+                             page_id_t child);
+    ErrorCode bulk_finish(BulkLoad &load);
+
+    // the state of a multi_get().
+    struct MultiGet {
+        // the keys of the index type, their positions in the keys asked
+        // for, and their key order.
+        std::vector<NormalizedKey> normalized;
+        std::vector<size_t> positions;
+        std::vector<size_t> sorted;
+        std::vector<tl::expected<LeafClusteredRecord, ErrorCode>> results;
+        // the positions of the keys left to search_record().
+        std::vector<size_t> conflicts;
+        // the max number of pages of a level prefetched at once, and the
+        // children of a window missing from the pool.
+        size_t window;
+        std::vector<page_id_t> missing;
+
+        // the key and the result of the @k-th key in key order.
+        const NormalizedKey &key(size_t k) const {
+            return normalized[sorted[k]];
+        }
+        tl::expected<LeafClusteredRecord, ErrorCode> &result(size_t k) {
+            return results[positions[sorted[k]]];
+        }
+        void conflict(size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++)
+                conflicts.push_back(positions[sorted[k]]);
+        }
+    };
+    // the keys [begin, end) of MultiGet::sorted going through a page.
+    struct MultiGetGroup {
+        Frame *frame;
+        uint64_t version;
+        size_t begin, end;
+    };
+    // resolve the keys of @group, whose page has been got and not read yet.
+    void multi_get_page(MultiGet &get, const MultiGetGroup &group);
+
     // responsible to init a new frame. @child is only used when initing a
     // internal frame.
     // FIXME: use 2 separate functions
@@ -137,10 +343,18 @@ private:
 
 private:
     IndexMeta meta_;
-    std::unique_ptr<BufferPoolManager> pool_;
+    std::shared_ptr<BufferPoolManager> pool_;
+    file_id_t file_;
 
     Comparator comp_;
     std::ostream &log_;
+    // serialize the writers of the index, across its WriteScopes.
+    // NOTE: a WriteScope also serializes them with the writers of the other
+    // indices of the pool.
+    std::mutex write_latch_;
+    // the root frame referenced directly, like a swizzled child, see
+    // BufferPoolManager::swizzle_root().
+    std::atomic<Frame *> root_frame_ = nullptr;
 };
 
 } // namespace storage
@@ -0,0 +1,117 @@
+#ifndef STORAGE_INCLUDE_INDEX_INDEX_BUILDER_H
+#define STORAGE_INCLUDE_INDEX_INDEX_BUILDER_H
+
+#include "config.h"
+#include "error.h"
+#include "index/index.h"
+#include "index/record_view.h"
+#include "noncopyable.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace storage {
+
+// the sizes and the per-phase timings of an IndexBuilder::build().
+struct IndexBuildStats {
+    size_t rows = 0;
+    // the rows dropped for a key of an earlier row.
+    size_t duplicates = 0;
+    size_t runs = 0;
+    // the runs written into run files.
+    size_t spilled_runs = 0;
+
+    // the wall time of reading the input into sorted runs.
+    uint64_t run_ns = 0;
+    // the time the sorting threads spent sorting and spilling the runs, all
+    // threads summed.
+    uint64_t sort_ns = 0;
+    uint64_t spill_ns = 0;
+    // the wall time of merging the runs into the index.
+    uint64_t merge_ns = 0;
+
+    void export_text(std::ostream &os) const;
+};
+
+// IndexBuilder builds an index from rows in any order, like a nightly
+// rebuild from a dump. the input is cut into runs of a share of the memory
+// budget, which a pool of threads sorts while the input is read on. a sorted
+// run stays in memory as long as the sorted runs fit in the budget, and is
+// written into a run file in @dir otherwise. the runs are then merged k-way
+// straight into Index::bulk_load().
+// the index is the one of inserting the rows one by one: the first row of a
+// key is in, the later ones are dropped as Index::insert_record() refuses
+// them of KeyAlreadyExist.
+// NOTE: a run is a buffer of leaf records with the whole keys, see
+// RecordView, and its offsets in key order. a run file is its records in key
+// order, which tell their lengths.
+class IndexBuilder : NonCopyable {
+public:
+    IndexBuilder(Index &index, std::string dir,
+                 size_t memory = config::INDEX_BUILD_MEMORY,
+                 size_t threads = config::INDEX_BUILD_THREADS)
+        : index_(index), dir_(std::move(dir)), memory_(memory),
+          threads_(std::max<size_t>(threads, 1)) {}
+    // remove the run files.
+    ~IndexBuilder();
+
+    // build the empty index from the rows of @source.
+    ErrorCode build(const Index::RowSource &source);
+
+    const IndexBuildStats &stats() const { return stats_; }
+
+private:
+    struct Run {
+        // the position of the run in the input.
+        size_t number;
+        std::vector<char> records;
+        // the offsets of the records, in key order once sorted.
+        std::vector<uint32_t> offsets;
+        // the run file, if the run has been spilled.
+        std::string path;
+    };
+
+    // read the rows of @source into runs and sort them.
+    ErrorCode make_runs(const Index::RowSource &source);
+    // sort the runs handed over by make_runs() till there is none.
+    void sort_runs();
+    ErrorCode spill(Run &run);
+    ErrorCode merge();
+
+    // the record at @offset of @records.
+    static RecordView record_at(const std::vector<char> &records,
+                                uint32_t offset) {
+        char *data = const_cast<char *>(records.data()) + offset;
+        return RecordView(data, record_format::read<uint16_t>(data));
+    }
+
+    Index &index_;
+    std::string dir_;
+    size_t memory_;
+    size_t threads_;
+    IndexBuildStats stats_;
+
+    // the runs in the order of the input, which decides between the rows of
+    // a key.
+    std::vector<std::unique_ptr<Run>> runs_;
+
+    // the runs read and not sorted yet.
+    std::mutex latch_;
+    std::condition_variable cond_;
+    std::deque<Run *> unsorted_;
+    bool input_done_ = false;
+    // the bytes of the sorted runs kept in memory.
+    size_t sorted_bytes_ = 0;
+    ErrorCode error_ = ErrorCode::Success;
+};
+
+} // namespace storage
+
+#endif // !STORAGE_INCLUDE_INDEX_INDEX_BUILDER_H
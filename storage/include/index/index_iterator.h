@@ -0,0 +1,86 @@
+#ifndef STORAGE_INCLUDE_INDEX_INDEX_ITERATOR_H
+#define STORAGE_INCLUDE_INDEX_INDEX_ITERATOR_H
+
+#include "config.h"
+#include "error.h"
+#include "index/index.h"
+#include "index/normalized_key.h"
+#include "index/record.h"
+#include "noncopyable.h"
+#include "types.h"
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <tl/expected.hpp>
+#include <vector>
+
+namespace storage {
+
+// the records an IndexIterator visits, in key order or in the @reverse one.
+// a bound left empty doesn't bound the range.
+struct ScanRange {
+    std::optional<Key> lower = std::nullopt;
+    bool lower_inclusive = true;
+    std::optional<Key> upper = std::nullopt;
+    bool upper_inclusive = true;
+    // the max number of records visited.
+    size_t limit = std::numeric_limits<size_t>::max();
+    // the max number of records read in one IndexIterator::next_batch().
+    size_t batch = config::INDEX_SCAN_BATCH;
+    // from @upper down to @lower, like the latest events first.
+    bool reverse = false;
+};
+
+// IndexIterator streams the records of a ScanRange of an index: it seeks the
+// leaf of the lower bound, and follows the next_page links of the leaves from
+// then on, without going through the internal pages again. a reverse scan
+// seeks the leaf of the upper bound and follows the prev_page links.
+// a sibling is only followed if it links back to the leaf left, otherwise it
+// has been split or merged meanwhile and the scan descends again.
+// NOTE: a batch is read like Index::scan_prefix(): a leaf is validated before
+// its records are taken, and a conflict descends again from the last record
+// taken. no frame is held between the batches, every batch descends once to
+// the leaf of the last record of the batch before, so that the records
+// written meanwhile behind it are visited.
+class IndexIterator : NonCopyable {
+public:
+    IndexIterator(Index &index, ScanRange range)
+        : index_(index), range_(std::move(range)) {
+        auto &start = range_.reverse ? range_.upper : range_.lower;
+        auto &end = range_.reverse ? range_.lower : range_.upper;
+        from_ = start;
+        past_ = !(range_.reverse ? range_.upper_inclusive
+                                 : range_.lower_inclusive);
+        if (end)
+            end_.emplace(end.value());
+    }
+
+    // fill @batch with the next records of the range, up to the batch size.
+    // @return false once the range has no more records.
+    tl::expected<bool, ErrorCode>
+    next_batch(std::vector<LeafClusteredRecord> &batch);
+
+    // the next record of the range, read a batch at a time.
+    // @return false once the range has no more records.
+    tl::expected<bool, ErrorCode> next(LeafClusteredRecord &record);
+
+private:
+    Index &index_;
+    ScanRange range_;
+    // the bound the scan ends at.
+    std::optional<NormalizedKey> end_;
+    // where the next batch starts, the first or the last record of the index
+    // if none, and whether it starts past @from_ in the order of the scan.
+    std::optional<Key> from_;
+    bool past_;
+    size_t visited_ = 0;
+    bool done_ = false;
+
+    // the batch next() hands out.
+    std::vector<LeafClusteredRecord> buffer_;
+    size_t buffered_ = 0;
+};
+
+} // namespace storage
+
+#endif // !STORAGE_INCLUDE_INDEX_INDEX_ITERATOR_H
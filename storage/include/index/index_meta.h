@@ -28,8 +28,11 @@ struct IndexMeta {
                 number_of_records);
     }
 
-    static IndexMeta make_index_meta(index_id_t id, const KeyMeta &key,
-                                     const std::vector<FieldMeta> &fields) {
+    // @key_columns are the columns of a composite key.
+    static IndexMeta
+    make_index_meta(index_id_t id, const KeyMeta &key,
+                    const std::vector<FieldMeta> &fields,
+                    const std::vector<KeyMeta> &key_columns = {}) {
         return IndexMeta{
             .id = id,
             .is_primary = true,
@@ -38,6 +41,7 @@ struct IndexMeta {
             .record_meta =
                 {
                     .key = key,
+                    .key_columns = key_columns,
                     .fields = fields,
                 },
             .number_of_records = 0,
@@ -10,73 +10,42 @@
 #include "noncopyable.h"
 #include "record.h"
 #include "types.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <optional>
 #include <pthread.h>
+#include <string>
+#include <string_view>
+#include <type_traits>
 #include <tl/expected.hpp>
+#include <vector>
 
 namespace storage {
 
-template <typename REC, typename V>
-void record_value_assign(REC &record, const V &value);
-
-template <>
-void inline record_value_assign<LeafClusteredRecord, Column>(
-    LeafClusteredRecord &record, const Column &value) {
-    record.value = value;
-}
-
-template <>
-void inline record_value_assign<InternalClusteredRecord, page_id_t>(
-    InternalClusteredRecord &record, const page_id_t &value) {
-    record.value = value;
-}
-
 // A IndexNode is a index page handler in the index, responsible for logical
 // operations on a index page.
-// NOTE: for a internal index page, the
-// key of the first record is always set to Infimum, the key of the last record
-// is always set to Supremum.
+// records are read and written in place through NodeCursors, and only
+// materialized as R on request, see RecordView.
+// NOTE: for a internal index page, the key of the first record is always the
+// first key of its child, and serves as the minimal of the page.
 template <typename N, typename R>
 class IndexNode : public NonCopyable {
 public:
     friend class Index;
 
-    struct NodeCursor {
-        // the end of the record.
-        page_off_t offset;
-        R record;
-    };
-
+    using NodeCursor = storage::NodeCursor;
     using TraverseFunc = std::function<void(LeafClusteredRecord &record)>;
 
-    static constexpr int max_number_of_records() {
-        return config::MAX_NUMBER_OF_RECORDS_PER_PAGE;
-    }
-    static constexpr int min_number_of_records() {
-        return config::MAX_NUMBER_OF_RECORDS_PER_PAGE / 2;
-    }
-
-    // NOTE: in this implementation, the number of records == the number of
-    // childs.
-    static constexpr int max_number_of_childs() {
-        return max_number_of_records() + 1;
-    }
-    static constexpr int min_number_of_childs() {
-        return min_number_of_records() + 1;
-    }
-
 public:
     IndexNode(Frame *frame, Comparator &comp) : frame_(frame), comp_(comp) {}
     virtual ~IndexNode() = default;
 
     int level() const { return frame_->page()->hdr.level; }
 
-    bool is_full() const {
-        return number_of_records() >= IndexNode::max_number_of_records();
-    }
+    bool is_full() const { return frame_->is_full(); }
 
-    bool is_half_full() const {
-        return number_of_records() == (IndexNode::max_number_of_records() / 2);
-    }
+    bool is_half_full() const { return frame_->is_half_full(); }
 
     bool is_empty() const { return frame_->page()->hdr.number_of_records == 0; }
 
@@ -91,582 +60,564 @@ public:
     Key get_key() {
         if (number_of_records() == 0)
             return Key{};
-        auto first = first_user_cursor();
-        return first.record.key;
+        return first_user_cursor().record.key().key();
     }
 
-    virtual page_off_t get_child(NodeCursor &cursor) = 0;
+    virtual page_id_t get_child(NodeCursor &cursor) = 0;
 
-    // search for the left sibling or the desired key, whose is <= desired
-    // record, or the first user record.
-    // FIXME: use binary search?
-    tl::expected<Cursor<R>, ErrorCode> get_cursor(const Key &key) {
-        auto cursor = first_user_cursor();
-
-        int i = 0;
-        // found the right sibling
-        while (i < number_of_records()) {
-            auto &record = cursor.record;
-            if (record.key.index() != key.index())
-                return tl::unexpected(ErrorCode::InvalidKeyType);
-            else if (record.key == key)
-                return Cursor<R>{frame_->pgno(), cursor.offset, cursor.record};
-            else if (record.key > key)
-                break;
-
-            cursor = next_cursor(cursor);
-            i++;
-        }
-        // Log::GlobalLog() << i << std::endl;
-
-        // return the first user record.
-        if (i == 0)
-            return Cursor<R>{frame_->pgno(), cursor.offset, cursor.record};
+    // search for the left sibling or the desired record, whose key is <=
+    // @key, or the first user record.
+    tl::expected<NodeCursor, ErrorCode> search_cursor(const Key &key) {
+        return search_cursor(NormalizedKey(key));
+    }
+    tl::expected<NodeCursor, ErrorCode>
+    search_cursor(const NormalizedKey &key) {
+        bool found;
+        auto cursor = seek(key, found);
+        if (!cursor || found || cursor.value().slot == 0)
+            return cursor;
+        return prev_cursor(cursor.value());
+    }
 
-        cursor = prev_cursor(cursor);
-        return Cursor<R>{frame_->pgno(), cursor.offset, cursor.record};
+    // the materialized search_cursor().
+    tl::expected<Cursor<R>, ErrorCode> get_cursor(const Key &key) {
+        return search_cursor(key).map([this](const NodeCursor &cursor) {
+            return Cursor<R>{frame_->pgno(), cursor.offset,
+                             cursor.record.template materialize<R>()};
+        });
     }
 
     // get the record whose key == @key
     tl::expected<R, ErrorCode> search_record(const Key &key) {
-        R record;
-        // NOTE: first record of an internal index page is always the minimal
-        // and meaningless.
-        auto cursor = first_user_cursor();
-
-        int i = 0;
-        // found the the desired record.
-        while (i < number_of_records()) {
-            auto &record = cursor.record;
-            if (record.key.index() != key.index())
-                return tl::unexpected(ErrorCode::InvalidKeyType);
-            else if (record.key == key)
-                return record;
-            else if (record.key > key)
-                break;
-
-            cursor = next_cursor(cursor);
-            i++;
-        }
-
-        return tl::unexpected(ErrorCode::KeyNotFound);
+        return search_record(NormalizedKey(key));
+    }
+    tl::expected<R, ErrorCode> search_record(const NormalizedKey &key) {
+        bool found;
+        auto cursor = seek(key, found);
+        if (!cursor)
+            return tl::unexpected(cursor.error());
+        if (!found)
+            return tl::unexpected(ErrorCode::KeyNotFound);
+        return cursor.value().record.template materialize<R>();
     }
 
     template <typename V>
     tl::expected<NodeCursor, ErrorCode> insert_record(const Key &key,
                                                       const V &value) {
-        R record;
-        // NOTE: first record of an internal index page is always the minimal
-        // and meaningless.
-        auto cursor = first_user_cursor();
-
-        int i = 0;
-        // found the right sibling
-        while (i < number_of_records()) {
-            auto &record = cursor.record;
-            if (record.key.index() != key.index())
-                return tl::unexpected(ErrorCode::InvalidKeyType);
-            else if (record.key == key)
-                return tl::unexpected(ErrorCode::KeyAlreadyExist);
-            else if (record.key > key)
-                break;
+        bool found;
+        auto cursor = seek(key, found);
+        if (!cursor)
+            return cursor;
+        if (found)
+            return tl::unexpected(ErrorCode::KeyAlreadyExist);
 
-            cursor = next_cursor(cursor);
-            i++;
-        }
-
-        auto result = insert_record_before(cursor, key, value);
-        // Log::GlobalLog() << "the number of records after insert: "
-        //  << frame_->number_of_records() << std::endl;
-        return result;
+        return insert_record_before(cursor.value(), key, value);
     }
 
     tl::expected<NodeCursor, ErrorCode> remove_record(const Key &key) {
-        R record;
-        // NOTE: first record of an internal index page is always the minimal
-        // and meaningless.
-        auto cursor = first_user_cursor();
+        bool found;
+        auto cursor = seek(key, found);
+        if (!cursor)
+            return cursor;
+        if (!found)
+            return tl::unexpected(ErrorCode::KeyNotFound);
 
-        int i = 0;
-        // found the the desired record.
-        while (i < number_of_records()) {
-            R &record = cursor.record;
-            if (record.key.index() != key.index())
-                return tl::unexpected(ErrorCode::InvalidKeyType);
-            else if (record.key == key) {
-                auto result = remove_record(cursor);
-                // Log::GlobalLog() << "the number of records after remove: "
-                //<< frame_->number_of_records() << std::endl;
-
-                return result;
-            } else if (record.key > key)
-                break;
-
-            cursor = next_cursor(cursor);
-            i++;
-        }
-
-        return tl::unexpected(ErrorCode::KeyNotFound);
+        return remove_record(cursor.value());
     }
 
     template <typename V>
     NodeCursor push_back(const Key &key, const V &value) {
-        auto supre = last_cursor();
-        auto result = insert_record_before(supre, key, value);
-        return result;
+        auto end = end_cursor();
+        return insert_record_before(end, key, value);
+    }
+
+    // copy the record @record to the back of the node.
+    NodeCursor push_back(const RecordView &record) {
+        auto end = end_cursor();
+        return insert_record_before(end, record);
     }
 
     template <typename V>
     NodeCursor push_front(const Key &key, const V &value) {
         auto first = first_user_cursor();
-
         auto result = insert_record_before(first, key, value);
+        update_parent_key(frame_, key);
+        return result;
+    }
 
-        // recursively update the parent record.
-        Frame *frame = frame_;
-        bool is_first = true;
-        while (is_first) {
-            auto parent_frame = frame->parent_frame();
-            if (parent_frame && parent_frame.value()) {
-                auto parent_record = frame->parent_record();
-                parent_record.value().record.key = key;
-                auto pos = parent_frame.value()->dump_at(
-                    parent_record.value().offset -
-                        parent_record.value().record.len(),
-                    parent_record.value().record);
-
-                frame = parent_frame.value();
-                // if the parent record isn't the parent frame's first record,
-                // break the loop.
-                if (parent_record.value().record.hdr.prev_record_offset +
-                        parent_record.value().offset !=
-                    0) {
-                    is_first = false;
-                }
-            } else {
-                break;
-            }
-        }
-
+    // copy the record @record to the front of the node.
+    NodeCursor push_front(const RecordView &record) {
+        auto first = first_user_cursor();
+        auto result = insert_record_before(first, record);
+        update_parent_key(frame_, result.record.key().key());
         return result;
     }
 
-    tl::expected<R, ErrorCode> pop_back() {
+    // NOTE: the popped record stays readable until the next insert into the
+    // node.
+    tl::expected<NodeCursor, ErrorCode> pop_back() {
         if (number_of_records() == 0)
             return tl::unexpected(ErrorCode::PopEmptyNode);
         auto last = last_user_cursor();
-        auto left = prev_cursor(last);
-        auto right = next_cursor(last);
-
-        auto &record = last.record;
-        auto &right_record = right.record;
-        auto &left_record = left.record;
-
-        left_record.hdr.next_record_offset = offset(left, right);
-        right_record.hdr.prev_record_offset = offset(right, left);
-        record.hdr.status = uint8_t(config::RecordStatus::Deleted);
-
-        dump(last);
-        dump(left);
-        dump(right);
-        frame_->page()->hdr.number_of_records--;
-
-        return record;
+        unlink(last);
+        return last;
     }
 
+    // NOTE: the popped record stays readable until the next insert into the
+    // node.
     tl::expected<NodeCursor, ErrorCode> pop_front() {
         if (number_of_records() == 0)
             return tl::unexpected(ErrorCode::PopEmptyNode);
         auto first = first_user_cursor();
-        auto left = prev_cursor(first);
-        auto right = next_cursor(first);
-        auto &record = first.record;
-        auto &right_record = right.record;
-        auto &left_record = left.record;
-
-        left_record.hdr.next_record_offset = offset(left, right);
-        right_record.hdr.prev_record_offset = offset(right, left);
-        record.hdr.status = uint8_t(config::RecordStatus::Deleted);
-
-        dump(first);
-        dump(left);
-        dump(right);
-        frame_->page()->hdr.number_of_records--;
-
-        // recursively update the parent record.
-        Frame *frame = frame_;
-        bool is_first = true;
-        while (is_first) {
-            auto parent_frame = frame->parent_frame();
-            if (parent_frame && parent_frame.value()) {
-                auto parent_record = frame->parent_record();
-                parent_record.value().record.key = right.record.key;
-                auto pos = parent_frame.value()->dump_at(
-                    parent_record.value().offset -
-                        parent_record.value().record.len(),
-                    parent_record.value().record);
-
-                frame = parent_frame.value();
-                // if the parent record isn't the parent frame's first record,
-                // break the loop.
-                if (parent_record.value().record.hdr.prev_record_offset +
-                        parent_record.value().offset !=
-                    0) {
-                    is_first = false;
-                }
-            } else {
-                break;
-            }
-        }
+        unlink(first);
+
+        if (!is_empty())
+            update_parent_key(frame_, get_key());
         return first;
     }
-    // void set_parent_node(IndexNode *parent) { this->parent_node_ = parent; }
-    // IndexNode *parent_node() const { return parent_node_; }
-    //
-    // void set_parent_record(Record *record) { this->parent_record_ = record; }
 
-    // InternalClusteredRecord parent_record() {
-    //     auto parent_page = frame_->page()->hdr.parent_page;
-    //     auto offset = frame_->page()->hdr.parent_record_off;
-    // }
+    // whether push_back() has room for @record.
+    bool can_push_back(const RecordView &record) const {
+        return frame_->has_room(record.key().bytes(),
+                                RecordView::copy_len(record, 0) +
+                                    Frame::SLOT_LEN);
+    }
+
+    // whether push_front() has room for @record, in the node and for its key
+    // in the parents.
+    bool can_push_front(const RecordView &record) const {
+        return can_push_back(record) &&
+               has_room_for_parent_key(frame_, record.key().key());
+    }
+
+    // whether pop_front() has room for the key of the record after the first
+    // one in the parents.
+    bool can_pop_front() {
+        return number_of_records() < 2 ||
+               has_room_for_parent_key(frame_,
+                                       cursor_at_slot(1).record.key().key());
+    }
 
 protected:
+    // binary search for the first record whose key >= @key, or the end of
+    // the node. @found tells whether its key == @key.
+    // NOTE: the key is normalized once, every comparison is a memcmp. the key
+    // is compared with the key prefix of the page once, and only with the
+    // suffixes in the records from then on.
+    tl::expected<NodeCursor, ErrorCode> seek(const Key &key, bool &found) {
+        return seek(NormalizedKey(key), found);
+    }
+    tl::expected<NodeCursor, ErrorCode> seek(const NormalizedKey &normalized,
+                                             bool &found) {
+        int low = 0, high = number_of_records();
+        found = false;
+        if (high > 0 &&
+            !frame_->record_at(frame_->slot(0)).key().same_type(normalized))
+            return tl::unexpected(ErrorCode::InvalidKeyType);
+
+        auto bytes = normalized.bytes();
+        auto prefix = frame_->key_prefix();
+        int cmp = std::memcmp(bytes.data(), prefix.data(),
+                              std::min(bytes.size(), prefix.size()));
+        if (cmp < 0 || (cmp == 0 && bytes.size() < prefix.size()))
+            return first_user_cursor();
+        if (cmp > 0)
+            return end_cursor();
+        auto suffix = bytes.substr(prefix.size());
+
+        while (low < high) {
+            int mid = low + (high - low) / 2;
+            // NOTE: the record compared is the one returned, a torn read may
+            // have lost the slot since @high was read.
+            page_off_t offset = frame_->slot(mid);
+            auto record = frame_->record_at(offset);
+            int cmp = NormalizedKey::compare(record.key().suffix(), suffix);
+            if (cmp == 0) {
+                found = true;
+                return NodeCursor{mid, offset, record};
+            }
+            if (cmp < 0)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        return cursor_at_slot(low);
+    }
+
     template <typename V>
     NodeCursor insert_record_after(NodeCursor &left, const Key &key,
                                    const V &value) {
         auto right = next_cursor(left);
-        R &right_record = right.record;
-        R &left_record = left.record;
-
-        NodeCursor inserted{0, R{}};
-        R &record = inserted.record;
-        record.hdr = {
-            // .order = left_record.hdr.order + 1,
-        };
-        record.key = key;
-        record_value_assign(record, value);
-
-        record.hdr.length = frame_->dump_at(frame_->last_inserted(), record);
-
-        inserted.offset = frame_->ppos();
-        // Log::GlobalLog() << "the end of the last dump: " << frame_->ppos()
-        // << std::endl;
-        record.hdr.next_record_offset = offset(inserted, right);
-        record.hdr.prev_record_offset = offset(inserted, left);
-        left_record.hdr.next_record_offset = offset(left, inserted);
-        right_record.hdr.prev_record_offset = offset(right, inserted);
-
-        // FIXME: cereal serialization determination.
-        dump(inserted);
-        dump(left);
-        dump(right);
-
-        frame_->set_last_inserted(inserted.offset);
-        frame_->page()->hdr.number_of_records++;
-
-        return inserted;
+        return insert_record_before(right, key, value);
     }
 
+    // NOTE: the records of the node move if the key prefix of the page
+    // shrinks for @key, only the slot of @right stays valid.
     template <typename V>
-    NodeCursor insert_record_before(NodeCursor &right_cursor, const Key &key,
+    NodeCursor insert_record_before(NodeCursor &right, const Key &key,
                                     const V &value) {
-        NodeCursor left_cursor = prev_cursor(right_cursor);
-        auto &left_record = left_cursor.record;
-        auto &right_record = right_cursor.record;
-
-        NodeCursor inserted{0, R{}};
-        R &record = inserted.record;
-        record.hdr = {
-            // .order = left_record.hdr.order + 1,
-        };
-        record.key = key;
-        record_value_assign(record, value);
-
-        record.hdr.length = frame_->dump_at(frame_->last_inserted(), record);
-        inserted.offset = frame_->ppos();
-
-        // Log::GlobalLog() << "the end of the inserted record: " <<
-        // frame_->ppos()
-        //                  << std::endl;
-        record.hdr.next_record_offset = offset(inserted, right_cursor);
-        record.hdr.prev_record_offset = offset(inserted, left_cursor);
-        left_record.hdr.next_record_offset = offset(left_cursor, inserted);
-        right_record.hdr.prev_record_offset = offset(right_cursor, inserted);
-
-        // FIXME: cereal serialization determination.
-        dump(left_cursor);
-        dump(inserted);
-        dump(right_cursor);
-
-        frame_->set_last_inserted(inserted.offset);
-        frame_->page()->hdr.number_of_records++;
-
-        return inserted;
-    }
-
-    NodeCursor parent_cursor() {
-        // FIXME;
-    }
-
-    ErrorCode node_split(N &node, int n1, int n2, BufferPoolManager *pool) {
-        // page header update
-        // Log::GlobalLog() << std::format("[{}; {}]\n", n1, n2);
-        if (!frame_->is_full())
+        NormalizedKey normalized(key);
+        auto suffix =
+            normalized.bytes().substr(fit_key_prefix(frame_, normalized));
+        page_off_t offset = allocate_record(
+            frame_, RecordView::encoded_len(suffix.size(), value));
+        RecordView::write(frame_->page()->payload + offset, normalized.type(),
+                          suffix, value);
+        frame_->insert_slot(right.slot, offset);
+        return {right.slot, offset, frame_->record_at(offset)};
+    }
+
+    NodeCursor insert_record_before(NodeCursor &right,
+                                    const RecordView &record) {
+        size_t prefix_len = fit_key_prefix(frame_, record.key());
+        page_off_t offset =
+            allocate_record(frame_, RecordView::copy_len(record, prefix_len));
+        RecordView::copy(frame_->page()->payload + offset, record, prefix_len);
+        frame_->insert_slot(right.slot, offset);
+        return {right.slot, offset, frame_->record_at(offset)};
+    }
+
+    // the number of the last records, about half of the bytes of the node,
+    // node_split() moves.
+    int split_count() {
+        int n = number_of_records();
+        int n2 = 0;
+        size_t half = (frame_->live_bytes() - frame_->key_prefix().size()) / 2;
+        for (size_t bytes = 0; n2 < n - 1 && bytes < half; n2++)
+            bytes += cursor_at_slot(n - 1 - n2).record.length() +
+                     Frame::SLOT_LEN;
+        return n2;
+    }
+
+    // move the last @n2 records to the empty @node, see split_count().
+    ErrorCode node_split(N &node, int n2, BufferPoolManager *pool) {
+        int n = number_of_records();
+        if (n < 2)
             return ErrorCode::NodeNotFull;
 
-        auto frame = node.frame_;
+        // the records moved share the key prefix of the first and the last
+        // one of them.
+        repack(node.frame_, common_key_prefix(n - n2, n - 1));
 
         int i = 0;
         while (i < n2) {
             auto result = pop_back();
             if (!result)
                 return result.error();
-            auto &record = result.value();
-            record.hdr.status = 0;
 
-            auto cursor = node.push_front(record.key, record.value);
+            auto cursor = node.push_front(result.value().record);
             if (!frame_->is_leaf()) {
-                update_record_parent(node, cursor.record, cursor.offset, pool);
+                update_record_parent(node, cursor, pool);
             }
-
-            //  DEBUG
             i++;
         }
 
-        // Log::GlobalLog() << "[IndexNode] left node has "
-        //                  << this->number_of_records() << "; right node has "
-        //                  << node.number_of_records() << std::endl;
-        // record copy
+        // take back the room of the records moved, the records left may
+        // share a longer key prefix too.
+        auto prefix = common_key_prefix(0, number_of_records() - 1);
+        if (prefix.size() < frame_->key_prefix().size())
+            prefix = frame_->key_prefix();
+        repack(frame_, std::move(prefix));
         return ErrorCode::Success;
     }
 
     ErrorCode node_move(N &node, BufferPoolManager *pool) {
-        auto frame = node.frame_;
-
-        auto cursor = first_user_cursor();
-        int i = 0;
-        while (i < number_of_records()) {
-            auto &record = cursor.record;
-
-            auto inserted = node.push_back(record.key, record.value);
-
-            if (!frame_->is_leaf()) {
-                update_record_parent(node, inserted.record, inserted.offset,
-                                     pool);
-            }
-            cursor = next_cursor(cursor);
-            i++;
-        }
-
-        return ErrorCode::Success;
+        return node_move(node, number_of_records(), pool);
     }
     ErrorCode node_move(N &node, size_t number, BufferPoolManager *pool) {
-        auto frame = node.frame_;
-
-        auto cursor = first_user_cursor();
-        int i = 0;
-        while (i < number_of_records() && i < number) {
-            auto &record = cursor.record;
-
-            auto inserted = node.push_back(record.key, record.value);
+        int last = std::min<int>(number, number_of_records()) - 1;
+        if (node.is_empty() && last >= 0)
+            repack(node.frame_, common_key_prefix(0, last));
+        for (int i = 0; i < number_of_records() && i < number; i++) {
+            auto inserted = node.push_back(cursor_at_slot(i).record);
 
             if (!frame_->is_leaf()) {
-                update_record_parent(node, inserted.record, inserted.offset,
-                                     pool);
+                update_record_parent(node, inserted, pool);
             }
-            cursor = next_cursor(cursor);
-            i++;
         }
 
         return ErrorCode::Success;
     }
 
     NodeCursor remove_record(NodeCursor &cursor) {
-        NodeCursor left_cursor = prev_cursor(cursor);
-        NodeCursor right_cursor = next_cursor(cursor);
-
-        // Log::GlobalLog() << "the end offset of the to-be-deleted record: "
-        // << cursor.offset << std::endl;
-        auto &left_record = left_cursor.record;
-        auto &right_record = right_cursor.record;
-        left_record.hdr.next_record_offset = offset(left_cursor, right_cursor);
-        right_record.hdr.prev_record_offset = offset(right_cursor, left_cursor);
-        cursor.record.hdr.status = uint8_t(config::RecordStatus::Deleted);
-
-        // FIXME: cereal serialization determination.
-        dump(cursor);
-        dump(left_cursor);
-        dump(right_cursor);
+        unlink(cursor);
 
         // pop front, update the parent record.
-        if (left_record.hdr.order == 0) {
-            auto parent_frame = frame_->parent_frame();
-            if (parent_frame && parent_frame.value()) {
-                auto parent_cursor = frame_->parent_record();
-                parent_cursor.value().record.key = get_key();
-                parent_frame.value()->dump_at(
-                    parent_cursor.value().offset -
-                        parent_cursor.value().record.len(),
-                    parent_cursor.value().record);
-            }
-        }
-
-        frame_->page()->hdr.number_of_records--;
+        // NOTE: the old key still bounds the node if a parent has no room for
+        // the new one.
+        if (cursor.slot == 0 && !is_empty())
+            update_parent_key(frame_, get_key());
         return cursor;
     }
 
     void node_union(N &node, BufferPoolManager *pool) {
-        auto cursor = node.first_user_cursor();
-
-        int i = 0;
-        while (i < node.frame_->number_of_records()) {
-            auto &record = cursor.record;
-            // FIXME: update the child
-            auto inserted = push_back(record.key, record.value);
-            // overload in InternalIndexNode
-            // if (!node.frame_->is_leaf()) {
-            // update_record_parent(*this, cursor.record, cursor.offset, pool);
-            // }
-            cursor = node.next_cursor(cursor);
-            i++;
-        }
+        fit_key_prefix(node);
+        for (int i = 0; i < node.number_of_records(); i++)
+            push_back(node.cursor_at_slot(i).record);
     }
 
     // record reverse traverse in a node.
     void traverse_r(const TraverseFunc &func) {
-
-        auto cursor = last_user_cursor();
-
-        int i = 0;
-        while (i < frame_->number_of_records()) {
-            func(cursor.record);
-            cursor = prev_cursor(cursor);
-            i++;
+        for (int i = number_of_records() - 1; i >= 0; i--) {
+            auto cursor = cursor_at_slot(i);
+            auto record =
+                cursor.record.template materialize<LeafClusteredRecord>();
+            func(record);
         }
     }
 
 #ifdef DEBUG
     void print() noexcept {
         Log::GlobalLog() << std::format("printing page {}: ", frame_->pgno());
-        if (number_of_records() == 0)
-            return;
-        auto cursor = first_user_cursor();
-        int i = 0;
-        while (i < number_of_records()) {
-            Log::GlobalLog()
-                << cursor.record.key << ": " << cursor.record.value << ", ";
-            // Log::GlobalLog() << cursor.record.key << ", ";
-
-            cursor = next_cursor(cursor);
-            i++;
+        for (int i = 0; i < number_of_records(); i++) {
+            auto record = cursor_at_slot(i).record.template materialize<R>();
+            Log::GlobalLog() << record.key << ": " << record.value << ", ";
         }
         Log::GlobalLog() << std::endl;
     }
 #endif // DEBUG
 
 protected:
-    // // retur Infimum record.
-    // void first_record(R &record) { frame_->load_at(0, record); }
-    // // return Supreme record.
-    // void last_record(R &record) {
-    //     frame_->load_at(0, record);
-    //     frame_->load(record);
-    // }
-    // // NOTE: it is the caller's responsibility to ensure the node is not
-    // // empty(no any user records).
-    // R first_user_record() {
-    //     R record;
-    //     first_record(record);
-    //     next_record(record);
-    //     return record;
-    // }
-    //
-    // // make @record point to its prev record.
-    // void prev_record(R &record) {
-    //     int offset = record.hdr.prev_record_offset;
-    //     frame_->load(offset, record);
-    // }
-    //
-    // R make_prev_record(R &record, page_off_t record_end) {
-    //     R result;
-    //     int offset = record.hdr.prev_record_offset;
-    //     frame_->load_at(record_end + offset, result);
-    //     return result;
-    // }
-    //
-    // // make @record point to its next record.
-    // void next_record(R &record) {
-    //     int offset = record.hdr.next_record_offset;
-    //     frame_->load(offset, record);
-    // }
-    //
-    // R make_next_record(R &record, page_off_t record_end) {
-    //     R result;
-    //     int offset = record.hdr.next_record_offset;
-    //     frame_->load_at(record_end + offset, result);
-    //     return result;
-    // }
-
-    NodeCursor first_cursor() {
-        R first;
-        // FIXME: change next_record_offset to diff[record.start,
-        // next_record.start]
-        frame_->load_at(0, first);
-
-        return {frame_->gpos(), first};
-    }
-
-    // return supremum if the node is empty.
-    NodeCursor first_user_cursor() {
-        auto infi = first_cursor();
-        return next_cursor(infi);
-    }
-
-    // return infimum if the node is empty.
-    NodeCursor last_user_cursor() {
-        auto supre = last_cursor();
-        return prev_cursor(supre);
+    // the record of the slot @slot, or the end of the node.
+    NodeCursor cursor_at_slot(int slot) {
+        if (slot >= number_of_records())
+            return {number_of_records(), 0, {}};
+        page_off_t offset = frame_->slot(slot);
+        return {slot, offset, frame_->record_at(offset)};
     }
 
-    NodeCursor last_cursor() {
-        R last;
-        // FIXME: change next_record_offset to diff[record.start,
-        // next_record.start]
-        frame_->load_at(0, last);
-        frame_->load(last);
+    // the record at @offset of the page, or the end of the node if there is
+    // none.
+    NodeCursor cursor_at(page_off_t offset) {
+        return cursor_at_slot(slot_of(frame_, offset));
+    }
+
+    // return the end if the node is empty.
+    NodeCursor first_user_cursor() { return cursor_at_slot(0); }
 
-        return {frame_->gpos(), last};
+    NodeCursor last_user_cursor() {
+        return cursor_at_slot(number_of_records() - 1);
     }
 
-    NodeCursor next_cursor(NodeCursor &cur) {
-        R next;
-        // FIXME: change next_record_offset to diff[record.start,
-        // next_record.start]
-        frame_->load_at(cur.offset + cur.record.hdr.next_record_offset, next);
+    NodeCursor end_cursor() { return cursor_at_slot(number_of_records()); }
 
-        return {frame_->gpos(), next};
+    NodeCursor next_cursor(const NodeCursor &cur) {
+        return cursor_at_slot(cur.slot + 1);
     }
 
-    NodeCursor prev_cursor(NodeCursor &cur) {
-        R prev;
-        // FIXME: change next_record_offset to diff[record.start,
-        // next_record.start]
-        frame_->load_at(cur.offset + cur.record.hdr.prev_record_offset, prev);
+    NodeCursor prev_cursor(const NodeCursor &cur) {
+        return cursor_at_slot(cur.slot - 1);
+    }
 
-        return {frame_->gpos(), prev};
+    // drop the slot of @cursor and mark its record deleted.
+    void unlink(NodeCursor &cursor) {
+        frame_->erase_slot(cursor.slot);
+        frame_->delete_record(cursor.offset);
     }
 
-    // prev/next_record_offset from @l to @r
-    int offset(NodeCursor &l, NodeCursor &r) {
-        return r.offset - r.record.hdr.length - l.offset;
+    // the slot of the record at @offset of @frame, or the number of records
+    // if there is none.
+    static int slot_of(Frame *frame, page_off_t offset) {
+        int n = frame->number_of_records();
+        for (int i = 0; i < n; i++) {
+            if (frame->slot(i) == offset)
+                return i;
+        }
+        return n;
+    }
+
+    // make room for a new record of @len bytes and its slot in @frame,
+    // repacking it to take back the room of the deleted records only once
+    // the free space runs out, so that a page under churn is compacted in
+    // place once per deleted_bytes() of its records.
+    // NOTE: the records move on a repack.
+    // NOTE: the caller makes sure the page has room for the record, see
+    // Frame::has_room().
+    static void make_room(Frame *frame, page_off_t len) {
+        if (frame->free_space() < len + Frame::SLOT_LEN)
+            repack(frame, std::string(frame->key_prefix()));
+        assert(frame->free_space() >= len + Frame::SLOT_LEN);
+    }
+
+    // take @len bytes for a new record in @frame, with the room of its slot.
+    // NOTE: see make_room().
+    static page_off_t allocate_record(Frame *frame, page_off_t len) {
+        make_room(frame, len);
+        page_off_t offset = frame->last_inserted();
+        frame->set_last_inserted(offset + len);
+        return offset;
+    }
+
+    // the common key prefix of the records of the slots @first and @last,
+    // which the keys of the records between share too.
+    std::string common_key_prefix(int first, int last) {
+        auto bytes = cursor_at_slot(last).record.key().bytes();
+        auto first_key = cursor_at_slot(first).record.key();
+        bytes.resize(first_key.common_prefix_len(bytes));
+        return bytes;
+    }
+
+    // shrink the key prefix of the page to one of the keys of @node too,
+    // before its records are moved in.
+    void fit_key_prefix(N &node) {
+        if (node.is_empty())
+            return;
+        fit_key_prefix(frame_, node.first_user_cursor().record.key());
+        fit_key_prefix(frame_, node.last_user_cursor().record.key());
+    }
+
+    // shrink the key prefix of @frame to a prefix of @key, if it's not one
+    // already.
+    // @return the length of the key prefix.
+    template <typename K>
+    static size_t fit_key_prefix(Frame *frame, const K &key) {
+        auto prefix = frame->key_prefix();
+        size_t len;
+        if constexpr (std::is_same_v<K, KeyView>)
+            len = key.common_prefix_len(prefix);
+        else
+            len = std::mismatch(prefix.begin(), prefix.end(),
+                                key.bytes().begin(), key.bytes().end())
+                      .first -
+                  prefix.begin();
+        if (len < prefix.size())
+            repack(frame, std::string(prefix.substr(0, len)));
+        return len;
+    }
+
+    // rewrite the records of @frame in slot order after the key prefix
+    // @prefix, which all their keys start with, and drop the deleted ones.
+    // NOTE: the records move, which the children of an internal page don't
+    // notice: they find their parent records by page number, see
+    // Frame::child_record_off().
+    // NOTE: the caller makes sure the records still fit in the page, see
+    // Frame::live_bytes().
+    static void repack(Frame *frame, std::string prefix) {
+        int n = frame->number_of_records();
+        assert(frame->live_bytes(prefix.size()) <= Page::payload_len());
+
+        char *payload = frame->page()->payload;
+        std::array<char, Page::payload_len()> old;
+        std::memcpy(old.data(), payload, old.size());
+        std::string_view old_prefix(old.data(), frame->key_prefix().size());
+
+        std::memcpy(payload, prefix.data(), prefix.size());
+        frame->page()->hdr.key_prefix_len = prefix.size();
+        page_off_t end = prefix.size();
+        for (int i = 0; i < n; i++) {
+            page_off_t offset = frame->slot(i);
+            RecordView record(old.data() + offset, old.size() - offset,
+                              old_prefix);
+            RecordView::copy(payload + end, record, prefix.size());
+            frame->set_slot(i, end);
+            end += RecordView::copy_len(record, prefix.size());
+        }
+        frame->set_last_inserted(end);
+        frame->set_deleted_bytes(0);
+    }
+
+    // set the key of the internal record at @offset of @frame to @key.
+    // @return the offset of the record, which moves if the new key doesn't
+    // take the room of the old one, or the key prefix of the page shrinks;
+    // NodeFull, with the page untouched, if the page has no room for it.
+    static tl::expected<page_off_t, ErrorCode>
+    set_record_key(Frame *frame, page_off_t offset, const Key &key) {
+        if (!has_room_for_key(frame, offset, key))
+            return tl::unexpected(ErrorCode::NodeFull);
+
+        NormalizedKey normalized(key);
+        int slot = slot_of(frame, offset);
+        auto suffix =
+            normalized.bytes().substr(fit_key_prefix(frame, normalized));
+        auto record = frame->record_at(frame->slot(slot));
+        frame->mark_dirty();
+        auto old_key = record.key();
+        if (old_key.same_type(normalized) &&
+            old_key.suffix().size() == suffix.size()) {
+            record.set_key(suffix);
+            return frame->slot(slot);
+        }
+
+        page_id_t child = record.child();
+        page_off_t len = RecordView::encoded_len(suffix.size(), child);
+        make_room(frame, len);
+        page_off_t old_offset = frame->slot(slot);
+        page_off_t moved = allocate_record(frame, len);
+        RecordView::write(frame->page()->payload + moved, normalized.type(),
+                          suffix, child);
+        frame->set_slot(slot, moved);
+        frame->delete_record(old_offset);
+        return moved;
+    }
+
+    // whether the key of the internal record at @offset of @frame may be set
+    // to @key, see set_record_key().
+    // NOTE: a key of the same length within the key prefix takes the room of
+    // the old one, any other one is counted as a record of its own.
+    static bool has_room_for_key(Frame *frame, page_off_t offset,
+                                 const Key &key) {
+        NormalizedKey normalized(key);
+        auto prefix_len = frame->key_prefix().size();
+        auto old_key = frame->record_at(offset).key();
+        if (frame->shared_prefix_len(normalized.bytes()) == prefix_len &&
+            old_key.same_type(normalized) &&
+            old_key.size() == normalized.bytes().size())
+            return true;
+        return frame->has_room(
+            normalized.bytes(),
+            RecordView::encoded_len(key, page_id_t(0)) + Frame::SLOT_LEN);
+    }
+
+    // set the key of the record referencing @frame in its parent to @key,
+    // and recursively up the tree as long as the record is the first one of
+    // its page.
+    // @return NodeFull, with no key set, if a parent has no room for @key.
+    static ErrorCode update_parent_key(Frame *frame, const Key &key) {
+        if (!has_room_for_parent_key(frame, key))
+            return ErrorCode::NodeFull;
+
+        while (true) {
+            auto parent = frame->parent_frame();
+            if (!parent || !parent.value())
+                break;
+
+            Frame *parent_frame = parent.value();
+            auto old_offset = parent_frame->child_record_off(frame->pgno());
+            if (!old_offset)
+                return old_offset.error();
+            page_off_t offset =
+                set_record_key(parent_frame, old_offset.value(), key).value();
+
+            // if the parent record isn't the parent frame's first record,
+            // break the loop.
+            if (parent_frame->slot(0) != offset)
+                break;
+            frame = parent_frame;
+        }
+        return ErrorCode::Success;
     }
 
-    void dump(NodeCursor &cursor) {
-        frame_->dump_at(cursor.offset - cursor.record.hdr.length,
-                        cursor.record);
+    // whether update_parent_key() may set the key of @frame to @key.
+    static bool has_room_for_parent_key(Frame *frame, const Key &key) {
+        while (true) {
+            auto parent = frame->parent_frame();
+            if (!parent || !parent.value())
+                return true;
+
+            Frame *parent_frame = parent.value();
+            auto result = parent_frame->child_record_off(frame->pgno());
+            if (!result)
+                return false;
+            page_off_t offset = result.value();
+            if (!has_room_for_key(parent_frame, offset, key))
+                return false;
+            if (parent_frame->slot(0) != offset)
+                return true;
+            frame = parent_frame;
+        }
     }
-    virtual ErrorCode update_record_parent(N &node, R &record,
-                                           page_off_t offset,
+
+    virtual ErrorCode update_record_parent(N &node, const NodeCursor &cursor,
                                            BufferPoolManager *pool) = 0;
 
 protected:
@@ -674,10 +625,6 @@ protected:
     // *placeholder* now, reserved to add comparison support for secondary
     // record.
     Comparator &comp_;
-
-    // TODO: page directory
-
-    // IndexNode *parent_node_;
 };
 
 class LeafIndexNode : public IndexNode<LeafIndexNode, LeafClusteredRecord> {
@@ -685,22 +632,142 @@ public:
     LeafIndexNode(Frame *frame, Comparator &comp) : IndexNode(frame, comp) {}
     virtual ~LeafIndexNode() = default;
 
-    virtual page_off_t get_child(NodeCursor &cursor) override { return 0; }
+    virtual page_id_t get_child(NodeCursor &cursor) override { return 0; }
 
     ErrorCode update_record_parent(LeafIndexNode &new_parent,
-                                   LeafClusteredRecord &record,
-                                   page_off_t offset,
+                                   const NodeCursor &cursor,
                                    BufferPoolManager *pool) override {
         return ErrorCode::Success;
     }
 
+    // search_record() of the keys [@begin, @end) of @key_at, in ascending
+    // order, into @result_at. as many keys as a binary search of each would
+    // compare records are merged with the records in one pass instead.
+    template <typename KeyAt, typename ResultAt>
+    void search_records(size_t begin, size_t end, const KeyAt &key_at,
+                        const ResultAt &result_at) {
+        int n = number_of_records();
+        if ((end - begin) * std::bit_width(unsigned(n)) < size_t(n)) {
+            for (size_t k = begin; k < end; k++)
+                result_at(k) = search_record(key_at(k));
+            return;
+        }
+
+        int slot = 0;
+        for (size_t k = begin; k < end; k++) {
+            auto &key = key_at(k);
+            if (n > 0 &&
+                !frame_->record_at(frame_->slot(0)).key().same_type(key)) {
+                result_at(k) = tl::unexpected(ErrorCode::InvalidKeyType);
+                continue;
+            }
+            int cmp = 1;
+            for (; slot < n; slot++) {
+                cmp = frame_->record_at(frame_->slot(slot)).key().compare(key);
+                if (cmp >= 0)
+                    break;
+            }
+            if (slot < n && cmp == 0)
+                result_at(k) = frame_->record_at(frame_->slot(slot))
+                                   .materialize<LeafClusteredRecord>();
+            else
+                result_at(k) = tl::unexpected(ErrorCode::KeyNotFound);
+        }
+    }
+
+    // collect the records whose keys start with the normalized @prefix, from
+    // @from on, or from the first one past @from if @after.
+    // @return whether the records may go on in the next leaf.
+    tl::expected<bool, ErrorCode>
+    scan_prefix(const Key &from, bool after, std::string_view prefix,
+                std::vector<LeafClusteredRecord> &records) {
+        bool found;
+        auto cursor = seek(from, found);
+        if (!cursor)
+            return tl::unexpected(cursor.error());
+
+        int slot = cursor.value().slot + (found && after);
+        for (; slot < number_of_records(); slot++) {
+            auto record = frame_->record_at(frame_->slot(slot));
+            if (!record.key().has_prefix(prefix))
+                return false;
+            records.push_back(record.materialize<LeafClusteredRecord>());
+        }
+        return true;
+    }
+
+    // collect the records from @from on, or from the first one past @from
+    // if @after, or from the first record if @from is null, till @records
+    // has @max records. the records past @upper, or @upper itself unless
+    // @upper_inclusive, are left out.
+    // @return whether the records may go on in the next leaf.
+    tl::expected<bool, ErrorCode>
+    scan_range(const Key *from, bool after, const NormalizedKey *upper,
+               bool upper_inclusive, size_t max,
+               std::vector<LeafClusteredRecord> &records) {
+        int slot = 0;
+        if (from) {
+            bool found;
+            auto cursor = seek(*from, found);
+            if (!cursor)
+                return tl::unexpected(cursor.error());
+            slot = cursor.value().slot + (found && after);
+        }
+
+        for (; slot < number_of_records(); slot++) {
+            if (records.size() >= max)
+                return true;
+            auto record = frame_->record_at(frame_->slot(slot));
+            if (upper) {
+                int cmp = record.key().compare(*upper);
+                if (cmp > 0 || (cmp == 0 && !upper_inclusive))
+                    return false;
+            }
+            records.push_back(record.materialize<LeafClusteredRecord>());
+        }
+        return true;
+    }
+
+    // scan_range() in descending key order: the records from @from down, or
+    // from the last one before @from if @before, or from the last record if
+    // @from is null, till the one before @lower, or @lower itself unless
+    // @lower_inclusive.
+    // @return whether the records may go on in the previous leaf.
+    tl::expected<bool, ErrorCode>
+    scan_range_r(const Key *from, bool before, const NormalizedKey *lower,
+                 bool lower_inclusive, size_t max,
+                 std::vector<LeafClusteredRecord> &records) {
+        int slot = number_of_records() - 1;
+        if (from) {
+            bool found;
+            auto cursor = seek(*from, found);
+            if (!cursor)
+                return tl::unexpected(cursor.error());
+            slot = cursor.value().slot - !(found && !before);
+        }
+
+        for (; slot >= 0; slot--) {
+            if (records.size() >= max)
+                return true;
+            auto record = frame_->record_at(frame_->slot(slot));
+            if (lower) {
+                int cmp = record.key().compare(*lower);
+                if (cmp < 0 || (cmp == 0 && !lower_inclusive))
+                    return false;
+            }
+            records.push_back(record.materialize<LeafClusteredRecord>());
+        }
+        return true;
+    }
+
     void traverse(const TraverseFunc &func) {
 
         auto cursor = first_user_cursor();
 
         int i = 0;
         while (i < frame_->number_of_records()) {
-            func(cursor.record);
+            auto record = cursor.record.materialize<LeafClusteredRecord>();
+            func(record);
             cursor = next_cursor(cursor);
             i++;
         }
@@ -714,17 +781,67 @@ public:
         : IndexNode(frame, comp) {}
     virtual ~InternalIndexNode() = default;
 
-    virtual page_off_t get_child(NodeCursor &cursor) override {
-        return cursor.record.value;
+    virtual page_id_t get_child(NodeCursor &cursor) override {
+        return cursor.record.child();
+    }
+
+    // the child to descend into for @key.
+    tl::expected<page_id_t, ErrorCode> get_child(const Key &key) {
+        return get_child(NormalizedKey(key));
+    }
+    tl::expected<page_id_t, ErrorCode> get_child(const NormalizedKey &key) {
+        return search_cursor(key).map(
+            [](const NodeCursor &cursor) { return cursor.record.child(); });
+    }
+
+    // get_child() of @key, and the normalized key of the record after the
+    // one of the child into @fence, if any: the keys of the child are less
+    // than it.
+    tl::expected<page_id_t, ErrorCode>
+    get_child(const Key &key, std::optional<std::string> &fence) {
+        auto cursor = search_cursor(key);
+        if (!cursor)
+            return tl::unexpected(cursor.error());
+        int next = cursor.value().slot + 1;
+        if (next < number_of_records())
+            fence = frame_->record_at(frame_->slot(next)).key().bytes();
+        return cursor.value().record.child();
+    }
+
+    // the children to descend into for the keys [@begin, @end) of @key_at,
+    // in ascending order: the child of every run of keys going into the same
+    // child, and the end of the run. only the first key of a run is sought,
+    // the keys after it are compared with the key of the next record.
+    template <typename KeyAt>
+    tl::expected<std::vector<std::pair<page_id_t, size_t>>, ErrorCode>
+    get_children(size_t begin, size_t end, const KeyAt &key_at) {
+        std::vector<std::pair<page_id_t, size_t>> children;
+        size_t k = begin;
+        while (k < end) {
+            auto cursor = search_cursor(key_at(k));
+            if (!cursor)
+                return tl::unexpected(cursor.error());
+            auto next = next_cursor(cursor.value());
+            for (k++; k < end; k++) {
+                if (next.slot < number_of_records() &&
+                    next.record.key().compare(key_at(k)) <= 0)
+                    break;
+            }
+            children.emplace_back(cursor.value().record.child(), k);
+        }
+        return children;
     }
 
     void node_union(InternalIndexNode &node, BufferPoolManager *pool) {
+        fit_key_prefix(node);
         auto cursor = node.first_user_cursor();
 
         // update the child page link
         auto last_child = last_user_cursor();
-        auto first_child_frame = pool->get_frame(cursor.record.value);
-        auto last_child_frame = pool->get_frame(last_child.record.value);
+        auto first_child_frame =
+            pool->get_frame(frame_->file(), cursor.record.child());
+        auto last_child_frame =
+            pool->get_frame(frame_->file(), last_child.record.child());
         assert(first_child_frame.has_value());
         assert(last_child_frame.has_value());
         // FIXME: wrapped as a Frame member function.
@@ -735,10 +852,8 @@ public:
 
         int i = 0;
         while (i < node.frame_->number_of_records()) {
-            auto &record = cursor.record;
-
-            auto inserted = push_back(record.key, record.value);
-            update_record_child(*this, inserted.record, inserted.offset, pool);
+            auto inserted = push_back(cursor.record);
+            update_record_child(*this, inserted, pool);
 
             cursor = node.next_cursor(cursor);
             i++;
@@ -746,46 +861,28 @@ public:
     }
 
     ErrorCode update_record_child(InternalIndexNode &new_parent,
-                                  InternalClusteredRecord &record,
-                                  page_off_t offset, BufferPoolManager *pool) {
-        auto child = pool->get_frame(record.value);
+                                  const NodeCursor &cursor,
+                                  BufferPoolManager *pool) {
+        auto child = pool->get_frame(frame_->file(), cursor.record.child());
         if (!child)
             return child.error();
 
-        auto child_frame = child.value();
-        child_frame->set_parent(new_parent.frame_->pgno(),
-                                offset - record.len());
-
+        child.value()->set_parent(new_parent.frame_->pgno());
         return ErrorCode::Success;
     }
 
     ErrorCode update_record_parent(InternalIndexNode &new_parent,
-                                   InternalClusteredRecord &record,
-                                   page_off_t offset,
+                                   const NodeCursor &cursor,
                                    BufferPoolManager *pool) override {
-        auto result = pool->get_frame(record.value);
-        if (!result)
-            return result.error();
-
-        result.value()->set_parent(new_parent.frame_->pgno(),
-                                   offset - record.len());
-
-        return ErrorCode::Success;
+        return update_record_child(new_parent, cursor, pool);
     }
 
     void traverse(const TraverseFunc &func, BufferPoolManager *pool) {
-        // Log::GlobalLog() << "---------------------------------------------"
-        //                  << std::endl;
-        // Log::GlobalLog() << "at level " << int(frame_->level()) << std::endl;
-        // print();
-        // Log::GlobalLog() << "---------------------------------------------"
-        // << std::endl;
-
         auto cursor = first_user_cursor();
 
         int i = 0;
         while (i < number_of_records()) {
-            auto child = pool->get_frame(cursor.record.value);
+            auto child = pool->get_frame(frame_->file(), cursor.record.child());
             if (!child)
                 return;
 
@@ -0,0 +1,285 @@
+#ifndef STORAGE_INCLUDE_INDEX_NORMALIZED_KEY_H
+#define STORAGE_INCLUDE_INDEX_NORMALIZED_KEY_H
+
+#include "types.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <variant>
+
+namespace storage {
+
+// NormalizedKey is the order-preserving binary form of a key: two keys of the
+// same type compare as their normalized forms do by memcmp, so that index
+// pages store keys normalized and search them without decoding.
+// - an int is its 4 bytes in big-endian with the sign bit flipped.
+// - a double is its 8 IEEE bytes in big-endian, with the sign bit flipped if
+//   it's positive and every bit flipped if it's negative.
+// - a string is its characters with every 0x00 escaped as 0x00 0xff, and
+//   terminated by 0x00 0x00, so that no normalized string is a prefix of
+//   another one.
+// - a composite key is its columns one after another, every column as a tag
+//   of its type and order in 1 byte followed by the column normalized, with
+//   every bit flipped if it's descending. the tags are the same for all the
+//   keys of an index and never decide a comparison, but keep a key decodable
+//   on its own. since no normalized column is a prefix of another one, a key
+//   of the first columns of another key normalizes to a prefix of it.
+class NormalizedKey {
+public:
+    explicit NormalizedKey(const Key &key)
+        : type_(static_cast<KeyType>(key.index())),
+          bytes_(encoded_len(key), '\0') {
+        encode(bytes_.data(), key);
+    }
+
+    KeyType type() const { return type_; }
+    std::string_view bytes() const { return bytes_; }
+
+    static size_t encoded_len(const Key &key) {
+        return std::visit([](auto &value) { return value_len(value); }, key);
+    }
+
+    // write the normalized @key at @dst.
+    // @return the end of the write.
+    static char *encode(char *dst, const Key &key) {
+        return std::visit(
+            [dst](auto &value) { return encode_value(dst, value); }, key);
+    }
+
+    // the key of @type normalized as @bytes.
+    // NOTE: throws std::out_of_range for malformed bytes, which only happens
+    // to a torn read.
+    static Key decode(KeyType type, std::string_view bytes) {
+        if (type == KeyType::Composite)
+            return decode_composite(bytes);
+        return std::visit([](auto &&value) -> Key { return std::move(value); },
+                          decode_column(type, bytes));
+    }
+
+    // memcmp the normalized keys @lhs and @rhs: < 0, 0 or > 0 as @lhs is
+    // less than, equal to or greater than @rhs.
+    static int compare(std::string_view lhs, std::string_view rhs) {
+        int cmp = std::memcmp(lhs.data(), rhs.data(),
+                              std::min(lhs.size(), rhs.size()));
+        if (cmp != 0)
+            return cmp;
+        return lhs.size() < rhs.size() ? -1 : (lhs.size() > rhs.size());
+    }
+
+    // the shortest key greater than @left and not greater than @right, of
+    // @left < @right: the shortest prefix of a string that tells it from
+    // @left, the first columns of a composite key that do, with the last
+    // of them shortened likewise if it's an ascending string.
+    static Key separator(const Key &left, const Key &right) {
+        if (auto *str = std::get_if<std::string>(&right))
+            return separator(std::get<std::string>(left), *str);
+        auto *key = std::get_if<CompositeKey>(&right);
+        if (!key)
+            return right;
+
+        auto &left_columns = std::get<CompositeKey>(left).columns;
+        CompositeKey sep;
+        for (size_t i = 0; i < key->columns.size(); i++) {
+            sep.columns.push_back(key->columns[i]);
+            sep.orders.push_back(key->orders[i]);
+            if (i < left_columns.size() && left_columns[i] == key->columns[i])
+                continue;
+            auto *str = std::get_if<std::string>(&key->columns[i]);
+            auto *left_str = i < left_columns.size()
+                                 ? std::get_if<std::string>(&left_columns[i])
+                                 : nullptr;
+            if (str && left_str && key->orders[i] == KeyOrder::Asc)
+                sep.columns[i] = separator(*left_str, *str);
+            break;
+        }
+        return sep;
+    }
+
+private:
+    static constexpr uint32_t SIGN_BIT_32 = uint32_t(1) << 31;
+    static constexpr uint64_t SIGN_BIT_64 = uint64_t(1) << 63;
+    static constexpr char ESCAPE = '\xff';
+    static constexpr size_t TERMINATOR_LEN = 2;
+    // the bit of the tag of a descending column.
+    static constexpr uint8_t DESC_TAG = 0x80;
+
+    static size_t value_len(int) { return sizeof(uint32_t); }
+    static size_t value_len(double) { return sizeof(uint64_t); }
+    static size_t value_len(const std::string &str) {
+        size_t len = str.size() + TERMINATOR_LEN;
+        for (char c : str)
+            len += c == '\0';
+        return len;
+    }
+    static size_t value_len(const CompositeKey &key) {
+        size_t len = key.columns.size() * sizeof(uint8_t);
+        for (auto &column : key.columns)
+            len += std::visit([](auto &value) { return value_len(value); },
+                              column);
+        return len;
+    }
+
+    static char *encode_value(char *dst, int value) {
+        return put(dst, std::bit_cast<uint32_t>(value) ^ SIGN_BIT_32);
+    }
+    static char *encode_value(char *dst, double value) {
+        // NOTE: -0.0 == 0.0, encode both as 0.0.
+        uint64_t bits = std::bit_cast<uint64_t>(value == 0 ? 0.0 : value);
+        return put(dst, bits & SIGN_BIT_64 ? ~bits : bits ^ SIGN_BIT_64);
+    }
+    static char *encode_value(char *dst, const std::string &str) {
+        for (char c : str) {
+            *dst++ = c;
+            if (c == '\0')
+                *dst++ = ESCAPE;
+        }
+        *dst++ = '\0';
+        *dst++ = '\0';
+        return dst;
+    }
+    static char *encode_value(char *dst, const CompositeKey &key) {
+        for (size_t i = 0; i < key.columns.size(); i++) {
+            bool desc =
+                i < key.orders.size() && key.orders[i] == KeyOrder::Desc;
+            *dst++ = static_cast<char>(key.columns[i].index() |
+                                       (desc ? DESC_TAG : 0));
+            char *start = dst;
+            dst = std::visit(
+                [dst](auto &value) { return encode_value(dst, value); },
+                key.columns[i]);
+            if (desc)
+                flip(start, dst);
+        }
+        return dst;
+    }
+
+    static KeyColumn decode_column(KeyType type, std::string_view bytes) {
+        switch (type) {
+        case KeyType::Int:
+            check(bytes.size() == sizeof(uint32_t));
+            return std::bit_cast<int>(get<uint32_t>(bytes.data()) ^
+                                      SIGN_BIT_32);
+        case KeyType::Double: {
+            check(bytes.size() == sizeof(uint64_t));
+            uint64_t bits = get<uint64_t>(bytes.data());
+            bits = bits & SIGN_BIT_64 ? bits ^ SIGN_BIT_64 : ~bits;
+            return std::bit_cast<double>(bits);
+        }
+        case KeyType::String: {
+            check(bytes.size() >= TERMINATOR_LEN);
+            std::string str;
+            str.reserve(bytes.size() - TERMINATOR_LEN);
+            for (size_t i = 0; i + TERMINATOR_LEN < bytes.size(); i++) {
+                str.push_back(bytes[i]);
+                if (bytes[i] == '\0')
+                    i++;
+            }
+            return str;
+        }
+        default:
+            check(false);
+            return {};
+        }
+    }
+
+    static CompositeKey decode_composite(std::string_view bytes) {
+        CompositeKey key;
+        size_t pos = 0;
+        while (pos < bytes.size()) {
+            uint8_t tag = bytes[pos++];
+            bool desc = tag & DESC_TAG;
+            auto type = static_cast<KeyType>(tag & ~DESC_TAG);
+            std::string column(
+                bytes.substr(pos, column_len(type, bytes.substr(pos), desc)));
+            if (desc)
+                flip(column.data(), column.data() + column.size());
+            key.columns.push_back(decode_column(type, column));
+            key.orders.push_back(desc ? KeyOrder::Desc : KeyOrder::Asc);
+            pos += column.size();
+        }
+        return key;
+    }
+
+    // the length of the normalized column of @type at the start of @bytes.
+    static size_t column_len(KeyType type, std::string_view bytes, bool desc) {
+        switch (type) {
+        case KeyType::Int:
+            check(sizeof(uint32_t) <= bytes.size());
+            return sizeof(uint32_t);
+        case KeyType::Double:
+            check(sizeof(uint64_t) <= bytes.size());
+            return sizeof(uint64_t);
+        case KeyType::String: {
+            char mask = desc ? '\xff' : '\0';
+            // a 0x00 followed by 0x00 terminates the string, one followed by
+            // 0xff is an escaped 0x00.
+            for (size_t i = 0; i + 1 < bytes.size(); i++) {
+                if ((bytes[i] ^ mask) != 0)
+                    continue;
+                if ((bytes[++i] ^ mask) == 0)
+                    return i + 1;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        check(false);
+        return 0;
+    }
+
+    static std::string separator(const std::string &left,
+                                 const std::string &right) {
+        size_t len = std::mismatch(left.begin(), left.end(), right.begin(),
+                                   right.end())
+                         .first -
+                     left.begin();
+        return right.substr(0, len + 1);
+    }
+
+    static void flip(char *start, char *end) {
+        for (; start != end; start++)
+            *start = ~*start;
+    }
+
+    template <typename T>
+    static char *put(char *dst, T value) {
+        if constexpr (std::endian::native == std::endian::little) {
+            if constexpr (sizeof(T) == 4)
+                value = __builtin_bswap32(value);
+            else
+                value = __builtin_bswap64(value);
+        }
+        std::memcpy(dst, &value, sizeof(T));
+        return dst + sizeof(T);
+    }
+
+    template <typename T>
+    static T get(const char *src) {
+        T value;
+        std::memcpy(&value, src, sizeof(T));
+        if constexpr (std::endian::native == std::endian::little) {
+            if constexpr (sizeof(T) == 4)
+                value = __builtin_bswap32(value);
+            else
+                value = __builtin_bswap64(value);
+        }
+        return value;
+    }
+
+    static void check(bool well_formed) {
+        if (!well_formed)
+            throw std::out_of_range("malformed normalized key");
+    }
+
+    KeyType type_;
+    std::string bytes_;
+};
+
+} // namespace storage
+
+#endif // !STORAGE_INCLUDE_INDEX_NORMALIZED_KEY_H
@@ -0,0 +1,437 @@
+#ifndef STORAGE_INCLUDE_INDEX_RECORD_VIEW_H
+#define STORAGE_INCLUDE_INDEX_RECORD_VIEW_H
+
+#include "config.h"
+#include "index/normalized_key.h"
+#include "index/record.h"
+#include "types.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace storage {
+
+// the on-page format of index records. records are read and written in place
+// through views; LeafClusteredRecord and InternalClusteredRecord are only
+// materialized on request.
+//
+// a record is a fixed header followed by the key and the value:
+//   | length:2 | status:1 | key type:1 | key length:2 | key | value |
+// the key is normalized and stripped of the key prefix of its page, see
+// NormalizedKey and Frame::key_prefix().
+// the value of a leaf record is a column: the number of fields in 2 bytes,
+// then every field as its type in 1 byte and its data, which takes 1 byte for
+// a bool, 4 for an int, 8 for a double, and for a string its length in 2
+// bytes and its characters.
+// the value of an internal record is the child page number in 4 bytes.
+// NOTE: the fields are in host byte order and unaligned, accessed by memcpy.
+namespace record_format {
+
+template <typename T>
+T read(const char *src) {
+    T value;
+    std::memcpy(&value, src, sizeof(T));
+    return value;
+}
+
+template <typename T>
+char *write(char *dst, const T &value) {
+    std::memcpy(dst, &value, sizeof(T));
+    return dst + sizeof(T);
+}
+
+// NOTE: a malformed record is only met by an optimistic reader racing with a
+// writer, which has to catch the exception and restart.
+inline void check(bool well_formed) {
+    if (!well_formed)
+        throw std::out_of_range("malformed record");
+}
+
+} // namespace record_format
+
+// KeyView is a normalized key read in place, see NormalizedKey. the key is
+// the key prefix of its page followed by the suffix stored in the record, see
+// Frame::key_prefix().
+class KeyView {
+public:
+    KeyView(KeyType type, std::string_view prefix, std::string_view suffix)
+        : type_(type), prefix_(prefix), suffix_(suffix) {}
+
+    KeyType type() const { return type_; }
+    // whether @key is of the type of the view.
+    bool same_type(const Key &key) const {
+        return static_cast<size_t>(type_) == key.index();
+    }
+    bool same_type(const NormalizedKey &key) const {
+        return type_ == key.type();
+    }
+    // the length of the normalized key.
+    size_t size() const { return prefix_.size() + suffix_.size(); }
+    // the normalized bytes of the key stored in the record.
+    std::string_view suffix() const { return suffix_; }
+    // the normalized bytes of the key.
+    std::string bytes() const {
+        std::string bytes;
+        bytes.reserve(size());
+        bytes.append(prefix_).append(suffix_);
+        return bytes;
+    }
+
+    // compare with @key of the same type: < 0, 0 or > 0 as the view is less
+    // than, equal to or greater than @key.
+    int compare(const NormalizedKey &key) const {
+        // NOTE: compared as string_views, the prefix of a page without one is
+        // null, which memcmp must not get.
+        auto bytes = key.bytes();
+        int cmp = prefix_.compare(bytes.substr(0, prefix_.size()));
+        if (cmp != 0)
+            return cmp;
+        return NormalizedKey::compare(suffix_, bytes.substr(prefix_.size()));
+    }
+    int compare(const Key &key) const { return compare(NormalizedKey(key)); }
+
+    // the length of the common prefix of the normalized key and @bytes.
+    size_t common_prefix_len(std::string_view bytes) const {
+        size_t len = 0;
+        for (auto piece : {prefix_, suffix_}) {
+            size_t n = std::min(piece.size(), bytes.size() - len);
+            size_t i = std::mismatch(piece.begin(), piece.begin() + n,
+                                     bytes.begin() + len)
+                           .first -
+                       piece.begin();
+            len += i;
+            if (i < piece.size())
+                break;
+        }
+        return len;
+    }
+    // whether the normalized key starts with @bytes.
+    bool has_prefix(std::string_view bytes) const {
+        return common_prefix_len(bytes) == bytes.size();
+    }
+
+    // materialize the key.
+    Key key() const { return NormalizedKey::decode(type_, bytes()); }
+
+    static size_t encoded_len(const Key &key) {
+        return NormalizedKey::encoded_len(key);
+    }
+
+    // write the normalized @key at @dst.
+    // @return the end of the write.
+    static char *encode(char *dst, const Key &key) {
+        return NormalizedKey::encode(dst, key);
+    }
+
+private:
+    KeyType type_;
+    std::string_view prefix_;
+    std::string_view suffix_;
+};
+
+// ColumnView is the column of a leaf record read in place.
+class ColumnView {
+public:
+    ColumnView(const char *data, const char *end) : data_(data), end_(end) {
+        record_format::check(data_ + sizeof(uint16_t) <= end_);
+    }
+
+    size_t size() const { return record_format::read<uint16_t>(data_); }
+
+    // materialize the field @i.
+    Value field(size_t i) const {
+        const char *pos = data_ + sizeof(uint16_t);
+        for (size_t j = 0; j < i; j++)
+            pos = skip(pos);
+        Value value;
+        read_field(pos, value);
+        return value;
+    }
+
+    // materialize the column.
+    Column column() const {
+        Column column(size());
+        const char *pos = data_ + sizeof(uint16_t);
+        for (auto &value : column)
+            pos = read_field(pos, value);
+        return column;
+    }
+
+    static page_off_t encoded_len(const Column &column) {
+        page_off_t len = sizeof(uint16_t);
+        for (auto &value : column) {
+            len += sizeof(uint8_t);
+            switch (value.index()) {
+            case 0:
+                len += sizeof(bool);
+                break;
+            case 1:
+                len += sizeof(int);
+                break;
+            case 2:
+                len += sizeof(double);
+                break;
+            default:
+                len += sizeof(uint16_t) + std::get<std::string>(value).size();
+            }
+        }
+        return len;
+    }
+
+    // write @column at @dst.
+    // @return the end of the write.
+    static char *encode(char *dst, const Column &column) {
+        using namespace record_format;
+        dst = write(dst, static_cast<uint16_t>(column.size()));
+        for (auto &value : column) {
+            dst = write(dst, static_cast<uint8_t>(value.index()));
+            switch (value.index()) {
+            case 0:
+                dst = write(dst, std::get<bool>(value));
+                break;
+            case 1:
+                dst = write(dst, std::get<int>(value));
+                break;
+            case 2:
+                dst = write(dst, std::get<double>(value));
+                break;
+            default:
+                auto &str = std::get<std::string>(value);
+                dst = write(dst, static_cast<uint16_t>(str.size()));
+                std::memcpy(dst, str.data(), str.size());
+                dst += str.size();
+            }
+        }
+        return dst;
+    }
+
+private:
+    // the end of the field at @pos.
+    const char *skip(const char *pos) const {
+        record_format::check(pos + sizeof(uint8_t) <= end_);
+        return skip(pos + sizeof(uint8_t), record_format::read<uint8_t>(pos));
+    }
+    // the end of the field of @type whose value is at @pos.
+    const char *skip(const char *pos, uint8_t type) const {
+        using namespace record_format;
+        switch (type) {
+        case 0:
+            return pos + sizeof(bool);
+        case 1:
+            return pos + sizeof(int);
+        case 2:
+            return pos + sizeof(double);
+        case 3:
+            check(pos + sizeof(uint16_t) <= end_);
+            return pos + sizeof(uint16_t) + read<uint16_t>(pos);
+        }
+        check(false);
+        return pos;
+    }
+
+    // @return the end of the field.
+    // NOTE: the type is read once, a racing writer can't make the value read
+    // longer than the field checked.
+    const char *read_field(const char *pos, Value &value) const {
+        using namespace record_format;
+        check(pos + sizeof(uint8_t) <= end_);
+        uint8_t type = read<uint8_t>(pos++);
+        const char *end = skip(pos, type);
+        check(end <= end_);
+        switch (type) {
+        case 0:
+            value = read<uint8_t>(pos) != 0;
+            break;
+        case 1:
+            value = read<int>(pos);
+            break;
+        case 2:
+            value = read<double>(pos);
+            break;
+        default:
+            value = std::string(pos + sizeof(uint16_t),
+                                end - pos - sizeof(uint16_t));
+        }
+        return end;
+    }
+
+    const char *data_;
+    const char *end_;
+};
+
+// RecordView is a record of an index page read and written in place, see
+// record_format above. the key in the record is stripped of the key prefix of
+// the page, see Frame::key_prefix().
+class RecordView {
+public:
+    // the offsets of the header fields.
+    static constexpr page_off_t LENGTH = 0;
+    static constexpr page_off_t STATUS = 2;
+    static constexpr page_off_t KEY_TYPE = 3;
+    static constexpr page_off_t KEY_LENGTH = 4;
+    static constexpr page_off_t HDR_LEN = 6;
+
+    RecordView() = default;
+    // view the record at @data, which has @limit bytes up to the end of the
+    // page, in a page of the key prefix @prefix.
+    // NOTE: throws std::out_of_range if the record doesn't fit, which only
+    // happens to a torn read. the lengths are read once and kept, a writer
+    // racing with the reader can't move the key or the value out of the page
+    // after the check.
+    RecordView(char *data, page_off_t limit, std::string_view prefix = {})
+        : data_(data), prefix_(prefix) {
+        record_format::check(limit >= HDR_LEN);
+        length_ = get<uint16_t>(LENGTH);
+        key_len_ = get<uint16_t>(KEY_LENGTH);
+        record_format::check(length_ <= limit && HDR_LEN + key_len_ <= length_);
+    }
+
+    char *data() const { return data_; }
+    uint16_t length() const { return length_; }
+
+    bool is_deleted() const {
+        return get<uint8_t>(STATUS) == uint8_t(config::RecordStatus::Deleted);
+    }
+    void set_status(config::RecordStatus status) {
+        set(STATUS, static_cast<uint8_t>(status));
+    }
+
+    KeyView key() const {
+        return {KeyType(get<uint8_t>(KEY_TYPE)), prefix_,
+                {data_ + HDR_LEN, key_len()}};
+    }
+    // overwrite the key stored in the record with the normalized @suffix,
+    // which must be of the same length.
+    void set_key(std::string_view suffix) {
+        std::memcpy(data_ + HDR_LEN, suffix.data(), suffix.size());
+    }
+
+    // the value of a leaf record.
+    ColumnView column() const { return {value(), data_ + length()}; }
+
+    // the value of an internal record.
+    page_id_t child() const {
+        record_format::check(value() + sizeof(page_id_t) <= data_ + length());
+        return record_format::read<page_id_t>(value());
+    }
+    void set_child(page_id_t child) { record_format::write(value(), child); }
+
+    // materialize the record.
+    template <typename R>
+    R materialize() const {
+        R record;
+        record.hdr.status = get<uint8_t>(STATUS);
+        record.hdr.length = length();
+        record.key = key().key();
+        if constexpr (std::is_same_v<R, LeafClusteredRecord>)
+            record.value = column().column();
+        else
+            record.value = child();
+        return record;
+    }
+
+    // the length of the record of a key stored in @key_len bytes and @value.
+    // NOTE: may be past what the uint16_t length of a record holds, a record
+    // longer than Page::payload_len() must be refused before it's written.
+    static size_t encoded_len(size_t key_len, const Column &value) {
+        return HDR_LEN + key_len + ColumnView::encoded_len(value);
+    }
+    static size_t encoded_len(size_t key_len, page_id_t child) {
+        return HDR_LEN + key_len + sizeof(child);
+    }
+    template <typename V>
+    static size_t encoded_len(const Key &key, const V &value) {
+        return encoded_len(KeyView::encoded_len(key), value);
+    }
+
+    // write the record of the normalized key @key of @type stored as @suffix
+    // and @value at @dst.
+    template <typename V>
+    static RecordView write(char *dst, KeyType type, std::string_view suffix,
+                            const V &value) {
+        RecordView record(dst);
+        record.set_lengths(encoded_len(suffix.size(), value), suffix.size());
+        record.set(STATUS, uint8_t(config::RecordStatus::Normal));
+        record.set(KEY_TYPE, static_cast<uint8_t>(type));
+        std::memcpy(dst + HDR_LEN, suffix.data(), suffix.size());
+        char *end = dst + HDR_LEN + suffix.size();
+        if constexpr (std::is_same_v<V, Column>)
+            ColumnView::encode(end, value);
+        else
+            record_format::write(end, static_cast<page_id_t>(value));
+        return record;
+    }
+    // write the record of @key and @value at @dst, the key in full.
+    template <typename V>
+    static RecordView write(char *dst, const Key &key, const V &value) {
+        NormalizedKey normalized(key);
+        return write(dst, normalized.type(), normalized.bytes(), value);
+    }
+
+    // the length of @src copied into a page of a key prefix of @prefix_len.
+    static page_off_t copy_len(const RecordView &src, size_t prefix_len) {
+        return src.length() + src.prefix_.size() - prefix_len;
+    }
+    // copy @src at @dst, into a page whose key prefix is the first
+    // @prefix_len bytes of the key of @src.
+    static RecordView copy(char *dst, const RecordView &src,
+                           size_t prefix_len = 0) {
+        RecordView record(dst);
+        uint8_t type = src.get<uint8_t>(KEY_TYPE);
+        record.set_lengths(copy_len(src, prefix_len),
+                           src.key().size() - prefix_len);
+        record.set(STATUS, uint8_t(config::RecordStatus::Normal));
+        record.set(KEY_TYPE, type);
+        // the key from @prefix_len on, then the value.
+        char *pos = dst + HDR_LEN;
+        size_t skip = prefix_len;
+        for (auto piece : {src.prefix_, src.key().suffix()}) {
+            size_t n = std::min(skip, piece.size());
+            // NOTE: an empty piece may be null, the prefix of a page without.
+            if (n < piece.size())
+                std::memmove(pos, piece.data() + n, piece.size() - n);
+            pos += piece.size() - n;
+            skip -= n;
+        }
+        std::memmove(pos, src.value(), src.data_ + src.length() - src.value());
+        return record;
+    }
+
+private:
+    // NOTE: unchecked, for records being written.
+    explicit RecordView(char *data) : data_(data) {}
+
+    template <typename T>
+    T get(page_off_t field) const {
+        return record_format::read<T>(data_ + field);
+    }
+    template <typename T>
+    void set(page_off_t field, const T &value) {
+        record_format::write(data_ + field, value);
+    }
+
+    void set_lengths(size_t length, size_t key_len) {
+        length_ = static_cast<uint16_t>(length);
+        key_len_ = static_cast<uint16_t>(key_len);
+        set(LENGTH, length_);
+        set(KEY_LENGTH, key_len_);
+    }
+
+    uint16_t key_len() const { return key_len_; }
+    char *value() const { return data_ + HDR_LEN + key_len(); }
+
+    char *data_ = nullptr;
+    // the LENGTH and KEY_LENGTH fields, as checked by the constructor.
+    uint16_t length_ = 0;
+    uint16_t key_len_ = 0;
+    // the key prefix of the page.
+    std::string_view prefix_;
+};
+
+} // namespace storage
+
+#endif // !STORAGE_INCLUDE_INDEX_RECORD_VIEW_H
@@ -5,6 +5,8 @@
 #include <cereal/cereal.hpp>
 #include <cereal/types/vector.hpp>
 #include <string>
+#include <utility>
+#include <variant>
 #include <vector>
 
 namespace storage {
@@ -12,10 +14,12 @@ namespace storage {
 struct KeyMeta {
     std::string name;
     key_t type;
+    // the order of the column in a composite key.
+    KeyOrder order = KeyOrder::Asc;
 
     template <class Archive>
     void serialize(Archive &archive) {
-        archive(name, type);
+        archive(name, type, order);
     }
 };
 
@@ -31,12 +35,45 @@ struct FieldMeta {
 
 struct RecordMeta {
     KeyMeta key;
+    // the columns of a composite key, whose type is KeyType::Composite.
+    std::vector<KeyMeta> key_columns;
 
     std::vector<FieldMeta> fields;
 
     template <class Archive>
     void serialize(Archive &archive) {
-        archive(key, fields);
+        archive(key, key_columns, fields);
+    }
+
+    // the composite key of @columns, the first columns of the key, in the
+    // orders of the key columns.
+    CompositeKey make_key(std::vector<KeyColumn> columns) const {
+        std::vector<KeyOrder> orders;
+        for (size_t i = 0; i < columns.size() && i < key_columns.size(); i++)
+            orders.push_back(key_columns[i].order);
+        return CompositeKey(std::move(columns), std::move(orders));
+    }
+
+    // whether @key is of the type of the key. a composite key of the first
+    // columns only is a match if @is_prefix.
+    bool match_key(const Key &key, bool is_prefix = false) const {
+        if (key.index() != this->key.type)
+            return false;
+        auto composite = std::get_if<CompositeKey>(&key);
+        if (!composite)
+            return true;
+
+        auto &columns = composite->columns;
+        if (columns.size() > key_columns.size() ||
+            (!is_prefix && columns.size() < key_columns.size()) ||
+            composite->orders.size() != columns.size())
+            return false;
+        for (size_t i = 0; i < columns.size(); i++) {
+            if (columns[i].index() != key_columns[i].type ||
+                composite->orders[i] != key_columns[i].order)
+                return false;
+        }
+        return true;
     }
 };
 
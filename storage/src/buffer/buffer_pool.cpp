@@ -3,37 +3,172 @@
 #include "error.h"
 #include "tl/expected.hpp"
 #include "types.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <unordered_map>
 
 namespace storage {
-tl::expected<Frame *, ErrorCode> BufferPoolManager::get_frame(page_id_t pgno) {
+
+static uint64_t elapsed_ns(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+std::shared_ptr<BufferPoolManager> BufferPoolManager::shared() {
+    static auto pool =
+        std::make_shared<BufferPoolManager>(config::DEFAULT_POOL_SIZE);
+    return pool;
+}
+
+file_id_t
+BufferPoolManager::add_file(std::shared_ptr<DiskManager> disk_manager) {
+    std::scoped_lock lock(latch_);
+    files_.push_back(std::move(disk_manager));
+    resident_.push_back(0);
+    reserved_.push_back(0);
+    return files_.size() - 1;
+}
+
+ErrorCode BufferPoolManager::remove_file(file_id_t file) {
+    std::scoped_lock lock(latch_);
+    if (!disk(file))
+        return ErrorCode::Success;
+
+    // NOTE: nothing is dropped before every page of the file is known to be
+    // unpinned and written back, a failure leaves the file as it was.
+    std::vector<Frame *> frames;
+    for (auto &frame : pool_) {
+        if (frame.is_empty() || frame.file() != file)
+            continue;
+        Frame *cached;
+        if (cache_.peek(frame.key(), cached) != ErrorCode::Success ||
+            cached != &frame)
+            continue;
+        if (cache_.is_pinned(frame.key())) {
+            record(PoolEvent::PinWait, *frame.page());
+            return ErrorCode::FramePinned;
+        }
+        frames.push_back(&frame);
+    }
+    for (auto *frame : frames) {
+        auto ec = flush_frame_unlocked(frame);
+        if (ec != ErrorCode::Success)
+            return ec;
+    }
+
+    for (auto *frame : frames) {
+        cache_remove(frame);
+        frame->write_lock();
+        frame->reset();
+        frame->write_unlock();
+        free_list_.push_back(frame->id());
+    }
+    if (secondary_)
+        secondary_->remove_file(file);
+    files_[file].reset();
+    reserved_[file] = 0;
+    return ErrorCode::Success;
+}
+
+ErrorCode BufferPoolManager::reserve(file_id_t file, size_t frames) {
+    std::scoped_lock lock(latch_);
+    if (!disk(file))
+        return ErrorCode::InvalidPoolSize;
+    reserved_[file] = frames;
+    return ErrorCode::Success;
+}
+
+size_t BufferPoolManager::resident_size(file_id_t file) const {
+    std::scoped_lock lock(latch_);
+    return file < resident_.size() ? resident_[file] : 0;
+}
+
+ErrorCode BufferPoolManager::cache_put(Frame *frame) {
+    auto ec = cache_.put(frame->key(), frame);
+    if (ec == ErrorCode::Success)
+        resident_[frame->file()]++;
+    return ec;
+}
+
+ErrorCode BufferPoolManager::cache_put_back(Frame *frame) {
+    auto ec = cache_.put_back(frame->key(), frame);
+    if (ec == ErrorCode::Success)
+        resident_[frame->file()]++;
+    return ec;
+}
+
+ErrorCode BufferPoolManager::cache_remove(Frame *frame) {
+    auto ec = cache_.remove(frame->key());
+    if (ec == ErrorCode::Success)
+        resident_[frame->file()]--;
+    return ec;
+}
+
+tl::expected<Frame *, ErrorCode> BufferPoolManager::get_frame(file_id_t file,
+                                                              page_id_t pgno) {
+    std::scoped_lock lock(latch_);
     Frame *frame;
-    if (cache_.get(pgno, frame) == ErrorCode::Success) {
+    if (cache_.get(make_page_key(file, pgno), frame) == ErrorCode::Success) {
         // Log::GlobalLog() << "[BufferPoolManager] got cached frame for page "
         //                  << frame->pgno() << std::endl;
+        record(PoolEvent::Hit, *frame->page());
+        acquire_for_write(frame);
         return frame;
     }
     if (pgno == 0)
         return tl::unexpected(ErrorCode::GetRootPage);
-    auto result = disk_manager_->read_page(pgno);
+    if (!disk(file))
+        return tl::unexpected(ErrorCode::DiskReadError);
+    // Log::GlobalLog()
+    //     << "[BufferPoolManager] page not cached, read and cache page "
+    //     << frame->pgno() << std::endl;
+    auto result = get_free_frame(file, pgno, true);
     if (result) {
-        // Log::GlobalLog()
-        //     << "[BufferPoolManager] page not cached, read and cache page "
-        //     << frame->pgno() << std::endl;
-        return get_free_frame(result.value());
-    } else {
-        return tl::unexpected(result.error());
+        record(PoolEvent::Miss, *result.value()->page());
+        acquire_for_write(result.value());
+    }
+    return result;
+}
+
+tl::expected<Frame *, ErrorCode>
+BufferPoolManager::get_child_frame(Frame *parent, page_id_t pgno) {
+    Frame *child = parent->swizzled_child(pgno);
+    if (child && child->pgno() == pgno && child->file() == parent->file() &&
+        !WriteScope::current(this)) {
+        child->mark_referenced();
+        record(PoolEvent::Hit, *child->page());
+        return child;
     }
+
+    std::scoped_lock lock(latch_);
+    auto frame = get_frame(parent->file(), pgno);
+    if (!frame)
+        return frame;
+    // NOTE: the parent may have got another page meanwhile.
+    if (!parent->is_empty())
+        parent->swizzle(frame.value());
+    return frame;
 }
 
-tl::expected<Frame *, ErrorCode> BufferPoolManager::allocate_frame() {
-    auto result = disk_manager_->get_free_page();
+tl::expected<Frame *, ErrorCode>
+BufferPoolManager::allocate_frame(file_id_t file) {
+    std::scoped_lock lock(latch_);
+    if (!disk(file))
+        return tl::unexpected(ErrorCode::DiskWriteError);
+    auto result = disk(file)->allocate_page();
     if (!result)
         return tl::unexpected(result.error());
 
-    auto frame = get_free_frame(result.value());
+    auto frame = get_free_frame(file, result.value(), false);
     if (frame) {
         // every new page is dirty
         frame.value()->mark_dirty();
+        acquire_for_write(frame.value());
         // Log::GlobalLog() << "[BufferPoolManager] allocated frame for new page
         // "
         //                  << frame.value()->pgno() << std::endl;
@@ -44,14 +179,18 @@ tl::expected<Frame *, ErrorCode> BufferPoolManager::allocate_frame() {
 }
 
 ErrorCode BufferPoolManager::remove_frame(Frame *frame) {
+    std::scoped_lock lock(latch_);
+    frame->set_protected(false);
+    // the page number may come back with another page.
+    frame->unswizzle();
     free_list_.push_back(frame->id());
-    auto ec = cache_.remove(frame->pgno());
+    auto ec = cache_remove(frame);
     if (ec != ErrorCode::Success)
         return ec;
 
     Frame *test;
-    assert(cache_.get(frame->pgno(), test) != ErrorCode::Success);
-    ec = disk_manager_->set_page_free(frame->pgno());
+    assert(cache_.get(frame->key(), test) != ErrorCode::Success);
+    ec = disk(frame->file())->set_page_free(frame->pgno());
     if (ec != ErrorCode::Success)
         return ec;
 
@@ -61,36 +200,109 @@ ErrorCode BufferPoolManager::remove_frame(Frame *frame) {
 }
 
 tl::expected<frame_id_t, ErrorCode> BufferPoolManager::get_free_frame_id() {
-    if (free_list_.empty()) {
-        auto result = cache_.victim();
+    // keep retiring the tail frames while the pool is shrinking.
+    if (retired_from_ > pool_size_ || retired_from_ < pool_.size())
+        shrink_step(config::POOL_SHRINK_BATCH);
+
+    auto free = take_free_frame_id();
+    if (free)
+        return free.value();
+
+    // frames accessed through swizzled references bypass the LRU list, they
+    // get a second chance instead; so do frames of files holding no more
+    // than their reservations. at most one round.
+    size_t chances = cache_.size();
+    while (true) {
+        auto result = cache_.victim([this](Frame *pinned) {
+            record(PoolEvent::PinWait, *pinned->page());
+        });
         if (!result) {
             return tl::unexpected(result.error());
         }
 
         // Log::GlobalLog() << "[LRU] get a victim " << result.value()->id()
         //                  << std::endl;
-        return result.value()->id();
-    }
+        Frame *victim = result.value();
+        if ((victim->test_and_clear_referenced() || is_reserved(victim)) &&
+            chances > 0) {
+            chances--;
+            cache_.put(victim->key(), victim);
+            continue;
+        }
+        // the victim is to be retired, write it back and leave it free.
+        // NOTE: a page failing to be written back stays cached.
+        if (victim->id() >= pool_size_) {
+            auto ec = flush_frame_unlocked(victim);
+            if (ec != ErrorCode::Success) {
+                cache_.put(victim->key(), victim);
+                return tl::unexpected(ec);
+            }
+        }
+        resident_[victim->file()]--;
+        record(PoolEvent::Eviction, *victim->page());
+        admit_secondary(victim);
+        if (victim->id() < pool_size_)
+            return victim->id();
 
-    // NOTE: return a reference which will be invalid after erasion
-    // frame_id_t id = free_list_.front();
+        victim->write_lock();
+        victim->reset();
+        victim->write_unlock();
+        free_list_.push_back(victim->id());
+    }
+}
 
-    frame_id_t id = free_list_.front();
-    free_list_.pop_front();
+tl::expected<frame_id_t, ErrorCode> BufferPoolManager::take_free_frame_id() {
+    // NOTE: free frames beyond the target size are left for shrink_step, and
+    // frames removed by a writer still in its scope are left to the writer.
+    frame_id_t id;
+    if (!free_list_.take_if(
+            [this](frame_id_t id) {
+                return id < pool_size_ && !pool_[id].is_write_locked();
+            },
+            id))
+        return tl::unexpected(ErrorCode::PoolNoFreeFrame);
     return id;
 }
 
 tl::expected<Frame *, ErrorCode>
-BufferPoolManager::get_free_frame(std::shared_ptr<Page> page) {
+BufferPoolManager::get_free_frame(file_id_t file, page_id_t pgno,
+                                  bool read) {
     Frame *frame;
+    page_key_t key = make_page_key(file, pgno);
+    // take the page out of the second-level cache first, which makes room
+    // for the admission of our own victim.
+    // NOTE: the page is dropped if no frame is free, it's a clean copy.
+    auto start = std::chrono::steady_clock::now();
+    bool secondary_hit =
+        read && secondary_ && secondary_->fetch(key) == ErrorCode::Success;
+    uint64_t secondary_ns = secondary_hit ? elapsed_ns(start) : 0;
     auto free = get_free_frame_id();
     if (!free)
         return tl::unexpected(free.error());
     frame = &pool_[free.value()];
-    frame->reassign(page);
+    // readers still holding the frame restart on the new version.
+    frame->write_lock();
+    frame->reassign(file, pgno);
+    if (secondary_hit) {
+        secondary_->load_fetched(*frame->page());
+        record(PoolEvent::SecondaryHit, *frame->page(), secondary_ns);
+    } else if (read) {
+        start = std::chrono::steady_clock::now();
+        auto ec = disk(file)->read_page(pgno, *frame->page());
+        if (ec != ErrorCode::Success) {
+            frame->reset();
+            frame->write_unlock();
+            free_list_.push_back(frame->id());
+            return tl::unexpected(ec);
+        }
+        record(PoolEvent::DiskRead, *frame->page(), elapsed_ns(start));
+        if (secondary_)
+            record(PoolEvent::SecondaryMiss, *frame->page());
+    }
+    frame->write_unlock();
 
     // Log::GlobalLog() << "[LRU] put " << page->pgno() << std::endl;
-    ErrorCode ec = cache_.put(page->pgno(), frame);
+    ErrorCode ec = cache_put(frame);
     if (ec == ErrorCode::Success) {
         // Log::GlobalLog()
         //     << std::format(
@@ -107,31 +319,78 @@ BufferPoolManager::get_free_frame(std::shared_ptr<Page> page) {
     }
 }
 
-ErrorCode BufferPoolManager::pin_frame(page_id_t pgno) {
-    auto ec = cache_.pin(pgno);
+ErrorCode BufferPoolManager::pin_frame(file_id_t file, page_id_t pgno) {
+    std::scoped_lock lock(latch_);
+    auto ec = cache_.pin(make_page_key(file, pgno));
     if (ec != ErrorCode::Success)
         return ec;
 
     return ErrorCode::Success;
 }
 
-ErrorCode BufferPoolManager::unpin_frame(page_id_t pgno) {
-    auto ec = cache_.unpin(pgno);
+ErrorCode BufferPoolManager::unpin_frame(file_id_t file, page_id_t pgno) {
+    std::scoped_lock lock(latch_);
+    auto ec = cache_.unpin(make_page_key(file, pgno));
+    if (ec != ErrorCode::Success)
+        return ec;
+    return ErrorCode::Success;
+}
+
+ErrorCode BufferPoolManager::protect_frame(Frame *frame) {
+    std::scoped_lock lock(latch_);
+    if (frame->is_protected())
+        return ErrorCode::Success;
+    if (cache_.protected_size() >= protected_budget_)
+        return ErrorCode::PoolProtectedFull;
+    // NOTE: frames being retired are never protected.
+    if (frame->id() >= pool_size_)
+        return ErrorCode::PoolProtectedFull;
+
+    auto ec = cache_.protect(frame->key());
+    if (ec != ErrorCode::Success)
+        return ec;
+    frame->set_protected(true);
+    return ErrorCode::Success;
+}
+
+ErrorCode BufferPoolManager::unprotect_frame(Frame *frame) {
+    std::scoped_lock lock(latch_);
+    if (!frame->is_protected())
+        return ErrorCode::Success;
+
+    auto ec = cache_.unprotect(frame->key());
     if (ec != ErrorCode::Success)
         return ec;
+    frame->set_protected(false);
     return ErrorCode::Success;
 }
 
 // flush the dirty page, if not dirty, do nothing.
 // if pinned, return PageAlreadyPinned error.
 ErrorCode BufferPoolManager::flush_frame(Frame *frame) {
+    std::scoped_lock lock(latch_);
+    return flush_frame_unlocked(frame);
+}
+
+ErrorCode BufferPoolManager::flush_frame_unlocked(Frame *frame) {
+    // the file has been removed, nowhere to write back.
+    if (!disk(frame->file())) {
+        frame->clear_dirty();
+        return ErrorCode::Success;
+    }
     if (frame->is_dirty()) {
-        auto ec = disk_manager_->write_page(frame->page());
+        // a copy in the second-level cache gets stale.
+        if (secondary_)
+            secondary_->remove(frame->key());
+        auto start = std::chrono::steady_clock::now();
+        auto ec = disk(frame->file())->write_page(*frame->page());
         if (ec != ErrorCode::Success) {
             // Log::GlobalLog() << "[BufferPoolManager]: failed to flush page "
             //                  << frame->pgno() << std::endl;
             return ec;
         }
+        record(PoolEvent::DiskWrite, *frame->page(), elapsed_ns(start));
+        record(PoolEvent::DirtyWriteBack, *frame->page());
     }
 
     // Log::GlobalLog() << "[BufferPoolManager]: flushed page " << frame->pgno()
@@ -144,7 +403,7 @@ ErrorCode BufferPoolManager::flush_frame(Frame *frame) {
 ErrorCode BufferPoolManager::flush_all() {
     auto ec = for_each([this](Frame *frame) -> ErrorCode {
         if (frame->is_dirty()) {
-            auto ec = disk_manager_->write_page(frame->page());
+            auto ec = flush_frame_unlocked(frame);
             return ErrorCode::Success;
         }
         return ErrorCode::Success;
@@ -156,11 +415,437 @@ ErrorCode BufferPoolManager::flush_all() {
 }
 
 ErrorCode BufferPoolManager::for_each(const TraverseFunc &func) {
-    for (int i = 0; i < pool_size_; i++) {
+    std::scoped_lock lock(latch_);
+    for (size_t i = 0; i < pool_.size(); i++) {
         auto ec = func(&pool_[i]);
         if (ec != ErrorCode::Success)
             return ec;
     }
     return ErrorCode::Success;
 }
+
+ErrorCode BufferPoolManager::resize(size_t pool_size) {
+    if (pool_size == 0)
+        return ErrorCode::InvalidPoolSize;
+
+    std::scoped_lock lock(latch_);
+    pool_size_ = pool_size;
+    // bring the retired frames not destroyed yet back first.
+    while (retired_from_ < pool_.size() && retired_from_ < pool_size_)
+        free_list_.push_back(retired_from_++);
+    // new frames are appended so that frames in use never move.
+    free_list_.reserve(std::max(pool_.size(), pool_size_));
+    while (pool_.size() < pool_size_) {
+        frame_id_t id = pool_.size();
+        pool_.emplace_back(this, id);
+        free_list_.push_back(id);
+        retired_from_++;
+    }
+    cache_.set_max_size(retired_from_);
+
+    // start retiring now, later misses carry on.
+    shrink_step(config::POOL_SHRINK_BATCH);
+
+    // Log::GlobalLog() << std::format("[BufferPoolManager]: resize to {}, "
+    //                                 "{} frames held now",
+    //                                 pool_size_, pool_.size())
+    //                  << std::endl;
+    return ErrorCode::Success;
+}
+
+bool BufferPoolManager::shrink_step(size_t batch) {
+    while (retired_from_ > pool_size_ && batch > 0) {
+        Frame *frame = &pool_[retired_from_ - 1];
+        Frame *cached;
+        // a writer still holds the frame.
+        if (frame->is_write_locked())
+            break;
+        if (!frame->is_empty() &&
+            cache_.peek(frame->key(), cached) == ErrorCode::Success &&
+            cached == frame) {
+            // protection is not kept for retiring frames.
+            if (frame->is_protected()) {
+                cache_.unprotect(frame->key());
+                frame->set_protected(false);
+            }
+            // wait until the page gets unpinned.
+            if (cache_.is_pinned(frame->key())) {
+                record(PoolEvent::PinWait, *frame->page());
+                break;
+            }
+            if (flush_frame_unlocked(frame) != ErrorCode::Success)
+                break;
+            cache_remove(frame);
+            record(PoolEvent::Eviction, *frame->page());
+        }
+
+        free_list_.remove(frame->id());
+        frame->write_lock();
+        frame->reset();
+        frame->write_unlock();
+        retired_from_--;
+        retire_epoch_ = epoch_.load();
+        batch--;
+    }
+    cache_.set_max_size(retired_from_);
+    reclaim();
+
+    return retired_from_ <= pool_size_;
+}
+
+std::atomic<int64_t> &BufferPoolManager::readers(uint64_t epoch) {
+    static std::atomic<size_t> next_id{0};
+    thread_local size_t id = next_id.fetch_add(1, std::memory_order_relaxed) %
+                             config::POOL_READER_SHARDS;
+    return reader_shards_[id].readers[epoch & 1];
+}
+
+void BufferPoolManager::reclaim() {
+    if (retired_from_ == pool_.size())
+        return;
+
+    auto count = [this](uint64_t epoch) {
+        int64_t sum = 0;
+        for (auto &shard : reader_shards_)
+            sum += shard.readers[epoch & 1].load();
+        return sum;
+    };
+    // NOTE: a guard counted by the parity of the next epoch could only have
+    // entered two epochs ago, wait for it before moving on.
+    uint64_t epoch = epoch_.load();
+    if (epoch == retire_epoch_) {
+        if (count(epoch + 1) != 0)
+            return;
+        epoch_.store(++epoch);
+    }
+    // every guard which might reference the retired frames is gone.
+    if (count(retire_epoch_) != 0)
+        return;
+    while (pool_.size() > retired_from_)
+        pool_.pop_back();
+}
+
+ErrorCode BufferPoolManager::set_secondary_cache(const std::string &path,
+                                                size_t pages) {
+    std::scoped_lock lock(latch_);
+    secondary_.reset();
+    if (pages == 0)
+        return ErrorCode::Success;
+
+    auto result = SecondaryCache::open(path, pages);
+    if (!result)
+        return result.error();
+    secondary_ = std::move(result.value());
+    return ErrorCode::Success;
+}
+
+void BufferPoolManager::admit_secondary(Frame *victim) {
+    // NOTE: a dirty victim is written back to its file instead.
+    if (!secondary_ || victim->is_dirty() || !disk(victim->file()))
+        return;
+    if (secondary_->put(victim->key(), *victim->page()) == ErrorCode::Success)
+        record(PoolEvent::SecondaryWrite, *victim->page());
+}
+
+BufferPoolStats BufferPoolManager::stats() const {
+    BufferPoolStats stats;
+    stats_.snapshot(stats);
+
+    std::scoped_lock lock(latch_);
+    stats.pool_size = retired_from_;
+    stats.frames_in_use = cache_.size();
+    for (auto &frame : pool_) {
+        if (frame.is_dirty())
+            stats.dirty_frames++;
+    }
+    return stats;
+}
+
+// the absolute path of @file, the way the dump names it.
+static std::string dump_path(const DiskManager &file) {
+    std::error_code ec;
+    auto path = std::filesystem::absolute(file.filename(), ec);
+    return ec ? file.filename() : path.string();
+}
+
+ErrorCode BufferPoolManager::dump_resident(const std::string &path) const {
+    // NOTE: the file ids are the order the files were added in, which
+    // another run doesn't keep. the keys refer to the files by their
+    // positions in @paths instead.
+    std::vector<std::string> paths;
+    std::vector<page_key_t> keys;
+    {
+        std::scoped_lock lock(latch_);
+        std::vector<uint32_t> positions(files_.size());
+        for (size_t i = 0; i < files_.size(); i++) {
+            if (!files_[i])
+                continue;
+            positions[i] = paths.size();
+            paths.push_back(dump_path(*files_[i]));
+        }
+        keys.reserve(cache_.size());
+        cache_.for_each([&](page_key_t key, Frame *) {
+            file_id_t file = key >> 32;
+            if (disk(file))
+                keys.push_back(make_page_key(positions[file], page_id_t(key)));
+        });
+    }
+
+    std::ofstream os(path, std::ios::binary | std::ios::trunc);
+    auto write_u32 = [&os](uint32_t value) {
+        os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    };
+    write_u32(paths.size());
+    for (auto &file : paths) {
+        write_u32(file.size());
+        os.write(file.data(), file.size());
+    }
+    write_u32(keys.size());
+    os.write(reinterpret_cast<const char *>(keys.data()),
+             keys.size() * sizeof(page_key_t));
+    if (!os.good()) {
+        Log::GlobalLog() << "[BufferPoolManager]: failed to dump to " << path
+                         << std::endl;
+        return ErrorCode::DiskWriteError;
+    }
+    return ErrorCode::Success;
+}
+
+ErrorCode BufferPoolManager::warm_up(const std::string &path) {
+    std::error_code error;
+    size_t left = std::filesystem::file_size(path, error);
+    if (error)
+        return ErrorCode::DiskReadError;
+    std::ifstream is(path, std::ios::binary);
+    // NOTE: every count read is checked against the bytes left in the file
+    // before anything is allocated for it, a truncated or corrupt dump
+    // fails instead.
+    auto read_u32 = [&is, &left](uint32_t &value) {
+        if (left < sizeof(value))
+            return false;
+        is.read(reinterpret_cast<char *>(&value), sizeof(value));
+        left -= sizeof(value);
+        return is.good();
+    };
+
+    // the files of the dump by their positions, and the files served now
+    // of the same paths.
+    uint32_t number_of_files = 0;
+    if (!read_u32(number_of_files) ||
+        number_of_files > left / sizeof(uint32_t))
+        return ErrorCode::DiskReadError;
+    std::vector<std::optional<file_id_t>> files(number_of_files);
+    for (auto &file : files) {
+        uint32_t len = 0;
+        if (!read_u32(len) || len > left)
+            return ErrorCode::DiskReadError;
+        std::string file_path(len, '\0');
+        is.read(file_path.data(), len);
+        left -= len;
+        if (!is.good())
+            return ErrorCode::DiskReadError;
+        std::scoped_lock lock(latch_);
+        for (size_t i = 0; i < files_.size(); i++) {
+            if (files_[i] && dump_path(*files_[i]) == file_path)
+                file = i;
+        }
+    }
+
+    // no more pages than the file holds are read, and no more than the pool
+    // takes are kept.
+    uint32_t count = 0;
+    if (!read_u32(count) || count > left / sizeof(page_key_t))
+        return ErrorCode::DiskReadError;
+    std::vector<page_key_t> keys;
+    keys.reserve(std::min<size_t>(count, target_size()));
+    for (uint32_t i = 0; i < count; i++) {
+        page_key_t key;
+        is.read(reinterpret_cast<char *>(&key), sizeof(key));
+        if (!is.good())
+            return ErrorCode::DiskReadError;
+        uint32_t position = key >> 32;
+        if (position < files.size() && files[position] &&
+            keys.size() < target_size())
+            keys.push_back(make_page_key(*files[position], page_id_t(key)));
+    }
+
+    for (size_t i = 0; i < keys.size() && !stop_warm_up_;
+         i += config::WARM_UP_BATCH) {
+        auto last = std::min(keys.size(), i + config::WARM_UP_BATCH);
+        auto ec = warm_up_batch(std::span(keys).subspan(i, last - i));
+        // the pool is full, that's all we can do.
+        if (ec == ErrorCode::PoolNoFreeFrame)
+            break;
+        if (ec != ErrorCode::Success)
+            return ec;
+    }
+    return ErrorCode::Success;
+}
+
+ErrorCode BufferPoolManager::prefetch(file_id_t file,
+                                      std::span<const page_id_t> pgnos) {
+    std::scoped_lock lock(latch_);
+    auto &keys = batch_keys_;
+    keys.clear();
+    for (auto pgno : pgnos)
+        keys.push_back(make_page_key(file, pgno));
+    for (size_t i = 0; i < keys.size(); i += config::WARM_UP_BATCH) {
+        auto last = std::min(keys.size(), i + config::WARM_UP_BATCH);
+        auto ec = warm_up_batch(std::span(keys).subspan(i, last - i), true);
+        if (ec != ErrorCode::Success)
+            return ec;
+    }
+    return ErrorCode::Success;
+}
+
+ErrorCode BufferPoolManager::warm_up_batch(std::span<const page_key_t> keys,
+                                           bool victimize) {
+    std::scoped_lock lock(latch_);
+
+    auto &sorted = batch_sorted_;
+    sorted.clear();
+    for (auto key : keys) {
+        page_id_t pgno = key;
+        if (pgno != 0 && disk(key >> 32) && !cache_.exists(key))
+            sorted.push_back(key);
+    }
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    if (batch_buf_.size() < sorted.size() * config::PAGE_SIZE)
+        batch_buf_.resize(sorted.size() * config::PAGE_SIZE);
+    batch_ns_.resize(sorted.size());
+
+    // read by runs of consecutive pages of the same file, the page of
+    // sorted[i] at the i-th page of the scratch.
+    for (size_t i = 0; i < sorted.size();) {
+        file_id_t file = sorted[i] >> 32;
+        size_t j = i + 1;
+        while (j < sorted.size() && sorted[j] == sorted[j - 1] + 1 &&
+               file_id_t(sorted[j] >> 32) == file &&
+               j - i < config::MAX_READ_RUN)
+            j++;
+
+        auto start = std::chrono::steady_clock::now();
+        auto ec = disk(file)->read_pages(
+            page_id_t(sorted[i]), j - i,
+            batch_buf_.data() + i * config::PAGE_SIZE);
+        if (ec != ErrorCode::Success)
+            return ec;
+        std::fill(batch_ns_.begin() + i, batch_ns_.begin() + j,
+                  elapsed_ns(start) / (j - i));
+        i = j;
+    }
+
+    // cache from the hottest to the coldest.
+    for (auto key : keys) {
+        auto it = std::lower_bound(sorted.begin(), sorted.end(), key);
+        // not read, or a key repeated and cached already.
+        if (it == sorted.end() || *it != key || cache_.exists(key))
+            continue;
+        auto free = victimize ? get_free_frame_id() : take_free_frame_id();
+        if (!free)
+            return free.error();
+
+        size_t i = it - sorted.begin();
+        Frame *frame = &pool_[free.value()];
+        frame->write_lock();
+        frame->reassign(key >> 32, page_id_t(key));
+        frame->page()->deserizalize(batch_buf_.data() +
+                                    i * config::PAGE_SIZE);
+        frame->page()->hdr.pgno = page_id_t(key);
+        frame->write_unlock();
+        record(PoolEvent::DiskRead, *frame->page(), batch_ns_[i]);
+        auto ec = victimize ? cache_put(frame) : cache_put_back(frame);
+        if (ec != ErrorCode::Success) {
+            frame->reset();
+            free_list_.push_back(frame->id());
+            return ErrorCode::PoolNoFreeFrame;
+        }
+    }
+    return ErrorCode::Success;
+}
+
+void BufferPoolManager::start_warm_up(const std::string &path) {
+    wait_warm_up();
+    stop_warm_up_ = false;
+    warm_up_thread_ =
+        std::thread([this, path]() { warm_up_result_ = warm_up(path); });
+}
+
+ErrorCode BufferPoolManager::wait_warm_up() {
+    if (warm_up_thread_.joinable())
+        warm_up_thread_.join();
+    return warm_up_result_;
+}
+
+void BufferPoolManager::acquire_for_write(Frame *frame) {
+    // NOTE: under the pool latch no replacement is going on, a latched frame
+    // must have been latched by the writer itself.
+    auto *scope = WriteScope::current(this);
+    if (!scope || frame->is_write_locked())
+        return;
+
+    cache_.pin(frame->key());
+    frame->write_lock();
+    scope->frames_.push_back(frame);
+}
+
+ReadGuard::ReadGuard(BufferPoolManager *pool) : pool_(pool) {
+    while (true) {
+        epoch_ = pool_->epoch_.load();
+        auto &readers = pool_->readers(epoch_);
+        readers.fetch_add(1);
+        // the epoch moved on before the guard got counted.
+        if (pool_->epoch_.load() == epoch_)
+            return;
+        readers.fetch_sub(1);
+    }
+}
+
+ReadGuard::~ReadGuard() { pool_->readers(epoch_).fetch_sub(1); }
+
+thread_local WriteScope *WriteScope::current_ = nullptr;
+
+WriteScope::WriteScope(BufferPoolManager *pool)
+    : pool_(pool), outer_(current_) {
+    pool_->writer_latch_.lock();
+    current_ = this;
+}
+
+WriteScope::~WriteScope() {
+    current_ = outer_;
+
+    {
+        std::scoped_lock lock(pool_->latch_);
+        for (auto *frame : frames_) {
+            // the page may have been removed by the writer.
+            Frame *cached;
+            if (pool_->cache_.peek(frame->key(), cached) ==
+                    ErrorCode::Success &&
+                cached == frame)
+                pool_->cache_.unpin(frame->key());
+            frame->write_unlock();
+        }
+    }
+    pool_->writer_latch_.unlock();
+}
+
+bool WriteScope::upgrade(Frame *frame, uint64_t version) {
+    std::scoped_lock lock(pool_->latch_);
+    Frame *cached;
+    if (frame->is_empty() ||
+        pool_->cache_.peek(frame->key(), cached) != ErrorCode::Success ||
+        cached != frame)
+        return false;
+
+    pool_->cache_.pin(frame->key());
+    if (!frame->try_upgrade(version)) {
+        pool_->cache_.unpin(frame->key());
+        return false;
+    }
+    frames_.push_back(frame);
+    active_ = true;
+    return true;
+}
+
 } // namespace storage
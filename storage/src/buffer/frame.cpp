@@ -2,32 +2,87 @@
 #include "buffer/buffer_pool.h"
 #include "index/cursor.h"
 #include "types.h"
+#include <cstring>
 
 namespace storage {
 
 Frame::~Frame() {
-    if (is_dirty() && page_)
+    if (is_dirty() && !is_empty())
         pool_->flush_frame(this);
 }
 
-// template <typename T>
-// page_off_t Frame::dump_at(page_off_t absolute, const T &value) {
-//     membuf_.setp(absolute);
-//     std::ostream os(&membuf_);
-//     serialization::serialize(os, value);
-//     return ppos() - absolute;
-// }
-
-void Frame::reassign(std::shared_ptr<Page> page) {
+void Frame::reassign(file_id_t file, page_id_t pgno) {
     if (is_dirty())
         pool_->flush_frame(this);
-    page_ = std::move(page);
+    unswizzle();
+    file_ = file;
     clear_dirty();
+    set_protected(false);
+    page_.hdr = PageHdr(pgno);
+}
+
+void Frame::reset() {
+    unswizzle();
+    page_.hdr.pgno = 0;
+    clear_dirty();
+    set_protected(false);
+}
+
+void Frame::swizzle(Frame *child) {
+    auto &swip = (*swips_)[child->pgno() % config::SWIZZLE_SLOTS];
+    Frame *old = swip.frame.load(std::memory_order_relaxed);
+    if (old == child)
+        return;
+    // the slot is taken by another child, take it over.
+    if (old && old->swizzled_in_ == this)
+        old->swizzled_in_ = nullptr;
+    // a child is referenced by one parent only.
+    if (child->swizzled_in_) {
+        auto &stale = (*child->swizzled_in_
+                           ->swips_)[child->pgno() % config::SWIZZLE_SLOTS];
+        if (stale.frame.load(std::memory_order_relaxed) == child) {
+            stale.pgno.store(0, std::memory_order_release);
+            stale.frame.store(nullptr, std::memory_order_release);
+        }
+    }
 
-    // membuf_ =
-    //     std::make_shared<common::MemBuf>(page_->payload,
-    //     page_->payload_len());
-    membuf_.init(page_->payload, page_->payload_len());
+    swip.pgno.store(0, std::memory_order_release);
+    swip.frame.store(child, std::memory_order_release);
+    swip.pgno.store(child->pgno(), std::memory_order_release);
+    child->swizzled_in_ = this;
+}
+
+void Frame::unswizzle() {
+    if (swizzled_in_) {
+        auto &swip = (*swizzled_in_->swips_)[pgno() % config::SWIZZLE_SLOTS];
+        if (swip.frame.load(std::memory_order_relaxed) == this) {
+            swip.pgno.store(0, std::memory_order_release);
+            swip.frame.store(nullptr, std::memory_order_release);
+        }
+        swizzled_in_ = nullptr;
+    }
+    for (auto &swip : *swips_) {
+        Frame *child = swip.frame.load(std::memory_order_relaxed);
+        if (child && child->swizzled_in_ == this)
+            child->swizzled_in_ = nullptr;
+        swip.pgno.store(0, std::memory_order_release);
+        swip.frame.store(nullptr, std::memory_order_release);
+    }
+    if (root_ref_) {
+        Frame *self = this;
+        root_ref_->compare_exchange_strong(self, nullptr);
+        root_ref_ = nullptr;
+    }
+    set_flag(REFERENCED, false);
+}
+
+void Frame::swizzle_root(std::atomic<Frame *> &ref, Frame *root) {
+    Frame *old = ref.load(std::memory_order_relaxed);
+    if (old && old->root_ref_ == &ref)
+        old->root_ref_ = nullptr;
+    if (root)
+        root->root_ref_ = &ref;
+    ref.store(root, std::memory_order_release);
 }
 
 // return nullptr if the frame is the root frame.
@@ -36,45 +91,44 @@ tl::expected<Frame *, ErrorCode> Frame::parent_frame() const {
     if (page()->hdr.parent_page == 0)
         return nullptr;
 
-    return pool_->get_frame(page()->hdr.parent_page);
+    return pool_->get_frame(file_, page()->hdr.parent_page);
+}
+
+tl::expected<Cursor<RecordView>, ErrorCode> Frame::parent_record() const {
+    return parent_frame().and_then(
+        [this](Frame *parent) -> tl::expected<Cursor<RecordView>, ErrorCode> {
+            if (!parent)
+                return tl::unexpected(ErrorCode::GetRootParent);
+
+            return parent->child_record_off(pgno()).map(
+                [parent](page_off_t offset) {
+                    return Cursor<RecordView>{parent->pgno(), offset,
+                                              parent->record_at(offset)};
+                });
+        });
 }
 
-tl::expected<Cursor<InternalClusteredRecord>, ErrorCode>
-Frame::parent_record() const {
-    InternalClusteredRecord record;
-    return parent_frame()
-        .and_then(
-            [this](Frame *parent)
-                -> tl::expected<Cursor<InternalClusteredRecord>, ErrorCode> {
-                if (!parent) {
-                    return tl::unexpected(ErrorCode::GetRootParent);
-                }
-
-                InternalClusteredRecord record;
-                parent->load_at(this->page()->hdr.parent_record_off, record);
-
-                return Cursor<InternalClusteredRecord>{parent->pgno(),
-                                                       parent->gpos(), record};
-            })
-        .or_else(
-            [](ErrorCode ec)
-                -> tl::expected<Cursor<InternalClusteredRecord>, ErrorCode> {
-                return tl::unexpected(ec);
-            });
+tl::expected<page_off_t, ErrorCode>
+Frame::child_record_off(page_id_t child) const {
+    for (int i = 0; i < number_of_records(); i++) {
+        page_off_t offset = slot(i);
+        if (record_at(offset).child() == child)
+            return offset;
+    }
+    return tl::unexpected(ErrorCode::NodeNotFound);
 }
 
-void Frame::set_parent(page_id_t parent, page_off_t offset) {
+void Frame::set_parent(page_id_t parent) {
     page()->hdr.parent_page = parent;
-    page()->hdr.parent_record_off = offset;
     mark_dirty();
 }
 
 tl::expected<Frame *, ErrorCode> Frame::prev_frame() {
-    return pool_->get_frame(page()->hdr.prev_page);
+    return pool_->get_frame(file_, page()->hdr.prev_page);
 }
 
 tl::expected<Frame *, ErrorCode> Frame::next_frame() {
-    return pool_->get_frame(page()->hdr.next_page);
+    return pool_->get_frame(file_, page()->hdr.next_page);
 }
 
 // tl::expected<Frame *, ErrorCode>
@@ -0,0 +1,140 @@
+#include "buffer/pool_stats.h"
+#include <format>
+#include <string>
+#include <vector>
+
+namespace storage {
+
+PoolCounters &PoolCounters::operator+=(const PoolCounters &other) {
+    hits += other.hits;
+    misses += other.misses;
+    evictions += other.evictions;
+    dirty_write_backs += other.dirty_write_backs;
+    pin_waits += other.pin_waits;
+    disk_reads += other.disk_reads;
+    disk_read_ns += other.disk_read_ns;
+    disk_writes += other.disk_writes;
+    disk_write_ns += other.disk_write_ns;
+    secondary_hits += other.secondary_hits;
+    secondary_read_ns += other.secondary_read_ns;
+    secondary_misses += other.secondary_misses;
+    secondary_writes += other.secondary_writes;
+    return *this;
+}
+
+void PoolStatsCollector::Slot::add_to(PoolCounters &counters) const {
+    auto get = [this](PoolEvent event) {
+        return count[static_cast<size_t>(event)].load(
+            std::memory_order_relaxed);
+    };
+    auto get_ns = [this](PoolEvent event) {
+        return ns[static_cast<size_t>(event)].load(std::memory_order_relaxed);
+    };
+
+    counters.hits += get(PoolEvent::Hit);
+    counters.misses += get(PoolEvent::Miss);
+    counters.evictions += get(PoolEvent::Eviction);
+    counters.dirty_write_backs += get(PoolEvent::DirtyWriteBack);
+    counters.pin_waits += get(PoolEvent::PinWait);
+    counters.disk_reads += get(PoolEvent::DiskRead);
+    counters.disk_read_ns += get_ns(PoolEvent::DiskRead);
+    counters.disk_writes += get(PoolEvent::DiskWrite);
+    counters.disk_write_ns += get_ns(PoolEvent::DiskWrite);
+    counters.secondary_hits += get(PoolEvent::SecondaryHit);
+    counters.secondary_read_ns += get_ns(PoolEvent::SecondaryHit);
+    counters.secondary_misses += get(PoolEvent::SecondaryMiss);
+    counters.secondary_writes += get(PoolEvent::SecondaryWrite);
+}
+
+void PoolStatsCollector::snapshot(BufferPoolStats &stats) const {
+    stats.leaf = {};
+    stats.internal = {};
+    stats.indices.clear();
+
+    std::vector<PoolCounters> indices(std::tuple_size_v<
+                                      decltype(Shard::by_index)>);
+    for (auto &shard : shards_) {
+        shard.by_type[0].add_to(stats.leaf);
+        shard.by_type[1].add_to(stats.internal);
+        for (size_t i = 0; i < indices.size(); i++)
+            shard.by_index[i].add_to(indices[i]);
+    }
+
+    for (size_t i = 0; i < indices.size(); i++) {
+        auto &c = indices[i];
+        if (c.hits + c.misses + c.evictions + c.dirty_write_backs +
+                c.pin_waits + c.disk_reads + c.disk_writes +
+                c.secondary_hits + c.secondary_misses + c.secondary_writes !=
+            0)
+            stats.indices.emplace(static_cast<index_id_t>(i), c);
+    }
+
+    stats.total = stats.leaf;
+    stats.total += stats.internal;
+}
+
+void PoolStatsCollector::reset() {
+    for (auto &shard : shards_) {
+        auto clear = [](Slot &slot) {
+            for (auto &c : slot.count)
+                c.store(0, std::memory_order_relaxed);
+            for (auto &c : slot.ns)
+                c.store(0, std::memory_order_relaxed);
+        };
+        for (auto &slot : shard.by_type)
+            clear(slot);
+        for (auto &slot : shard.by_index)
+            clear(slot);
+    }
+}
+
+size_t PoolStatsCollector::shard_id() {
+    static std::atomic<size_t> next_id{0};
+    thread_local size_t id =
+        next_id.fetch_add(1, std::memory_order_relaxed) %
+        config::POOL_STATS_SHARDS;
+    return id;
+}
+
+void BufferPoolStats::export_text(std::ostream &os) const {
+    using Field = uint64_t PoolCounters::*;
+    static const std::vector<std::pair<std::string, Field>> metrics = {
+        {"hits", &PoolCounters::hits},
+        {"misses", &PoolCounters::misses},
+        {"evictions", &PoolCounters::evictions},
+        {"dirty_write_backs", &PoolCounters::dirty_write_backs},
+        {"pin_waits", &PoolCounters::pin_waits},
+        {"disk_reads", &PoolCounters::disk_reads},
+        {"disk_read_ns", &PoolCounters::disk_read_ns},
+        {"disk_writes", &PoolCounters::disk_writes},
+        {"disk_write_ns", &PoolCounters::disk_write_ns},
+        {"secondary_hits", &PoolCounters::secondary_hits},
+        {"secondary_read_ns", &PoolCounters::secondary_read_ns},
+        {"secondary_misses", &PoolCounters::secondary_misses},
+        {"secondary_writes", &PoolCounters::secondary_writes},
+    };
+
+    for (auto &[name, field] : metrics) {
+        auto metric = std::format("minidb_buffer_pool_{}_total", name);
+        os << "# TYPE " << metric << " counter\n";
+        os << metric << "{page_type=\"leaf\"} " << leaf.*field << "\n";
+        os << metric << "{page_type=\"internal\"} " << internal.*field
+           << "\n";
+    }
+    for (auto &[name, field] : metrics) {
+        auto metric = std::format("minidb_buffer_pool_index_{}_total", name);
+        os << "# TYPE " << metric << " counter\n";
+        for (auto &[index, counters] : indices)
+            os << metric << "{index=\"" << int(index) << "\"} "
+               << counters.*field << "\n";
+    }
+
+    os << "# TYPE minidb_buffer_pool_frames gauge\n";
+    os << "minidb_buffer_pool_frames " << pool_size << "\n";
+    os << "# TYPE minidb_buffer_pool_frames_in_use gauge\n";
+    os << "minidb_buffer_pool_frames_in_use " << frames_in_use << "\n";
+    os << "# TYPE minidb_buffer_pool_dirty_frames gauge\n";
+    os << "minidb_buffer_pool_dirty_frames " << dirty_frames << "\n";
+}
+
+} // namespace storage
@@ -0,0 +1,103 @@
+#include "buffer/secondary_cache.h"
+#include "config.h"
+#include "log.h"
+#include <filesystem>
+#include <vector>
+
+namespace storage {
+
+SecondaryCache::SecondaryCache(const std::string &path, size_t pages)
+    : path_(path), slots_(pages),
+      read_buf_(std::make_unique<char[]>(config::PAGE_SIZE)),
+      write_buf_(std::make_unique<char[]>(config::PAGE_SIZE)) {
+    free_slots_.reserve(pages);
+    for (size_t i = 0; i < pages; i++)
+        free_slots_.push_back(i);
+}
+
+SecondaryCache::~SecondaryCache() {
+    io_.close();
+    std::error_code ec;
+    std::filesystem::remove(path_, ec);
+}
+
+tl::expected<std::unique_ptr<SecondaryCache>, ErrorCode>
+SecondaryCache::open(const std::string &path, size_t pages) {
+    if (pages == 0)
+        return tl::unexpected(ErrorCode::InvalidPoolSize);
+
+    std::unique_ptr<SecondaryCache> cache(new SecondaryCache(path, pages));
+    cache->io_.open(path, std::ios::binary | std::ios::trunc | std::ios::in |
+                              std::ios::out);
+    if (!cache->io_.is_open()) {
+        Log::GlobalLog() << "[SecondaryCache]: failed to open " << path
+                         << std::endl;
+        return tl::unexpected(ErrorCode::DiskWriteError);
+    }
+    return cache;
+}
+
+ErrorCode SecondaryCache::fetch(page_key_t key) {
+    slot_id_t slot;
+    if (slots_.peek(key, slot) != ErrorCode::Success)
+        return ErrorCode::CacheEntryNotFound;
+    slots_.remove(key);
+    free_slots_.push_back(slot);
+
+    io_.seekg(static_cast<size_t>(slot) * config::PAGE_SIZE);
+    io_.read(read_buf_.get(), config::PAGE_SIZE);
+    if (!io_.good()) {
+        io_.clear();
+        return ErrorCode::DiskReadError;
+    }
+    return ErrorCode::Success;
+}
+
+ErrorCode SecondaryCache::put(page_key_t key, const Page &page) {
+    slot_id_t slot;
+    if (slots_.peek(key, slot) == ErrorCode::Success) {
+        // rewrite the slot in place and make it the most recent.
+        slots_.put(key, slot);
+    } else if (!free_slots_.take_if([](slot_id_t) { return true; }, slot)) {
+        auto victim = slots_.victim();
+        if (!victim)
+            return victim.error();
+        slot = victim.value();
+    }
+
+    auto ec = page.serialize(write_buf_.get());
+    if (ec != ErrorCode::Success) {
+        free_slots_.push_back(slot);
+        slots_.remove(key);
+        return ec;
+    }
+    io_.seekp(static_cast<size_t>(slot) * config::PAGE_SIZE);
+    io_.write(write_buf_.get(), config::PAGE_SIZE);
+    if (!io_.good()) {
+        io_.clear();
+        free_slots_.push_back(slot);
+        slots_.remove(key);
+        return ErrorCode::DiskWriteError;
+    }
+    return slots_.put(key, slot);
+}
+
+void SecondaryCache::remove(page_key_t key) {
+    slot_id_t slot;
+    if (slots_.peek(key, slot) != ErrorCode::Success)
+        return;
+    slots_.remove(key);
+    free_slots_.push_back(slot);
+}
+
+void SecondaryCache::remove_file(file_id_t file) {
+    std::vector<page_key_t> keys;
+    slots_.for_each([&](page_key_t key, slot_id_t) {
+        if (file_id_t(key >> 32) == file)
+            keys.push_back(key);
+    });
+    for (auto key : keys)
+        remove(key);
+}
+
+} // namespace storage
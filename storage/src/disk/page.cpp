@@ -2,7 +2,10 @@
 
 namespace storage {
 size_t Page::HdrOffset = offsetof(Page, hdr);
-size_t Page::PayloadOffset = offsetof(Page, payload);
+// NOTE: the payload follows the header right away on disk, where the
+// payload_len() bytes left of a page are. offsetof(Page, payload) is past
+// them once the header isn't pointer aligned.
+size_t Page::PayloadOffset = sizeof(PageHdr);
 
 void Page::deserizalize(const char *data) {
     ::memcpy(this + HdrOffset, data, sizeof(PageHdr));
@@ -12,10 +15,17 @@ void Page::deserizalize(const char *data) {
 tl::expected<std::shared_ptr<char>, ErrorCode> Page::serialize() const {
     std::shared_ptr<char> raw =
         std::shared_ptr<char>(new char[config::PAGE_SIZE]{0});
-    ::memcpy(raw.get(), this + HdrOffset, sizeof(PageHdr));
-    if (!payload)
-        return tl::unexpected(ErrorCode::InvalidPagePayload);
-    ::memcpy(raw.get() + PayloadOffset, payload, payload_len());
+    auto ec = serialize(raw.get());
+    if (ec != ErrorCode::Success)
+        return tl::unexpected(ec);
     return raw;
 }
+
+ErrorCode Page::serialize(char *raw) const {
+    ::memcpy(raw, this + HdrOffset, sizeof(PageHdr));
+    if (!payload)
+        return ErrorCode::InvalidPagePayload;
+    ::memcpy(raw + PayloadOffset, payload, payload_len());
+    return ErrorCode::Success;
+}
 } // namespace storage
@@ -1,13 +1,14 @@
 #include "index/index.h"
-#include "cereal/details/helpers.hpp"
 #include "config.h"
 #include "error.h"
+#include "index/index_iterator.h"
 #include "index/index_node.h"
+#include "index/normalized_key.h"
 #include "index/record.h"
 #include "log.h"
 #include "tl/expected.hpp"
 #include "types.h"
-#include <cmath>
+#include <algorithm>
 #include <cstring>
 #include <format>
 
@@ -17,43 +18,243 @@ namespace storage {
 tl::expected<Cursor<LeafClusteredRecord>, ErrorCode>
 Index::get_cursor(const Key &key) {
     // Log::GlobalLog() << "going to get cursor on key " << key << std::endl;
-    auto leaf = search_leaf(key);
-    if (!leaf)
-        return tl::unexpected(leaf.error());
-    auto frame = leaf.value();
-
-    LeafIndexNode node(frame, comp_);
-    auto result = node.get_cursor(key);
-    if (!result)
-        return tl::unexpected(result.error());
-    return result.value();
+    if (!meta_.record_meta.match_key(key, true))
+        return tl::unexpected(ErrorCode::InvalidKeyType);
+    ReadGuard guard(pool_.get());
+    while (true) {
+        uint64_t version;
+        auto leaf = search_leaf(key, version);
+        if (!leaf)
+            return tl::unexpected(leaf.error());
+        auto frame = leaf.value();
+
+        tl::expected<Cursor<LeafClusteredRecord>, ErrorCode> result =
+            tl::unexpected(ErrorCode::ReadConflict);
+        try {
+            LeafIndexNode node(frame, comp_);
+            result = node.get_cursor(key);
+        } catch (...) {
+            // a torn read, the validation below fails.
+        }
+        if (!frame->validate(version))
+            continue;
+        return result;
+    }
 }
 
 tl::expected<LeafClusteredRecord, ErrorCode>
 Index::search_record(const Key &key) {
-    auto leaf = search_leaf(key);
-    if (!leaf)
-        return tl::unexpected(leaf.error());
-    auto frame = leaf.value();
+    if (!meta_.record_meta.match_key(key))
+        return tl::unexpected(ErrorCode::InvalidKeyType);
+    ReadGuard guard(pool_.get());
+    while (true) {
+        uint64_t version;
+        auto leaf = search_leaf(key, version);
+        if (!leaf)
+            return tl::unexpected(leaf.error());
+        auto frame = leaf.value();
+
+        tl::expected<LeafClusteredRecord, ErrorCode> result =
+            tl::unexpected(ErrorCode::ReadConflict);
+        try {
+            LeafIndexNode node(frame, comp_);
+            result = node.search_record(key);
+        } catch (...) {
+            // a torn read, the validation below fails.
+        }
+        if (!frame->validate(version))
+            continue;
+        // Log::GlobalLog() << "found record on key " << key << std::endl;
+        return result;
+    }
+}
 
-    LeafIndexNode node(frame, comp_);
-    auto result = node.search_record(key);
-    if (!result) {
-        LeafIndexNode node(frame, comp_);
-        // Log::GlobalLog() << "failed to search " << key << std::endl;
-        // node.print();
-        // Log::GlobalLog() << "prev: " << node.frame_->page()->hdr.prev_page
-        //                  << "; next " << node.frame_->page()->hdr.next_page
-        //                  << std::endl;
-        // auto parent = frame->parent_frame();
-        // if (parent && parent.value()) {
-        //     InternalIndexNode parent_node(parent.value(), comp_);
-        //     parent_node.print();
-        // }
-        return tl::unexpected(result.error());
+// every page read is validated before the keys go on to its children, a page
+// of a conflict leaves its keys to search_record() one by one.
+std::vector<tl::expected<LeafClusteredRecord, ErrorCode>>
+Index::multi_get(std::span<const Key> keys) {
+    MultiGet get;
+    get.results.resize(keys.size(), tl::unexpected(ErrorCode::KeyNotFound));
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (!meta_.record_meta.match_key(keys[i])) {
+            get.results[i] = tl::unexpected(ErrorCode::InvalidKeyType);
+            continue;
+        }
+        get.sorted.push_back(get.normalized.size());
+        get.normalized.emplace_back(keys[i]);
+        get.positions.push_back(i);
+    }
+    auto &normalized = get.normalized;
+    std::sort(get.sorted.begin(), get.sorted.end(),
+              [&normalized](size_t lhs, size_t rhs) {
+                  return NormalizedKey::compare(normalized[lhs].bytes(),
+                                                normalized[rhs].bytes()) < 0;
+              });
+    get.window = std::clamp<size_t>(pool_->size() / 4, 1,
+                                    config::INDEX_MULTI_GET_WINDOW);
+
+    {
+        ReadGuard guard(pool_.get());
+        page_id_t pgno = root_page();
+        auto root = get_frame(pgno);
+        uint64_t version = root ? root.value()->read_version() : 0;
+        if (root && root.value()->holds(file_, pgno) && root_page() == pgno)
+            multi_get_page(get, {root.value(), version, 0, get.sorted.size()});
+        else
+            get.conflict(0, get.sorted.size());
+    }
+
+    for (auto i : get.conflicts)
+        get.results[i] = search_record(keys[i]);
+    return std::move(get.results);
+}
+
+void Index::multi_get_page(MultiGet &get, const MultiGetGroup &group) {
+    Frame *frame = group.frame;
+    bool is_leaf = frame->is_leaf();
+    // the children of an internal page, and the keys going through them.
+    std::vector<std::pair<page_id_t, MultiGetGroup>> children;
+    bool torn = false;
+    try {
+        auto key_at = [&get](size_t k) -> const NormalizedKey & {
+            return get.key(k);
+        };
+        if (is_leaf) {
+            LeafIndexNode node(frame, comp_);
+            node.search_records(
+                group.begin, group.end, key_at,
+                [&get](size_t k) -> auto & { return get.result(k); });
+        } else {
+            InternalIndexNode node(frame, comp_);
+            auto runs = node.get_children(group.begin, group.end, key_at);
+            if (!runs) {
+                for (size_t k = group.begin; k < group.end; k++)
+                    get.result(k) = tl::unexpected(runs.error());
+            } else {
+                size_t begin = group.begin;
+                for (auto [pgno, end] : runs.value()) {
+                    children.push_back({pgno, {nullptr, 0, begin, end}});
+                    begin = end;
+                }
+            }
+        }
+    } catch (...) {
+        torn = true;
+    }
+    if (torn || !frame->validate(group.version)) {
+        get.conflict(group.begin, group.end);
+        return;
+    }
+    if (is_leaf)
+        return;
+    protect_upper_frame(frame);
+
+    // the children are read a window at a time, each window right after its
+    // misses are prefetched, so that they are still cached once read.
+    for (size_t w = 0; w < children.size(); w += get.window) {
+        size_t last = std::min(children.size(), w + get.window);
+        // the children not referenced by the page are likely not cached.
+        // NOTE: the windows of the children are prefetched after this one
+        // is, the scratch is free again.
+        auto &missing = get.missing;
+        missing.clear();
+        for (size_t c = w; c < last; c++) {
+            if (!frame->swizzled_child(children[c].first))
+                missing.push_back(children[c].first);
+        }
+        if (missing.size() > 1)
+            pool_->prefetch(file_, missing);
+
+        std::vector<MultiGetGroup> window;
+        for (size_t c = w; c < last; c++) {
+            auto &[pgno, child] = children[c];
+            auto result = pool_->get_child_frame(frame, pgno);
+            if (!result) {
+                for (size_t k = child.begin; k < child.end; k++)
+                    get.result(k) = tl::unexpected(result.error());
+                continue;
+            }
+            child.frame = result.value();
+            child.version = child.frame->read_version();
+            if (!child.frame->holds(file_, pgno) ||
+                !frame->validate(group.version))
+                get.conflict(child.begin, child.end);
+            else
+                window.push_back(child);
+        }
+        for (auto &child : window)
+            multi_get_page(get, child);
+    }
+}
+
+// the records of a leaf are collected and handed out once the leaf is
+// validated, then the scan goes on in the next leaf. a conflict restarts the
+// scan from the last record handed out.
+ErrorCode Index::scan_prefix(const Key &prefix,
+                             const RecordTraverseFunc &func) {
+    if (!meta_.record_meta.match_key(prefix, true))
+        return ErrorCode::InvalidKeyType;
+
+    NormalizedKey normalized(prefix);
+    ReadGuard guard(pool_.get());
+    std::vector<LeafClusteredRecord> records;
+    Key from = prefix;
+    bool after = false;
+    Frame *frame = nullptr;
+    uint64_t version;
+    // the leaf the scan left for @frame through the next_page link, if any.
+    Frame *left = nullptr;
+    uint64_t left_version = 0;
+    while (true) {
+        if (!frame) {
+            left = nullptr;
+            auto leaf = search_leaf(from, version);
+            if (!leaf)
+                return leaf.error();
+            frame = leaf.value();
+        }
+
+        records.clear();
+        tl::expected<bool, ErrorCode> more =
+            tl::unexpected(ErrorCode::ReadConflict);
+        page_id_t next = 0;
+        try {
+            LeafIndexNode node(frame, comp_);
+            more = node.scan_prefix(from, after, normalized.bytes(), records);
+            next = frame->page()->hdr.next_page;
+        } catch (...) {
+            // a torn read, the validation below fails.
+        }
+        // NOTE: records moved from @frame into the leaf left after it was
+        // read would be missed, the move writes the leaf left too.
+        if (!frame->validate(version) ||
+            (left && !left->validate(left_version))) {
+            frame = nullptr;
+            continue;
+        }
+        if (!more)
+            return more.error();
+
+        for (auto &record : records)
+            func(record);
+        if (!records.empty()) {
+            from = std::move(records.back().key);
+            after = true;
+        }
+        if (!more.value() || next == 0)
+            return ErrorCode::Success;
+
+        left = frame;
+        left_version = version;
+        auto result = get_frame(next);
+        if (!result)
+            return result.error();
+        frame = result.value();
+        version = frame->read_version();
+        // the next leaf has been replaced meanwhile, descend again.
+        if (!frame->holds(file_, next) || !frame->is_leaf())
+            frame = nullptr;
     }
-    // Log::GlobalLog() << "found record on key " << key << std::endl;
-    return result.value();
 }
 
 tl::expected<Frame *, ErrorCode> Index::search_leaf(const Key &key) {
@@ -62,80 +263,165 @@ tl::expected<Frame *, ErrorCode> Index::search_leaf(const Key &key) {
         return tl::unexpected(result.error());
     auto frame = result.value();
     while (!frame->is_leaf()) {
+        protect_upper_frame(frame);
         InternalIndexNode node(frame, comp_);
         // Log::GlobalLog() << std::format(
         //     "page {} has {} childs\n", frame->pgno(),
         //     node.number_of_records());
         // node.print();
-        auto result = node.get_cursor(key);
+        auto result = node.get_child(key);
         if (!result)
             return tl::unexpected(result.error());
-        auto cursor = result.value();
 
-        auto child = pool_->get_frame(cursor.record.value);
+        auto child = get_frame(result.value());
         if (!child) {
             Log::GlobalLog() << std::format("error when reading page {}\n",
-                                            cursor.record.value);
+                                            result.value());
             return tl::unexpected(child.error());
         }
         frame = child.value();
         // Log::GlobalLog() << std::format("{}", frame->pgno()) << " ";
     }
-    // Log::GlobalLog() << std::endl;
-    // Log::GlobalLog() << "found leaf " << frame->pgno() << " on key " << key
-    //                  << std::endl;
-
-    LeafIndexNode node(frame, comp_);
-    // node.print();
 
     return frame;
 }
 
-ErrorCode Index::insert_record(const Key &key, const Column &value) {
-    // FIXME: key and column type check
-    auto leaf = search_leaf(key);
-    if (!leaf)
-        return leaf.error();
+tl::expected<Frame *, ErrorCode>
+Index::search_leaf(const Key &key, uint64_t &version,
+                   std::optional<std::string> *fence) {
+    while (true) {
+        auto result = try_search_leaf(&key, false, version, fence);
+        if (result || result.error() != ErrorCode::ReadConflict)
+            return result;
+    }
+}
 
-    Frame *frame = leaf.value();
-    balance_for_insert(frame);
+tl::expected<Frame *, ErrorCode> Index::search_edge_leaf(bool last,
+                                                         uint64_t &version) {
+    while (true) {
+        auto result = try_search_leaf(nullptr, last, version);
+        if (result || result.error() != ErrorCode::ReadConflict)
+            return result;
+    }
+}
 
-    leaf = search_leaf(key);
-    if (!leaf)
-        return leaf.error();
+tl::expected<Frame *, ErrorCode>
+Index::try_search_leaf(const Key *key, bool last, uint64_t &version,
+                       std::optional<std::string> *fence) {
+    if (fence)
+        fence->reset();
+    page_id_t pgno = root_page();
+    Frame *frame = root_frame_.load(std::memory_order_acquire);
+    if (frame && frame->holds(file_, pgno)) {
+        frame->mark_referenced();
+    } else {
+        auto result = get_frame(pgno);
+        if (!result)
+            return tl::unexpected(result.error());
+        frame = result.value();
+        pool_->swizzle_root(root_frame_, frame);
+    }
+    version = frame->read_version();
+    // the root may have been split or replaced meanwhile.
+    if (!frame->holds(file_, pgno) || root_page() != pgno)
+        return tl::unexpected(ErrorCode::ReadConflict);
+
+    while (true) {
+        bool is_leaf = frame->is_leaf();
+        if (!frame->validate(version))
+            return tl::unexpected(ErrorCode::ReadConflict);
+        if (is_leaf)
+            return frame;
 
-    frame = leaf.value();
+        tl::expected<page_id_t, ErrorCode> child_pgno =
+            tl::unexpected(ErrorCode::ReadConflict);
+        try {
+            InternalIndexNode node(frame, comp_);
+            if (key && fence)
+                child_pgno = node.get_child(*key, *fence);
+            else if (key)
+                child_pgno = node.get_child(*key);
+            else if (last)
+                child_pgno = node.last_user_cursor().record.child();
+            else
+                child_pgno = node.first_user_cursor().record.child();
+        } catch (...) {
+            return tl::unexpected(ErrorCode::ReadConflict);
+        }
+        // NOTE: never follow a child page number read from a torn page.
+        if (!frame->validate(version))
+            return tl::unexpected(ErrorCode::ReadConflict);
+        if (!child_pgno)
+            return tl::unexpected(child_pgno.error());
+        protect_upper_frame(frame);
+
+        pgno = child_pgno.value();
+        auto child = pool_->get_child_frame(frame, pgno);
+        if (!child)
+            return tl::unexpected(child.error());
+        uint64_t child_version = child.value()->read_version();
+        if (!child.value()->holds(file_, pgno) || !frame->validate(version))
+            return tl::unexpected(ErrorCode::ReadConflict);
 
-    tl::expected<LeafIndexNode::NodeCursor, ErrorCode> result;
-    try {
-        LeafIndexNode node(frame, comp_);
-        result = node.insert_record(key, value);
-
-        assert(node.number_of_records() <= config::max_number_of_records());
-    } catch (cereal::Exception &exception) {
-        // page write overflow
-        // Log::GlobalLog() << "[Index] page overflow: " << exception.what()
-        // << std::endl;
-        auto new_frame = move_frame(frame);
-        if (!new_frame)
-            return new_frame.error();
-
-        LeafIndexNode new_node(new_frame.value(), comp_);
-        LeafIndexNode node(frame, comp_);
+        frame = child.value();
+        version = child_version;
+    }
+}
 
-        // Log::GlobalLog() << std::format("moved page from {} to {}\n",
-        //                                 frame->pgno(),
-        // new_frame.value()->pgno());
-        pool_->remove_frame(frame);
-        frame = new_frame.value();
+tl::expected<Frame *, ErrorCode>
+Index::latch_leaf(const Key &key, WriteScope &scope,
+                  std::optional<std::string> *fence) {
+    while (true) {
+        uint64_t version;
+        auto leaf = search_leaf(key, version, fence);
+        if (!leaf || scope.upgrade(leaf.value(), version))
+            return leaf;
+    }
+}
 
-        result = new_node.insert_record(key, value);
+void Index::protect_upper_frame(Frame *frame) {
+    if (frame->is_protected() ||
+        frame->level() + config::PINNED_INDEX_LEVELS < depth())
+        return;
 
-        assert(new_node.number_of_records() <= config::max_number_of_records());
-    } catch (...) {
-        return ErrorCode::UnknownException;
+    // NOTE: ignore PoolProtectedFull, the budget is a soft limit.
+    pool_->protect_frame(frame);
+}
+
+ErrorCode Index::insert_record(const Key &key, const Column &value) {
+    // FIXME: column type check
+    if (!meta_.record_meta.match_key(key))
+        return ErrorCode::InvalidKeyType;
+    // a record larger than a page fails without touching the index.
+    size_t len = RecordView::encoded_len(key, value) + Frame::SLOT_LEN;
+    if (len > Page::payload_len())
+        return ErrorCode::NodeFull;
+    std::scoped_lock lock(write_latch_);
+    ReadGuard guard(pool_.get());
+    WriteScope scope(pool_.get());
+    auto leaf = latch_leaf(key, scope);
+    if (!leaf)
+        return leaf.error();
+
+    Frame *frame = leaf.value();
+    NormalizedKey normalized(key);
+    if (frame->is_full(normalized.bytes(), len)) {
+        balance_for_insert(frame);
+
+        leaf = search_leaf(key);
+        if (!leaf)
+            return leaf.error();
+
+        frame = leaf.value();
     }
 
+    // NOTE: a split may leave no room for a record of a long key, the page
+    // is never written past its end.
+    if (!frame->has_room(normalized.bytes(), len))
+        return ErrorCode::NodeFull;
+
+    LeafIndexNode node(frame, comp_);
+    auto result = node.insert_record(key, value);
     if (!result) {
         // Log::GlobalLog() << "failed to insert record " << key << ": " <<
         // value
@@ -150,137 +436,134 @@ ErrorCode Index::insert_record(const Key &key, const Column &value) {
     return ErrorCode::Success;
 }
 
-// move the page's record into a new page to make the page compact.
-tl::expected<Frame *, ErrorCode> Index::move_frame(Frame *frame) {
-    auto result =
-        allocate_frame(frame->index(), frame->level(), frame->is_leaf());
-    if (!result)
-        return tl::unexpected(result.error());
-
-    Frame *new_frame = result.value();
-    // copy header
-    new_frame->page()->hdr.prev_page = frame->page()->hdr.prev_page;
-    new_frame->page()->hdr.next_page = frame->page()->hdr.next_page;
-    new_frame->page()->hdr.parent_page = frame->page()->hdr.parent_page;
-    new_frame->page()->hdr.parent_record_off =
-        frame->page()->hdr.parent_record_off;
-
-    // copy payload
-    if (frame->is_leaf()) {
-        LeafIndexNode node(frame, comp_);
-        LeafIndexNode new_node(new_frame, comp_);
-        node.node_move(new_node, pool_.get());
-    } else {
-        InternalIndexNode node(frame, comp_);
-        InternalIndexNode new_node(new_frame, comp_);
-        node.node_move(new_node, pool_.get());
-    }
-    // update parent record
-    auto cursor = frame->parent_record();
-    if (!cursor)
-        return tl::unexpected(cursor.error());
-
-    cursor.value().record.value = new_frame->pgno();
-    auto parent_frame = pool_->get_frame(cursor.value().page);
-    if (!parent_frame)
-        return tl::unexpected(parent_frame.error());
-
-    parent_frame.value()->dump_at(cursor.value().offset -
-                                      cursor.value().record.len(),
-                                  cursor.value().record);
-    // InternalIndexNode parent_node(parent_frame.value(), comp_);
-
-    // update page list
-    auto prev_page = pool_->get_frame(frame->page()->hdr.prev_page);
-    auto next_page = pool_->get_frame(frame->page()->hdr.next_page);
-
-    if (prev_page && prev_page.value()) {
-        prev_page.value()->page()->hdr.next_page = new_frame->pgno();
-        prev_page.value()->mark_dirty();
-    }
-    if (next_page && next_page.value()) {
-        next_page.value()->page()->hdr.prev_page = new_frame->pgno();
-        next_page.value()->mark_dirty();
+std::vector<ErrorCode>
+Index::insert_batch(std::span<const std::pair<Key, Column>> rows) {
+    std::vector<ErrorCode> results(rows.size(), ErrorCode::Success);
+    std::vector<NormalizedKey> normalized;
+    // the rows of @normalized, and their positions in key order.
+    std::vector<size_t> positions;
+    std::vector<size_t> sorted;
+    for (size_t i = 0; i < rows.size(); i++) {
+        // FIXME: column type check
+        if (!meta_.record_meta.match_key(rows[i].first)) {
+            results[i] = ErrorCode::InvalidKeyType;
+            continue;
+        }
+        if (RecordView::encoded_len(rows[i].first, rows[i].second) +
+                Frame::SLOT_LEN >
+            Page::payload_len()) {
+            results[i] = ErrorCode::NodeFull;
+            continue;
+        }
+        sorted.push_back(normalized.size());
+        normalized.emplace_back(rows[i].first);
+        positions.push_back(i);
     }
+    // NOTE: stable, the first row of a key in @rows is the one inserted.
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [&normalized](size_t lhs, size_t rhs) {
+                         return NormalizedKey::compare(
+                                    normalized[lhs].bytes(),
+                                    normalized[rhs].bytes()) < 0;
+                     });
+
+    std::scoped_lock lock(write_latch_);
+    ReadGuard guard(pool_.get());
+    // whether the leaf of the next row has just been split for it, which is
+    // then inserted without checking for a split again, as insert_record()
+    // does.
+    bool split = false;
+    size_t next = 0;
+    while (next < sorted.size()) {
+        WriteScope scope(pool_.get());
+        // the keys of the leaf are less than @fence.
+        std::optional<std::string> fence;
+        auto leaf = latch_leaf(rows[positions[sorted[next]]].first, scope,
+                               &fence);
+        if (!leaf) {
+            results[positions[sorted[next++]]] = leaf.error();
+            split = false;
+            continue;
+        }
 
-    return new_frame;
-}
-
-// move the page's record into a new page to make the page compact.
-tl::expected<Frame *, ErrorCode> Index::move_frame(Frame *frame,
-                                                   size_t number) {
-    auto result =
-        allocate_frame(frame->index(), frame->level(), frame->is_leaf());
-    if (!result)
-        return tl::unexpected(result.error());
-
-    Frame *new_frame = result.value();
-    // copy header
-    new_frame->page()->hdr.prev_page = frame->page()->hdr.prev_page;
-    new_frame->page()->hdr.next_page = frame->page()->hdr.next_page;
-    new_frame->page()->hdr.parent_page = frame->page()->hdr.parent_page;
-    new_frame->page()->hdr.parent_record_off =
-        frame->page()->hdr.parent_record_off;
-
-    // copy payload
-    if (frame->is_leaf()) {
+        Frame *frame = leaf.value();
         LeafIndexNode node(frame, comp_);
-        LeafIndexNode new_node(new_frame, comp_);
-        node.node_move(new_node, number, pool_.get());
-    } else {
-        InternalIndexNode node(frame, comp_);
-        InternalIndexNode new_node(new_frame, comp_);
-        node.node_move(new_node, number, pool_.get());
-    }
-    // update parent record
-    auto cursor = frame->parent_record();
-    if (!cursor)
-        return tl::unexpected(cursor.error());
-
-    cursor.value().record.value = new_frame->pgno();
-    auto parent_frame = pool_->get_frame(cursor.value().page);
-    if (!parent_frame)
-        return tl::unexpected(parent_frame.error());
-
-    parent_frame.value()->dump_at(cursor.value().offset -
-                                      cursor.value().record.len(),
-                                  cursor.value().record);
-    // InternalIndexNode parent_node(parent_frame.value(), comp_);
+        bool full = false;
+        for (; next < sorted.size(); next++) {
+            auto &key = normalized[sorted[next]];
+            if (fence && NormalizedKey::compare(key.bytes(), *fence) >= 0)
+                break;
+            size_t position = positions[sorted[next]];
+            if (next > 0 && NormalizedKey::compare(
+                                key.bytes(),
+                                normalized[sorted[next - 1]].bytes()) == 0) {
+                // the key of an earlier row, which fails again if that one
+                // has failed.
+                auto first = results[positions[sorted[next - 1]]];
+                results[position] = first == ErrorCode::Success
+                                        ? ErrorCode::KeyAlreadyExist
+                                        : first;
+                continue;
+            }
 
-    // update page list
-    auto prev_page = pool_->get_frame(frame->page()->hdr.prev_page);
-    auto next_page = pool_->get_frame(frame->page()->hdr.next_page);
-    if (prev_page && prev_page.value()) {
-        prev_page.value()->page()->hdr.next_page = new_frame->pgno();
-        prev_page.value()->mark_dirty();
-    }
-    if (next_page && next_page.value()) {
-        next_page.value()->page()->hdr.prev_page = new_frame->pgno();
-        next_page.value()->mark_dirty();
+            auto &[row_key, value] = rows[position];
+            size_t len = RecordView::encoded_len(row_key, value) +
+                         Frame::SLOT_LEN;
+            if (!split && frame->is_full(key.bytes(), len)) {
+                full = true;
+                break;
+            }
+            split = false;
+            if (!frame->has_room(key.bytes(), len)) {
+                results[position] = ErrorCode::NodeFull;
+                continue;
+            }
+            auto result = node.insert_record(row_key, value);
+            if (!result)
+                results[position] = result.error();
+        }
+        // the rest of the rows of the leaf go into its halves, each of which
+        // a descent of its own finds. a leaf that can't be split fails the
+        // row that has filled it, the next row descends again and checks
+        // for a split of its own.
+        if (full) {
+            auto ec = balance_for_insert(frame);
+            if (ec != ErrorCode::Success)
+                results[positions[sorted[next++]]] = ec;
+            split = ec == ErrorCode::Success;
+        }
     }
-
-    return new_frame;
+    return results;
 }
 
 ErrorCode Index::remove_record(const Key &key) {
-    auto leaf = search_leaf(key);
+    if (!meta_.record_meta.match_key(key))
+        return ErrorCode::InvalidKeyType;
+    std::scoped_lock lock(write_latch_);
+    ReadGuard guard(pool_.get());
+    WriteScope scope(pool_.get());
+    auto leaf = latch_leaf(key, scope);
     if (!leaf)
         return ErrorCode::KeyNotFound;
 
     auto frame = leaf.value();
 
-    auto error = balance_for_delete<LeafIndexNode>(frame);
-    if (error != ErrorCode::Success) {
-        Log::GlobalLog() << "failed to balance for delete, reason: " << error
-                         << std::endl;
-    }
+    // NOTE: balance_for_delete() only restructures half-full frames.
+    if (frame->is_half_full()) {
+        auto error = balance_for_delete<LeafIndexNode>(frame);
+        if (error != ErrorCode::Success) {
+            Log::GlobalLog() << "failed to balance for delete, reason: "
+                             << error << std::endl;
+        }
 
-    // FIXME: better solution to handle the result of search_leaf went invalid?
-    leaf = search_leaf(key);
-    if (!leaf)
-        return ErrorCode::KeyNotFound;
+        // FIXME: better solution to handle the result of search_leaf went
+        // invalid?
+        leaf = search_leaf(key);
+        if (!leaf)
+            return ErrorCode::KeyNotFound;
 
-    frame = leaf.value();
+        frame = leaf.value();
+    }
     LeafIndexNode node(frame, comp_);
 
     auto ec = node.remove_record(key);
@@ -299,6 +582,199 @@ ErrorCode Index::remove_record(const Key &key) {
     return ErrorCode::Success;
 }
 
+// the rows are buffered a leaf at a time, so that the leaf is written under
+// the key prefix of its first and last key. the record of a page goes into
+// its parent level as soon as the page is started, a parent level is started
+// once a level gets its second page.
+// NOTE: the internal pages are written record by record and keep no key
+// prefix, a key prefix set once they're done would move the records their
+// children point to.
+ErrorCode Index::bulk_load(const RowSource &source, size_t fill_factor) {
+    if (fill_factor == 0 || fill_factor > 100)
+        return ErrorCode::Failure;
+    std::scoped_lock lock(write_latch_);
+    ReadGuard guard(pool_.get());
+    auto root = get_root_frame();
+    if (!root)
+        return root.error();
+    if (!root.value()->is_leaf() || root.value()->number_of_records() != 0)
+        return ErrorCode::IndexNotEmpty;
+
+    BulkLoad load{.fill_bytes = Page::payload_len() * fill_factor / 100};
+    Key key;
+    Column value;
+    ErrorCode ec = ErrorCode::Success;
+    while (ec == ErrorCode::Success && source(key, value))
+        ec = bulk_add(load, std::move(key), std::move(value));
+
+    auto finished = bulk_finish(load);
+    return ec != ErrorCode::Success ? ec : finished;
+}
+
+ErrorCode Index::bulk_add(BulkLoad &load, Key key, Column value) {
+    if (!meta_.record_meta.match_key(key))
+        return ErrorCode::InvalidKeyType;
+    NormalizedKey normalized(key);
+    auto bytes = normalized.bytes();
+    if (load.leaf != 0 || !load.rows.empty()) {
+        int cmp = NormalizedKey::compare(load.last, bytes);
+        if (cmp == 0)
+            return ErrorCode::KeyAlreadyExist;
+        if (cmp > 0)
+            return ErrorCode::InvalidInsertPos;
+    }
+    load.last = bytes;
+
+    size_t len = RecordView::encoded_len(key, value) + Frame::SLOT_LEN;
+    if (!load.rows.empty()) {
+        // the key prefix of sorted keys is the one of the first and the last.
+        size_t prefix_len =
+            std::mismatch(load.first.begin(),
+                          load.first.begin() + load.prefix_len, bytes.begin(),
+                          bytes.end())
+                .first -
+            load.first.begin();
+        size_t n = load.rows.size() + 1;
+        if (load.row_bytes + len - (n - 1) * prefix_len <= load.fill_bytes) {
+            load.prefix_len = prefix_len;
+            load.rows.emplace_back(std::move(key), std::move(value));
+            load.row_bytes += len;
+            return ErrorCode::Success;
+        }
+
+        auto ec = bulk_flush_leaf(load);
+        if (ec != ErrorCode::Success)
+            return ec;
+    }
+
+    // a record alone in a page takes its whole key as the key prefix.
+    if (len > Page::payload_len())
+        return ErrorCode::NodeFull;
+    load.first = bytes;
+    load.prefix_len = bytes.size();
+    load.rows.emplace_back(std::move(key), std::move(value));
+    load.row_bytes = len;
+    return ErrorCode::Success;
+}
+
+ErrorCode Index::bulk_flush_leaf(BulkLoad &load) {
+    if (load.rows.empty())
+        return ErrorCode::Success;
+
+    // the first leaf is the empty root.
+    auto result = load.leaf == 0 ? get_root_frame()
+                                 : allocate_frame(meta_.id, 0, true);
+    if (!result)
+        return result.error();
+    Frame *frame = result.value();
+    page_id_t pgno = frame->pgno();
+
+    LeafIndexNode::repack(frame, load.first.substr(0, load.prefix_len));
+    LeafIndexNode node(frame, comp_);
+    for (auto &[key, value] : load.rows)
+        node.push_back(key, value);
+    frame->page()->hdr.prev_page = load.leaf;
+
+    Key first = std::move(load.rows.front().first);
+    Key last = std::move(load.rows.back().first);
+    load.rows.clear();
+    load.row_bytes = 0;
+    if (load.leaf != 0) {
+        auto prev = get_frame(load.leaf);
+        if (!prev)
+            return prev.error();
+        prev.value()->page()->hdr.next_page = pgno;
+        prev.value()->mark_dirty();
+
+        if (load.levels.empty()) {
+            auto ec = bulk_add_child(load, 1, load.leaf_first, load.leaf);
+            if (ec != ErrorCode::Success)
+                return ec;
+        }
+        // the parent only tells the leaves apart, keep its key short.
+        auto ec = bulk_add_child(
+            load, 1, NormalizedKey::separator(load.leaf_last, first), pgno);
+        if (ec != ErrorCode::Success)
+            return ec;
+    }
+    load.leaf = pgno;
+    load.leaf_first = std::move(first);
+    load.leaf_last = std::move(last);
+    return ErrorCode::Success;
+}
+
+ErrorCode Index::bulk_add_child(BulkLoad &load, size_t level, const Key &key,
+                                page_id_t child) {
+    NormalizedKey normalized(key);
+    size_t len = RecordView::encoded_len(key, child) + Frame::SLOT_LEN;
+    if (level > load.levels.size()) {
+        auto result = allocate_frame(meta_.id, level, false);
+        if (!result)
+            return result.error();
+        load.levels.push_back(result.value()->pgno());
+    } else {
+        auto result = get_frame(load.levels[level - 1]);
+        if (!result)
+            return result.error();
+        Frame *frame = result.value();
+        if (frame->number_of_records() > 0 &&
+            frame->live_bytes_with(normalized.bytes(), len) >
+                load.fill_bytes) {
+            page_id_t full = frame->pgno();
+            Key full_key = InternalIndexNode(frame, comp_).get_key();
+            auto allocated = allocate_frame(meta_.id, level, false);
+            if (!allocated)
+                return allocated.error();
+            page_id_t pgno = allocated.value()->pgno();
+            allocated.value()->page()->hdr.prev_page = full;
+            load.levels[level - 1] = pgno;
+
+            result = get_frame(full);
+            if (!result)
+                return result.error();
+            result.value()->page()->hdr.next_page = pgno;
+            result.value()->mark_dirty();
+
+            if (level == load.levels.size()) {
+                auto ec = bulk_add_child(load, level + 1, full_key, full);
+                if (ec != ErrorCode::Success)
+                    return ec;
+            }
+            auto ec = bulk_add_child(load, level + 1, key, pgno);
+            if (ec != ErrorCode::Success)
+                return ec;
+        }
+    }
+
+    auto result = get_frame(load.levels[level - 1]);
+    if (!result)
+        return result.error();
+    Frame *frame = result.value();
+    if (!frame->has_room(normalized.bytes(), len))
+        return ErrorCode::NodeFull;
+    InternalIndexNode node(frame, comp_);
+    node.push_back(key, child);
+
+    auto child_frame = get_frame(child);
+    if (!child_frame)
+        return child_frame.error();
+    child_frame.value()->set_parent(load.levels[level - 1]);
+    return ErrorCode::Success;
+}
+
+ErrorCode Index::bulk_finish(BulkLoad &load) {
+    auto ec = bulk_flush_leaf(load);
+    page_id_t root = load.levels.empty() ? load.leaf : load.levels.back();
+    if (root == 0)
+        return ec;
+
+    auto result = get_frame(root);
+    if (!result)
+        return result.error();
+    set_root(result.value(), load.levels.size() + 1);
+    return ec;
+}
+
 tl::expected<Frame *, ErrorCode> Index::new_nonleaf_root(Frame *child) {
     // auto result = allocate_frame(meta_.id, meta_.depth, false);
     // if (!result)
@@ -329,7 +805,7 @@ tl::expected<Frame *, ErrorCode> Index::new_nonleaf_root(Frame *child) {
 
 template <typename N>
 ErrorCode Index::balance_for_delete(Frame *frame) {
-    if (frame->is_half_full() && frame->pgno() != meta_.root_page) {
+    if (frame->is_half_full() && frame->pgno() != root_page()) {
         Log::GlobalLog() << "[Index] balance for delete" << std::endl;
         // case 1: ok to union the frame and one of its neighbor
         bool u = sibling_union_check(frame);
@@ -348,26 +824,21 @@ ErrorCode Index::balance_for_delete(Frame *frame) {
 
             if (prev_result) {
                 left_frame = prev_result.value();
-                if (left_frame->number_of_records() >
-                    config::min_number_of_records()) {
+                N left_node(left_frame, comp_);
+                if (!left_frame->is_half_full() &&
+                    node.can_push_front(left_node.last_user_cursor().record)) {
                     // borrow fromt the left sibling frame.
-                    N left_node(left_frame, comp_);
                     node.print();
                     auto borrowed = left_node.pop_back();
                     if (!borrowed)
                         return borrowed.error();
-                    auto &to_move = borrowed.value();
-                    auto inserted = node.push_front(to_move.key, to_move.value);
+                    auto inserted = node.push_front(borrowed.value().record);
                     // FIXME: if the node is internal, update its child's parent
                     // record
                     if (!frame->is_leaf()) {
                         // FIXME: make type safe
                         auto &tmp = reinterpret_cast<InternalIndexNode &>(node);
-                        tmp.update_record_parent(
-                            tmp,
-                            reinterpret_cast<InternalClusteredRecord &>(
-                                inserted.record),
-                            inserted.offset, pool_.get());
+                        tmp.update_record_parent(tmp, inserted, pool_.get());
                     }
                     node.print();
 
@@ -379,29 +850,23 @@ ErrorCode Index::balance_for_delete(Frame *frame) {
                 }
             } else if (next_result) {
                 right_frame = next_result.value();
-                if (right_frame->number_of_records() >
-                    // borrow from right sibling frame.
-                    config::min_number_of_records()) {
-
-                    N right_node(right_frame, comp_);
+                N right_node(right_frame, comp_);
+                // borrow from right sibling frame.
+                if (!right_frame->is_half_full() &&
+                    node.can_push_back(right_node.first_user_cursor().record) &&
+                    right_node.can_pop_front()) {
                     node.print();
                     auto borrowed = right_node.pop_front();
 
                     if (!borrowed)
                         return borrowed.error();
-                    auto inserted =
-                        node.push_back(borrowed.value().record.key,
-                                       borrowed.value().record.value);
+                    auto inserted = node.push_back(borrowed.value().record);
                     // FIXME: if the node is internal, update its child's parent
                     // record
                     if (!frame->is_leaf()) {
                         // FIXME: make type safe
                         auto &tmp = reinterpret_cast<InternalIndexNode &>(node);
-                        tmp.update_record_parent(
-                            tmp,
-                            reinterpret_cast<InternalClusteredRecord &>(
-                                inserted.record),
-                            inserted.offset, pool_.get());
+                        tmp.update_record_parent(tmp, inserted, pool_.get());
                     }
 
                     node.print();
@@ -411,7 +876,7 @@ ErrorCode Index::balance_for_delete(Frame *frame) {
                 return ErrorCode::Failure;
             }
         }
-    } else if (frame->pgno() == meta_.root_page &&
+    } else if (frame->pgno() == root_page() &&
                frame->number_of_records() == 2) {
         return ErrorCode::RootHeightDecrease;
     }
@@ -430,13 +895,10 @@ bool Index::sibling_union_check(Frame *frame) {
     LeafIndexNode node(frame, comp_);
 
     if (prev_result && prev_result.value() != nullptr &&
-        prev_result.value()->number_of_records() + frame->number_of_records() <=
-            config::max_number_of_records()) {
+        fits_union(prev_result.value(), frame)) {
         union_frame(prev_result.value(), frame);
     } else if (next_result && next_result.value() != nullptr &&
-               next_result.value()->number_of_records() +
-                       frame->number_of_records() <=
-                   config::max_number_of_records()) {
+               fits_union(frame, next_result.value())) {
         union_frame(frame, next_result.value());
     } else {
         return false;
@@ -445,6 +907,61 @@ bool Index::sibling_union_check(Frame *frame) {
     return true;
 }
 
+// whether the records of @left_frame and @right_frame fit in one page within
+// its capacity, under the common prefix of their key prefixes, which the key
+// prefix of the union starts with.
+bool Index::fits_union(Frame *left_frame, Frame *right_frame) {
+    size_t prefix_len =
+        left_frame->shared_prefix_len(right_frame->key_prefix());
+    return left_frame->live_bytes(prefix_len) +
+               right_frame->live_bytes(prefix_len) - prefix_len <=
+           Frame::capacity();
+}
+
+int Index::split_count(Frame *frame) {
+    if (frame->is_leaf())
+        return LeafIndexNode(frame, comp_).split_count();
+    return InternalIndexNode(frame, comp_).split_count();
+}
+
+std::pair<Key, Key> Index::split_keys(Frame *frame, int n2) {
+    int n = frame->number_of_records();
+    if (frame->is_leaf()) {
+        LeafIndexNode left(frame, comp_);
+        // the parent only tells the leaves apart, keep its key short.
+        return {left.get_key(),
+                NormalizedKey::separator(
+                    left.cursor_at_slot(n - n2 - 1).record.key().key(),
+                    left.cursor_at_slot(n - n2).record.key().key())};
+    }
+    InternalIndexNode left(frame, comp_);
+    return {left.get_key(), left.cursor_at_slot(n - n2).record.key().key()};
+}
+
+bool Index::parent_fits_split(Frame *frame, Frame *parent_frame) {
+    if (frame->number_of_records() < 2)
+        return true;
+    auto [old_key, new_key] = split_keys(frame, split_count(frame));
+    return fits_split(parent_frame, old_key, new_key);
+}
+
+// whether @parent_frame has room for the keys of a split of one of its
+// children, the key of the child @old_key and the key of the new child
+// @new_key, as new records under the common prefix of its key prefix and
+// theirs.
+bool Index::fits_split(Frame *parent_frame, const Key &old_key,
+                       const Key &new_key) {
+    NormalizedKey old_normalized(old_key), new_normalized(new_key);
+    size_t prefix_len =
+        std::min(parent_frame->shared_prefix_len(old_normalized.bytes()),
+                 parent_frame->shared_prefix_len(new_normalized.bytes()));
+    size_t len = 0;
+    for (auto *key : {&old_key, &new_key})
+        len += RecordView::encoded_len(*key, page_id_t(0)) - prefix_len +
+               Frame::SLOT_LEN;
+    return parent_frame->live_bytes(prefix_len) + len <= Page::payload_len();
+}
+
 void Index::union_frame(Frame *left_frame, Frame *right_frame) {
 #ifdef DEBUG
     Log::GlobalLog() << "choose to union" << std::endl;
@@ -457,56 +974,37 @@ void Index::union_frame(Frame *left_frame, Frame *right_frame) {
         return;
     } else if (!right_parent_cursor)
         return;
-    auto result = pool_->get_frame(right_parent_cursor.value().page);
+    auto result = get_frame(right_parent_cursor.value().page);
     if (!result)
         return;
     right_parent = result.value();
 
-    size_t left_size_before;
-try_union:
-    try {
-        if (left_frame->is_leaf()) {
-            LeafIndexNode left_node(left_frame, comp_);
-            LeafIndexNode right_node(right_frame, comp_);
-            left_size_before = left_node.number_of_records();
-
-            left_node.print();
-            right_node.print();
-            left_node.node_union(right_node, pool_.get());
-            left_node.print();
-        } else {
-            InternalIndexNode left_node(left_frame, comp_);
-            InternalIndexNode right_node(right_frame, comp_);
-            left_size_before = left_node.number_of_records();
-
-            left_node.print();
-            right_node.print();
-            left_node.node_union(right_node, pool_.get());
-            left_node.print();
-        }
-    } catch (cereal::Exception &exception) {
-        // page write overflow
-        Log::GlobalLog() << "[Index] page overflow: " << exception.what()
-                         << std::endl;
-        auto new_frame = move_frame(left_frame, left_size_before);
-        if (!new_frame)
-            throw;
+    // NOTE: fits_union() made sure the records fit in @left_frame.
+    if (left_frame->is_leaf()) {
+        LeafIndexNode left_node(left_frame, comp_);
+        LeafIndexNode right_node(right_frame, comp_);
 
-        LeafIndexNode new_node(new_frame.value(), comp_);
-        // LeafIndexNode node(frame, comp_);
-
-        // Log::GlobalLog() << std::format("moved page from {} to {}\n",
-        //                                 frame->pgno(),
-        // new_frame.value()->pgno());
-        pool_->remove_frame(left_frame);
-        left_frame = new_frame.value();
+        left_node.print();
+        right_node.print();
+        left_node.node_union(right_node, pool_.get());
+        left_node.print();
+    } else {
+        InternalIndexNode left_node(left_frame, comp_);
+        InternalIndexNode right_node(right_frame, comp_);
 
-        assert(new_node.number_of_records() <= config::max_number_of_records());
-        goto try_union;
+        left_node.print();
+        right_node.print();
+        left_node.node_union(right_node, pool_.get());
+        left_node.print();
     }
 
+    auto ec = balance_for_delete<InternalIndexNode>(right_parent);
+
+    // NOTE: unlink @right_frame only after its parent is balanced, a union of
+    // the parent links its first child, which may be @right_frame, to the
+    // last child of its left sibling.
     left_frame->page()->hdr.next_page = right_frame->page()->hdr.next_page;
-    auto after_right = pool_->get_frame(right_frame->page()->hdr.next_page);
+    auto after_right = get_frame(right_frame->page()->hdr.next_page);
     if (after_right && after_right.value()) {
         auto after_right_frame = after_right.value();
         after_right_frame->page()->hdr.prev_page = left_frame->pgno();
@@ -514,11 +1012,11 @@ try_union:
     }
     // pool_->remove_frame(right_frame);
 
-    auto ec = balance_for_delete<InternalIndexNode>(right_parent);
     // btree reduce height
     if (ec == ErrorCode::RootHeightDecrease) {
         pool_->remove_frame(right_parent);
-        meta_.root_page = left_frame->pgno();
+        left_frame->set_parent(0);
+        set_root(left_frame, meta_.depth - 1);
         return;
     } else if (ec != ErrorCode::Success)
         return;
@@ -526,23 +1024,21 @@ try_union:
     right_parent_cursor = right_frame->parent_record();
     if (!right_parent_cursor)
         return;
-    result = pool_->get_frame(right_parent_cursor.value().page);
+    result = get_frame(right_parent_cursor.value().page);
     if (!result)
         return;
     right_parent = result.value();
 
     InternalIndexNode right_parent_node(right_parent, comp_);
     right_parent_node.print();
-    IndexNode<InternalIndexNode, InternalClusteredRecord>::NodeCursor cursor{
-        right_parent_cursor.value().offset, right_parent_cursor.value().record};
+    auto cursor =
+        right_parent_node.cursor_at(right_parent_cursor.value().offset);
     right_parent_node.remove_record(cursor);
     pool_->remove_frame(right_frame);
     right_parent_node.print();
 }
 
 ErrorCode Index::balance_for_insert(Frame *frame) {
-    if (!frame->is_full())
-        return ErrorCode::Success;
 
     // Log::GlobalLog() << "[Index] balance for insert " << std::endl;
     auto result = frame->parent_frame();
@@ -550,7 +1046,8 @@ ErrorCode Index::balance_for_insert(Frame *frame) {
         return result.error();
 
     Frame *parent_frame = result.value();
-    if (parent_frame != nullptr && parent_frame->is_full()) {
+    if (parent_frame != nullptr && (parent_frame->is_full() ||
+                                    !parent_fits_split(frame, parent_frame))) {
         // recursively rebalance a internal index page.
         balance_for_insert_internal(parent_frame);
     } else if (parent_frame == nullptr) {
@@ -566,11 +1063,9 @@ ErrorCode Index::balance_for_insert(Frame *frame) {
         if (!cursor)
             return cursor.error();
 
-        frame->set_parent(parent_frame->pgno(),
-                          cursor.value().offset - cursor.value().record.len());
+        frame->set_parent(parent_frame->pgno());
 
-        meta_.root_page = parent_frame->pgno();
-        meta_.depth++;
+        set_root(parent_frame, meta_.depth + 1);
 
         // Log::GlobalLog() << std::format("[Index] new root page {}\n",
         // parent_frame->pgno());
@@ -581,23 +1076,21 @@ ErrorCode Index::balance_for_insert(Frame *frame) {
         return result.error();
 
     parent_frame = result.value();
-    safe_node_split(frame, parent_frame);
-
-    return ErrorCode::Success;
+    return safe_node_split(frame, parent_frame);
 }
 
 // recursively rebalance a internal index page.
+// NOTE: the caller splits @frame if it's full or has no room for the keys of
+// a split of its child.
 ErrorCode Index::balance_for_insert_internal(Frame *frame) {
-    if (!frame->is_full())
-        return ErrorCode::Success;
-
     // Log::GlobalLog() << "[Index] balance for insert " << std::endl;
     auto result = frame->parent_frame();
     if (!result)
         return result.error();
 
     Frame *parent_frame = result.value();
-    if (parent_frame != nullptr && parent_frame->is_full()) {
+    if (parent_frame != nullptr && (parent_frame->is_full() ||
+                                    !parent_fits_split(frame, parent_frame))) {
         // recursively rebalance a internal index page.
         balance_for_insert_internal(parent_frame);
     } else if (parent_frame == nullptr) {
@@ -613,11 +1106,9 @@ ErrorCode Index::balance_for_insert_internal(Frame *frame) {
         if (!cursor)
             return cursor.error();
 
-        frame->set_parent(parent_frame->pgno(),
-                          cursor.value().offset - cursor.value().record.len());
+        frame->set_parent(parent_frame->pgno());
 
-        meta_.root_page = parent_frame->pgno();
-        meta_.depth++;
+        set_root(parent_frame, meta_.depth + 1);
 
         // Log::GlobalLog() << std::format("[Index] new root page {}\n",
         //                                 parent_frame->pgno());
@@ -628,16 +1119,27 @@ ErrorCode Index::balance_for_insert_internal(Frame *frame) {
         return result.error();
 
     parent_frame = result.value();
-    safe_node_split(frame, parent_frame);
-
-    return ErrorCode::Success;
+    return safe_node_split(frame, parent_frame);
 }
 
 // the parent frame of @frame is ensured to have enough space to make child
 // split.
+// NOTE: the keys of the split are taken before anything moves, a parent
+// without room for them fails it with NodeFull and @frame untouched.
 ErrorCode Index::safe_node_split(Frame *frame, Frame *parent_frame) {
-    int n1 = std::ceil(config::max_number_of_records() / 2);
-    int n2 = std::floor(config::max_number_of_records() / 2);
+    if (frame->number_of_records() < 2)
+        return ErrorCode::NodeNotFull;
+
+    int n2 = split_count(frame);
+    auto [old_key, new_key] = split_keys(frame, n2);
+    if (!fits_split(parent_frame, old_key, new_key))
+        return ErrorCode::NodeFull;
+    // the parent record is found before anything changes, a failure leaves
+    // the page as it was.
+    auto parent_cursor = frame->parent_record();
+    if (!parent_cursor)
+        return parent_cursor.error();
+
     //  new frame allocation
     auto result =
         allocate_frame(frame->index(), frame->level(), frame->is_leaf());
@@ -648,7 +1150,7 @@ ErrorCode Index::safe_node_split(Frame *frame, Frame *parent_frame) {
     // update same-level node list
     new_frame->page()->hdr.next_page = frame->page()->hdr.next_page;
     new_frame->page()->hdr.prev_page = frame->pgno();
-    auto after_new_frame = pool_->get_frame(frame->page()->hdr.next_page);
+    auto after_new_frame = get_frame(frame->page()->hdr.next_page);
     if (after_new_frame && after_new_frame.value()) {
         after_new_frame.value()->page()->hdr.prev_page = new_frame->pgno();
         after_new_frame.value()->mark_dirty();
@@ -656,51 +1158,34 @@ ErrorCode Index::safe_node_split(Frame *frame, Frame *parent_frame) {
     frame->page()->hdr.next_page = new_frame->pgno();
 
     // memcpy from frame[record:n1, n1 + n2) to new_frame
-    Key new_key, old_key;
     if (frame->is_leaf()) {
         LeafIndexNode left(frame, comp_);
         LeafIndexNode right(new_frame, comp_);
-
-        auto ec = left.node_split(right, n1, n2, pool_.get());
-        if (ec != ErrorCode::Success)
-            return ec;
-        old_key = left.get_key();
-        new_key = right.get_key();
-
+        left.node_split(right, n2, pool_.get());
     } else {
         InternalIndexNode left(frame, comp_);
         InternalIndexNode right(new_frame, comp_);
-
-        auto ec = left.node_split(right, n1, n2, pool_.get());
-        if (ec != ErrorCode::Success)
-            return ec;
-        old_key = left.get_key();
-        new_key = right.get_key();
+        left.node_split(right, n2, pool_.get());
     }
 
-    // update the parent cursor.
-    // NOTE: parent cursor's offset is the end of the parent record, while
-    // page.hdr.parent_record_off is the start of the parent record.
-    auto parent_cursor = frame->parent_record();
-    if (!parent_cursor)
-        return parent_cursor.error();
-
-    parent_cursor.value().record.key = old_key;
-    InternalIndexNode parent_node(parent_frame, comp_);
-    IndexNode<InternalIndexNode, InternalClusteredRecord>::NodeCursor cursor{
-        parent_cursor.value().offset, parent_cursor.value().record};
-
     // maintain the first user record's split.
-    // FIXME: better solution?
-    parent_frame->dump_at(parent_cursor.value().offset -
-                              parent_cursor.value().record.len(),
-                          parent_cursor.value().record);
+    // NOTE: fits_split() has made sure the parent takes both keys, neither
+    // the key set nor the record inserted fails past this point.
+    auto offset = InternalIndexNode::set_record_key(
+        parent_frame, parent_cursor.value().offset, old_key);
+    assert(offset.has_value());
+    if (!offset)
+        return offset.error();
 
     // insert the new frame into the parent.
-    auto inserted =
-        parent_node.insert_record_after(cursor, new_key, new_frame->pgno());
-    new_frame->set_parent(parent_frame->pgno(),
-                          inserted.offset - inserted.record.len());
+    InternalIndexNode parent_node(parent_frame, comp_);
+    auto cursor = parent_node.cursor_at(offset.value());
+    assert(parent_frame->has_room(
+        NormalizedKey(new_key).bytes(),
+        RecordView::encoded_len(new_key, new_frame->pgno()) +
+            Frame::SLOT_LEN));
+    parent_node.insert_record_after(cursor, new_key, new_frame->pgno());
+    new_frame->set_parent(parent_frame->pgno());
 
     return ErrorCode::Success;
 }
@@ -712,23 +1197,19 @@ Index::allocate_frame(index_id_t index, uint8_t level, bool is_leaf) {
     //                         level)
     //                  << std::endl;
 
-    return pool_->allocate_frame()
+    return pool_->allocate_frame(file_)
         .and_then([&](Frame *frame) -> tl::expected<Frame *, ErrorCode> {
             auto page = frame->page();
             page->hdr.index = index;
             page->hdr.level = level;
             page->hdr.number_of_records = 0;
             page->hdr.last_inserted = 0;
+            page->hdr.deleted_bytes = 0;
+            page->hdr.key_prefix_len = 0;
             page->hdr.is_leaf = is_leaf;
             page->hdr.parent_page = 0;
             memset(page->payload, 0, page->payload_len());
 
-            // placeholder record.
-            if (frame->is_leaf()) {
-                frame->init_list<LeafClusteredRecord>();
-            } else {
-                frame->init_list<InternalClusteredRecord>();
-            }
             frame->mark_dirty();
             return frame;
         })
@@ -739,6 +1220,7 @@ Index::allocate_frame(index_id_t index, uint8_t level, bool is_leaf) {
 
 // FIXME:
 void Index::traverse(const RecordTraverseFunc &func) {
+    ReadGuard guard(pool_.get());
     auto result = get_root_frame();
     if (!result)
         return;
@@ -752,25 +1234,49 @@ void Index::traverse(const RecordTraverseFunc &func) {
     }
 }
 
-// FIXME: current impl only reverse traversion inside a node, not the whole
-// tree.
+PageUsage Index::page_usage() {
+    PageUsage usage;
+    ReadGuard guard(pool_.get());
+    auto result = get_root_frame();
+    if (result)
+        page_usage(result.value(), usage);
+    return usage;
+}
+
+void Index::page_usage(Frame *frame, PageUsage &usage) {
+    usage.pages++;
+    size_t used_bytes = frame->key_prefix().size();
+    // NOTE: the frame may be replaced while its children are visited.
+    std::vector<page_id_t> children;
+    for (int i = 0; i < frame->number_of_records(); i++) {
+        auto record = frame->record_at(frame->slot(i));
+        used_bytes += record.length() + Frame::SLOT_LEN;
+        if (!frame->is_leaf())
+            children.push_back(record.child());
+    }
+    assert(used_bytes == frame->live_bytes());
+    usage.used_bytes += used_bytes;
+    usage.deleted_bytes += frame->deleted_bytes();
+    if (!frame->is_leaf())
+        usage.internal_bytes += used_bytes;
+    for (auto child : children) {
+        auto result = get_frame(child);
+        if (result)
+            page_usage(result.value(), usage);
+    }
+}
+
+// the records in descending key order, along the prev_page links of the
+// leaves, see IndexIterator.
 void Index::traverse_r(const RecordTraverseFunc &func) {
-    // auto result = get_root_frame();
-    // if (!result)
-    //     return;
-    // auto frame = result.value();
-    // while (!frame->is_leaf()) {
-    //     InternalIndexNode node(frame, comp_);
-    //     auto first_record = node.first_user_cursor();
-    //
-    //     auto child = pool_->get_frame(first_record.record.value);
-    //     if (!child)
-    //         return;
-    //     frame = child.value();
-    // }
-    //
-    // LeafIndexNode node(frame, comp_);
-    // node.traverse_r(func);
+    IndexIterator it(*this, {.reverse = true});
+    LeafClusteredRecord record;
+    while (true) {
+        auto more = it.next(record);
+        if (!more || !more.value())
+            return;
+        func(record);
+    }
 }
 } // namespace storage
   //
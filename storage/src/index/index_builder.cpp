@@ -0,0 +1,291 @@
+#include "index/index_builder.h"
+#include "index/normalized_key.h"
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <queue>
+#include <thread>
+#include <utility>
+
+namespace storage {
+
+namespace {
+
+uint64_t elapsed_ns(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+// the normalized key of a record of a run, which has the whole key.
+std::string_view key_of(const RecordView &record) {
+    return record.key().suffix();
+}
+
+} // namespace
+
+void IndexBuildStats::export_text(std::ostream &os) const {
+    const std::vector<std::pair<std::string, uint64_t>> metrics = {
+        {"rows", rows},         {"duplicates", duplicates},
+        {"runs", runs},         {"spilled_runs", spilled_runs},
+        {"run_ns", run_ns},     {"sort_ns", sort_ns},
+        {"spill_ns", spill_ns}, {"merge_ns", merge_ns},
+    };
+    for (auto &[name, value] : metrics) {
+        auto metric = std::format("minidb_index_build_{}", name);
+        os << "# TYPE " << metric << " gauge\n";
+        os << metric << " " << value << "\n";
+    }
+}
+
+IndexBuilder::~IndexBuilder() {
+    for (auto &run : runs_) {
+        std::error_code ec;
+        if (!run->path.empty())
+            std::filesystem::remove(run->path, ec);
+    }
+}
+
+ErrorCode IndexBuilder::build(const Index::RowSource &source) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < threads_; i++)
+        threads.emplace_back(&IndexBuilder::sort_runs, this);
+    auto ec = make_runs(source);
+    {
+        std::scoped_lock lock(latch_);
+        input_done_ = true;
+    }
+    cond_.notify_all();
+    for (auto &thread : threads)
+        thread.join();
+    stats_.runs = runs_.size();
+    stats_.run_ns = elapsed_ns(start);
+    if (ec == ErrorCode::Success)
+        ec = error_;
+    if (ec != ErrorCode::Success)
+        return ec;
+
+    start = std::chrono::steady_clock::now();
+    ec = merge();
+    stats_.merge_ns = elapsed_ns(start);
+    Log::GlobalLog() << std::format(
+                            "[IndexBuilder]: built index {} of {} rows from "
+                            "{} runs, {} spilled, in {} + {} ms",
+                            int(index_.id()), stats_.rows, stats_.runs,
+                            stats_.spilled_runs, stats_.run_ns / 1000000,
+                            stats_.merge_ns / 1000000)
+                     << std::endl;
+    return ec;
+}
+
+// half of the budget is for the runs on the way: the one read, one queued
+// and one sorted per thread. the other half is for the sorted runs kept.
+ErrorCode IndexBuilder::make_runs(const Index::RowSource &source) {
+    size_t run_bytes = std::max<size_t>(memory_ / 2 / (2 * threads_ + 1),
+                                        Page::payload_len());
+    std::unique_ptr<Run> run;
+    auto hand_over = [&] {
+        std::unique_lock lock(latch_);
+        cond_.wait(lock, [&] {
+            return unsorted_.size() < threads_ || error_ != ErrorCode::Success;
+        });
+        run->number = runs_.size();
+        unsorted_.push_back(run.get());
+        runs_.push_back(std::move(run));
+        cond_.notify_all();
+        return error_;
+    };
+
+    Key key;
+    Column value;
+    while (source(key, value)) {
+        if (!index_.record_meta().match_key(key))
+            return ErrorCode::InvalidKeyType;
+        // NOTE: a record larger than a page fits in no leaf of the index,
+        // and its length would wrap the uint16_t length of a run record.
+        size_t len = RecordView::encoded_len(key, value);
+        if (len > Page::payload_len())
+            return ErrorCode::NodeFull;
+
+        if (!run)
+            run = std::make_unique<Run>();
+        size_t offset = run->records.size();
+        run->records.resize(offset + len);
+        RecordView::write(run->records.data() + offset, key, value);
+        run->offsets.push_back(offset);
+        stats_.rows++;
+        if (run->records.size() >= run_bytes) {
+            auto ec = hand_over();
+            if (ec != ErrorCode::Success)
+                return ec;
+        }
+    }
+    return run ? hand_over() : ErrorCode::Success;
+}
+
+void IndexBuilder::sort_runs() {
+    while (true) {
+        Run *run;
+        {
+            std::unique_lock lock(latch_);
+            cond_.wait(lock,
+                       [this] { return !unsorted_.empty() || input_done_; });
+            if (unsorted_.empty())
+                return;
+            run = unsorted_.front();
+            unsorted_.pop_front();
+            if (error_ != ErrorCode::Success)
+                continue;
+        }
+        cond_.notify_all();
+
+        // the rows of a key keep the order of the input.
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::pair<std::string_view, uint32_t>> keys;
+        keys.reserve(run->offsets.size());
+        for (auto offset : run->offsets)
+            keys.emplace_back(key_of(record_at(run->records, offset)), offset);
+        std::stable_sort(keys.begin(), keys.end(),
+                         [](const auto &lhs, const auto &rhs) {
+                             return NormalizedKey::compare(lhs.first,
+                                                           rhs.first) < 0;
+                         });
+        for (size_t i = 0; i < keys.size(); i++)
+            run->offsets[i] = keys[i].second;
+        uint64_t sort_ns = elapsed_ns(start);
+
+        size_t bytes =
+            run->records.size() + run->offsets.size() * sizeof(uint32_t);
+        bool keep;
+        {
+            std::scoped_lock lock(latch_);
+            stats_.sort_ns += sort_ns;
+            keep = sorted_bytes_ + bytes <= memory_ / 2;
+            if (keep)
+                sorted_bytes_ += bytes;
+        }
+        if (keep)
+            continue;
+
+        start = std::chrono::steady_clock::now();
+        auto ec = spill(*run);
+        std::scoped_lock lock(latch_);
+        stats_.spill_ns += elapsed_ns(start);
+        if (ec != ErrorCode::Success) {
+            error_ = ec;
+            cond_.notify_all();
+        } else {
+            stats_.spilled_runs++;
+        }
+    }
+}
+
+ErrorCode IndexBuilder::spill(Run &run) {
+    run.path = std::format("{}/index-{}-{}-run-{}", dir_, index_.id(),
+                           static_cast<const void *>(this), run.number);
+    std::ofstream os(run.path, std::ios::binary | std::ios::trunc);
+    for (auto offset : run.offsets) {
+        auto record = record_at(run.records, offset);
+        os.write(record.data(), record.length());
+    }
+    os.close();
+    if (!os.good()) {
+        Log::GlobalLog() << "[IndexBuilder]: failed to write run file "
+                         << run.path << std::endl;
+        return ErrorCode::DiskWriteError;
+    }
+    std::vector<char>().swap(run.records);
+    std::vector<uint32_t>().swap(run.offsets);
+    return ErrorCode::Success;
+}
+
+ErrorCode IndexBuilder::merge() {
+    // the next record of a run, from memory or from its run file.
+    struct Cursor {
+        Run *run;
+        size_t next = 0;
+        std::ifstream file;
+        std::vector<char> buf;
+        RecordView record;
+    };
+    ErrorCode ec = ErrorCode::Success;
+    auto advance = [&ec](Cursor &cursor) {
+        auto &run = *cursor.run;
+        if (run.path.empty()) {
+            if (cursor.next == run.offsets.size())
+                return false;
+            cursor.record = record_at(run.records, run.offsets[cursor.next++]);
+            return true;
+        }
+
+        cursor.buf.resize(sizeof(uint16_t));
+        if (!cursor.file.read(cursor.buf.data(), sizeof(uint16_t)))
+            return false;
+        uint16_t len = record_format::read<uint16_t>(cursor.buf.data());
+        cursor.buf.resize(std::max<size_t>(len, RecordView::HDR_LEN));
+        if (!cursor.file.read(cursor.buf.data() + sizeof(uint16_t),
+                              cursor.buf.size() - sizeof(uint16_t))) {
+            ec = ErrorCode::DiskReadError;
+            return false;
+        }
+        cursor.record = record_at(cursor.buf, 0);
+        return true;
+    };
+
+    // the least key first, the earliest run of a key first.
+    auto later = [](const Cursor *lhs, const Cursor *rhs) {
+        int cmp = NormalizedKey::compare(key_of(lhs->record),
+                                         key_of(rhs->record));
+        return cmp != 0 ? cmp > 0 : lhs->run->number > rhs->run->number;
+    };
+    std::priority_queue<Cursor *, std::vector<Cursor *>, decltype(later)>
+        heap(later);
+    std::vector<std::unique_ptr<Cursor>> cursors;
+    for (auto &run : runs_) {
+        auto cursor = std::make_unique<Cursor>();
+        cursor->run = run.get();
+        if (!run->path.empty()) {
+            cursor->file.open(run->path, std::ios::binary);
+            if (!cursor->file.is_open())
+                return ErrorCode::DiskReadError;
+        }
+        if (advance(*cursor))
+            heap.push(cursor.get());
+        cursors.push_back(std::move(cursor));
+    }
+    if (ec != ErrorCode::Success)
+        return ec;
+
+    std::string last;
+    bool first = true;
+    auto source = [&](Key &key, Column &value) {
+        while (!heap.empty()) {
+            Cursor *cursor = heap.top();
+            heap.pop();
+            bool duplicate = !first && key_of(cursor->record) == last;
+            if (duplicate) {
+                stats_.duplicates++;
+            } else {
+                auto record =
+                    cursor->record.materialize<LeafClusteredRecord>();
+                key = std::move(record.key);
+                value = std::move(record.value);
+                last = key_of(cursor->record);
+                first = false;
+            }
+            if (advance(*cursor))
+                heap.push(cursor);
+            if (!duplicate)
+                return ec == ErrorCode::Success;
+        }
+        return false;
+    };
+    auto loaded = index_.bulk_load(source);
+    return ec != ErrorCode::Success ? ec : loaded;
+}
+
+} // namespace storage
@@ -0,0 +1,114 @@
+#include "index/index_iterator.h"
+#include "buffer/buffer_pool.h"
+#include "index/index_node.h"
+#include <algorithm>
+
+namespace storage {
+
+tl::expected<bool, ErrorCode>
+IndexIterator::next_batch(std::vector<LeafClusteredRecord> &batch) {
+    batch.clear();
+    if (done_)
+        return false;
+    auto &meta = index_.record_meta();
+    if ((range_.lower && !meta.match_key(range_.lower.value())) ||
+        (range_.upper && !meta.match_key(range_.upper.value())))
+        return tl::unexpected(ErrorCode::InvalidKeyType);
+
+    size_t max = std::min(std::max<size_t>(range_.batch, 1),
+                          range_.limit - visited_);
+    ReadGuard guard(index_.pool());
+    Frame *frame = nullptr;
+    uint64_t version;
+    // the leaf the scan left for @frame through the sibling link, if any.
+    Frame *left = nullptr;
+    uint64_t left_version = 0;
+    while (batch.size() < max) {
+        if (!frame) {
+            left = nullptr;
+            auto leaf = from_ ? index_.search_leaf(from_.value(), version)
+                              : index_.search_edge_leaf(range_.reverse,
+                                                        version);
+            if (!leaf)
+                return tl::unexpected(leaf.error());
+            frame = leaf.value();
+        }
+
+        size_t size = batch.size();
+        tl::expected<bool, ErrorCode> more =
+            tl::unexpected(ErrorCode::ReadConflict);
+        page_id_t next = 0;
+        try {
+            LeafIndexNode node(frame, index_.comp_);
+            auto from = from_ ? &from_.value() : nullptr;
+            auto end = end_ ? &end_.value() : nullptr;
+            if (range_.reverse) {
+                more = node.scan_range_r(from, past_, end,
+                                         range_.lower_inclusive, max, batch);
+                next = frame->page()->hdr.prev_page;
+            } else {
+                more = node.scan_range(from, past_, end,
+                                       range_.upper_inclusive, max, batch);
+                next = frame->page()->hdr.next_page;
+            }
+        } catch (...) {
+            // a torn read, the validation below fails.
+        }
+        // NOTE: records moved between the leaf left and @frame after the
+        // leaf was read, like a borrow, would be missed. such a move writes
+        // both leaves, the leaf left is validated again for it.
+        if (!frame->validate(version) ||
+            (left && !left->validate(left_version))) {
+            batch.resize(size);
+            frame = nullptr;
+            continue;
+        }
+        if (!more)
+            return tl::unexpected(more.error());
+
+        if (batch.size() > size) {
+            from_ = batch.back().key;
+            past_ = true;
+        }
+        if (!more.value() || (next == 0 && batch.size() < max)) {
+            done_ = true;
+            break;
+        }
+        if (batch.size() == max)
+            break;
+
+        page_id_t left_pgno = frame->pgno();
+        left = frame;
+        left_version = version;
+        auto result = index_.get_frame(next);
+        if (!result)
+            return tl::unexpected(result.error());
+        frame = result.value();
+        version = frame->read_version();
+        // the sibling has been replaced, split or merged meanwhile, descend
+        // again.
+        auto &hdr = frame->page()->hdr;
+        page_id_t back = range_.reverse ? hdr.next_page : hdr.prev_page;
+        if (!frame->holds(index_.file_, next) || !frame->is_leaf() ||
+            back != left_pgno)
+            frame = nullptr;
+    }
+
+    visited_ += batch.size();
+    if (visited_ == range_.limit)
+        done_ = true;
+    return !batch.empty();
+}
+
+tl::expected<bool, ErrorCode> IndexIterator::next(LeafClusteredRecord &record) {
+    if (buffered_ == buffer_.size()) {
+        buffered_ = 0;
+        auto more = next_batch(buffer_);
+        if (!more || !more.value())
+            return more;
+    }
+    record = std::move(buffer_[buffered_++]);
+    return true;
+}
+
+} // namespace storage
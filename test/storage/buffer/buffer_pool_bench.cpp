@@ -0,0 +1,121 @@
+#include "buffer/buffer_pool.h"
+#include "disk/disk_manager.h"
+#include "error.h"
+#include "types.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <random>
+
+// timings of the buffer pool. the numbers are printed only, the behaviour is
+// checked by buffer_pool_test.
+
+using clock_type = std::chrono::steady_clock;
+
+static long long elapsed_us(clock_type::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               clock_type::now() - start)
+        .count();
+}
+
+// report warm-up time and time-to-90%-hit-ratio for a cold and a warm restart
+// under a skewed workload.
+TEST(BufferPoolBench, WarmRestart) {
+    constexpr int number_of_pages = 1200;
+    constexpr int hot_pages = 300;
+    constexpr int pool_size = 400;
+    constexpr int window = 200;
+    constexpr int max_requests = 20000;
+
+    auto disk = std::make_shared<storage::DiskManager>("bench.db");
+    auto next_page = [](std::mt19937 &rng) -> storage::page_id_t {
+        // 95% of the requests go to the hot pages.
+        if (rng() % 100 < 95)
+            return 1 + rng() % hot_pages;
+        return 1 + rng() % number_of_pages;
+    };
+
+    // run the workload until the hit ratio of a window reaches 90%.
+    // @return the number of requests and the time it takes.
+    auto run = [&](storage::BufferPoolManager &pool) {
+        std::mt19937 rng(7);
+        auto start = clock_type::now();
+        int requests = 0;
+        auto last = pool.stats().total;
+        while (requests < max_requests) {
+            for (int i = 0; i < window; i++, requests++)
+                pool.get_frame(next_page(rng));
+            auto now = pool.stats().total;
+            double hits = now.hits - last.hits;
+            double misses = now.misses - last.misses;
+            last = now;
+            if (hits / (hits + misses) >= 0.9)
+                break;
+        }
+        return std::make_pair(requests, elapsed_us(start));
+    };
+
+    {
+        storage::BufferPoolManager pool(pool_size, disk);
+        for (int i = 0; i < number_of_pages; i++)
+            ASSERT_EQ(true, pool.allocate_frame().has_value());
+        std::mt19937 rng(42);
+        for (int i = 0; i < 10 * pool_size; i++)
+            pool.get_frame(next_page(rng));
+        pool.set_dump_file("bench.dump");
+    }
+
+    storage::BufferPoolManager cold_pool(pool_size, disk);
+    auto cold = run(cold_pool);
+
+    storage::BufferPoolManager warm_pool(pool_size, disk);
+    auto start = clock_type::now();
+    warm_pool.start_warm_up("bench.dump");
+    ASSERT_EQ(ErrorCode::Success, warm_pool.wait_warm_up());
+    auto warm_up_us = elapsed_us(start);
+    auto warm = run(warm_pool);
+
+    std::cerr << std::format("[ BENCH    ] warm-up: {} pages in {} us\n",
+                             warm_pool.stats().frames_in_use, warm_up_us);
+    std::cerr << std::format("[ BENCH    ] cold restart: 90% hit ratio after "
+                             "{} requests, {} us\n",
+                             cold.first, cold.second);
+    std::cerr << std::format("[ BENCH    ] warm restart: 90% hit ratio after "
+                             "{} requests, {} us\n",
+                             warm.first, warm.second);
+
+    std::filesystem::remove("bench.dump");
+    std::filesystem::remove("bench.db");
+}
+
+// every access misses and evicts, half of the victims are dirty.
+TEST(BufferPoolBench, MissPath) {
+    constexpr int number_of_pages = 64;
+    constexpr int pool_size = 16;
+    constexpr int rounds = 2000;
+
+    auto disk = std::make_shared<storage::DiskManager>("bench.db");
+    storage::BufferPoolManager pool(pool_size, disk);
+    std::vector<storage::page_id_t> pages;
+    for (int i = 0; i < number_of_pages; i++) {
+        auto result = pool.allocate_frame();
+        ASSERT_EQ(true, result.has_value());
+        pages.push_back(result.value()->pgno());
+    }
+
+    auto start = clock_type::now();
+    for (int r = 0; r < rounds; r++) {
+        for (auto pgno : pages) {
+            auto result = pool.get_frame(pgno);
+            ASSERT_EQ(true, result.has_value());
+            if (pgno % 2)
+                result.value()->mark_dirty();
+        }
+    }
+    auto us = elapsed_us(start);
+    std::cerr << std::format("[ BENCH    ] miss path: {} ns per miss\n",
+                             us * 1000 / (rounds * number_of_pages));
+    std::filesystem::remove("bench.db");
+}
@@ -4,7 +4,26 @@
 #include "types.h"
 #include "gtest/gtest.h"
 #include <gtest/gtest.h>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <memory>
+#include <new>
+#include <random>
+#include <sstream>
+
+// count every heap allocation of the test binary.
+static std::atomic<size_t> allocations{0};
+
+void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
 
 TEST(BufferPoolTest, BasicTest) {
     ErrorHandler handler;
@@ -72,3 +91,431 @@ TEST(BufferPoolTest, BasicTest) {
     }
     std::filesystem::remove("test.db");
 }
+
+TEST(BufferPoolTest, ResizeTest) {
+    auto disk = std::make_shared<storage::DiskManager>("test_resize.db");
+    storage::BufferPoolManager pool(10, disk);
+
+    std::vector<storage::page_id_t> pgnos;
+    for (int i = 0; i < 10; i++) {
+        auto result = pool.allocate_frame();
+        ASSERT_EQ(true, result.has_value());
+        auto frame = result.value();
+        frame->page()->payload[0] = 'a' + i;
+        pgnos.push_back(frame->pgno());
+    }
+
+    // grow: new frames are used before any eviction.
+    ASSERT_EQ(ErrorCode::Success, pool.resize(20));
+    ASSERT_EQ(20, pool.size());
+    for (int i = 10; i < 20; i++) {
+        auto result = pool.allocate_frame();
+        ASSERT_EQ(true, result.has_value());
+        auto frame = result.value();
+        ASSERT_EQ(i, frame->id());
+        frame->page()->payload[0] = 'a' + i;
+        pgnos.push_back(frame->pgno());
+    }
+    for (int i = 0; i < 20; i++) {
+        auto result = pool.get_frame(pgnos[i]);
+        ASSERT_EQ(true, result.has_value());
+        ASSERT_EQ(i, result.value()->id());
+    }
+
+    // shrink: a pinned tail frame holds the shrinking back.
+    ASSERT_EQ(ErrorCode::Success, pool.pin_frame(pgnos[19]));
+    ASSERT_EQ(ErrorCode::Success, pool.resize(4));
+    ASSERT_EQ(4, pool.target_size());
+    ASSERT_EQ(20, pool.size());
+    ASSERT_EQ(ErrorCode::Success, pool.unpin_frame(pgnos[19]));
+
+    // a later miss retires the tail frames, flushing them.
+    ASSERT_EQ(true, pool.allocate_frame().has_value());
+    ASSERT_EQ(4, pool.size());
+    for (int i = 0; i < 20; i++) {
+        auto result = pool.get_frame(pgnos[i]);
+        ASSERT_EQ(true, result.has_value());
+        ASSERT_LT(result.value()->id(), 4);
+        ASSERT_EQ('a' + i, result.value()->page()->payload[0]);
+    }
+
+    ASSERT_EQ(ErrorCode::InvalidPoolSize, pool.resize(0));
+    std::filesystem::remove("test_resize.db");
+}
+
+TEST(BufferPoolTest, StatsTest) {
+    auto disk = std::make_shared<storage::DiskManager>("test_stats.db");
+    storage::BufferPoolManager pool(4, disk);
+
+    std::vector<storage::page_id_t> pgnos;
+    for (int i = 0; i < 8; i++) {
+        auto result = pool.allocate_frame();
+        ASSERT_EQ(true, result.has_value());
+        auto frame = result.value();
+        frame->page()->hdr.index = 3;
+        frame->page()->hdr.is_leaf = i % 2 == 0;
+        pgnos.push_back(frame->pgno());
+    }
+    // 4 dirty pages evicted by the allocation.
+    auto stats = pool.stats();
+    ASSERT_EQ(4, stats.total.evictions);
+    ASSERT_EQ(4, stats.total.dirty_write_backs);
+    ASSERT_EQ(4, stats.total.disk_writes);
+    ASSERT_EQ(2, stats.leaf.evictions);
+    ASSERT_EQ(2, stats.internal.evictions);
+    ASSERT_EQ(4, stats.frames_in_use);
+    ASSERT_EQ(4, stats.dirty_frames);
+
+    // the last 4 pages are cached, the first 4 are not.
+    for (int i = 7; i >= 0; i--)
+        ASSERT_EQ(true, pool.get_frame(pgnos[i]).has_value());
+    stats = pool.stats();
+    ASSERT_EQ(4, stats.total.hits);
+    ASSERT_EQ(4, stats.total.misses);
+    ASSERT_EQ(4, stats.total.disk_reads);
+    ASSERT_DOUBLE_EQ(0.5, stats.total.hit_ratio());
+    ASSERT_EQ(1, stats.indices.size());
+    ASSERT_EQ(4, stats.indices.at(3).hits);
+
+    std::stringstream text;
+    pool.export_stats(text);
+    ASSERT_NE(std::string::npos,
+              text.str().find(
+                  "minidb_buffer_pool_hits_total{page_type=\"leaf\"} 2\n"));
+    ASSERT_EQ(std::string::npos,
+              text.str().find("minidb_buffer_pool_hits_total 4\n"));
+    ASSERT_NE(std::string::npos,
+              text.str().find(
+                  "minidb_buffer_pool_index_misses_total{index=\"3\"} 4\n"));
+
+    // the least recently used page is pinned, the eviction passes it over.
+    ASSERT_EQ(ErrorCode::Success, pool.pin_frame(pgnos[3]));
+    ASSERT_EQ(true, pool.get_frame(pgnos[7]).has_value());
+    stats = pool.stats();
+    ASSERT_LE(1, stats.internal.pin_waits);
+    ASSERT_EQ(true, pool.get_frame(pgnos[3]).has_value());
+    ASSERT_EQ(ErrorCode::Success, pool.unpin_frame(pgnos[3]));
+
+    pool.reset_stats();
+    ASSERT_EQ(0, pool.stats().total.hits);
+    std::filesystem::remove("test_stats.db");
+}
+
+TEST(BufferPoolTest, DumpAndWarmUpTest) {
+    auto disk = std::make_shared<storage::DiskManager>("test_warm.db");
+    std::vector<storage::page_id_t> hot;
+    {
+        storage::BufferPoolManager pool(8, disk);
+        for (int i = 0; i < 16; i++) {
+            auto result = pool.allocate_frame();
+            ASSERT_EQ(true, result.has_value());
+            result.value()->page()->payload[0] = 'a' + i;
+        }
+        // touch 4 pages from the coldest to the hottest.
+        for (storage::page_id_t pgno : {3, 9, 5, 12})
+            ASSERT_EQ(true, pool.get_frame(pgno).has_value());
+        hot = {12, 5, 9, 3};
+        pool.set_dump_file("test_warm.dump");
+    }
+
+    storage::BufferPoolManager pool(6, disk);
+    ASSERT_EQ(ErrorCode::Success, pool.warm_up("test_warm.dump"));
+    // the 6 hottest pages are cached, in the dumped order.
+    auto stats = pool.stats();
+    ASSERT_EQ(6, stats.frames_in_use);
+    for (auto pgno : hot) {
+        auto result = pool.get_frame(pgno);
+        ASSERT_EQ(true, result.has_value());
+        ASSERT_EQ('a' + pgno - 1, result.value()->page()->payload[0]);
+    }
+    ASSERT_EQ(4, pool.stats().total.hits);
+    ASSERT_EQ(0, pool.stats().total.misses);
+
+    // the files are added in another order, the pages are found by path.
+    {
+        auto other = std::make_shared<storage::DiskManager>("test_warm2.db");
+        storage::BufferPoolManager reordered(6);
+        reordered.add_file(other);
+        auto file = reordered.add_file(disk);
+        ASSERT_EQ(ErrorCode::Success, reordered.warm_up("test_warm.dump"));
+        ASSERT_EQ(6, reordered.stats().frames_in_use);
+        for (auto pgno : hot) {
+            auto result = reordered.get_frame(file, pgno);
+            ASSERT_EQ(true, result.has_value());
+            ASSERT_EQ('a' + pgno - 1, result.value()->page()->payload[0]);
+        }
+        ASSERT_EQ(0, reordered.stats().total.misses);
+    }
+
+    // a dump claiming more than it holds fails before reading any page.
+    auto size = std::filesystem::file_size("test_warm.dump");
+    std::filesystem::resize_file("test_warm.dump", size - 1);
+    storage::BufferPoolManager truncated(6, disk);
+    ASSERT_EQ(ErrorCode::DiskReadError, truncated.warm_up("test_warm.dump"));
+    {
+        std::fstream os("test_warm.dump",
+                        std::ios::binary | std::ios::in | std::ios::out);
+        uint32_t count = UINT32_MAX;
+        os.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    }
+    ASSERT_EQ(ErrorCode::DiskReadError, truncated.warm_up("test_warm.dump"));
+    ASSERT_EQ(0, truncated.stats().frames_in_use);
+
+    std::filesystem::remove("test_warm.dump");
+    std::filesystem::remove("test_warm.db");
+    std::filesystem::remove("test_warm2.db");
+}
+
+TEST(BufferPoolTest, PrefetchTest) {
+    auto disk = std::make_shared<storage::DiskManager>("test_prefetch.db");
+    storage::BufferPoolManager pool(8, disk);
+    for (int i = 0; i < 16; i++) {
+        auto result = pool.allocate_frame();
+        ASSERT_EQ(true, result.has_value());
+        result.value()->page()->payload[0] = 'a' + i;
+    }
+    ASSERT_EQ(ErrorCode::Success, pool.flush_all());
+
+    // the pool is full, the pages prefetched take the frames of others.
+    std::vector<storage::page_id_t> pgnos = {2, 3, 5, 4, 16, 3};
+    ASSERT_EQ(ErrorCode::Success, pool.prefetch(0, pgnos));
+    auto before = pool.stats().total;
+    for (auto pgno : pgnos) {
+        auto result = pool.get_frame(pgno);
+        ASSERT_EQ(true, result.has_value());
+        ASSERT_EQ('a' + pgno - 1, result.value()->page()->payload[0]);
+    }
+    auto after = pool.stats().total;
+    ASSERT_EQ(pgnos.size(), after.hits - before.hits);
+    ASSERT_EQ(0, after.misses - before.misses);
+    ASSERT_EQ(8, pool.stats().frames_in_use);
+
+    std::filesystem::remove("test_prefetch.db");
+}
+
+// a warm restart reaches a 90% hit ratio sooner than a cold one under a
+// skewed workload.
+TEST(BufferPoolTest, WarmRestartTest) {
+    constexpr int number_of_pages = 1200;
+    constexpr int hot_pages = 300;
+    constexpr int pool_size = 400;
+    constexpr int window = 200;
+    constexpr int max_requests = 20000;
+
+    auto disk = std::make_shared<storage::DiskManager>("test_restart.db");
+    auto next_page = [](std::mt19937 &rng) -> storage::page_id_t {
+        // 95% of the requests go to the hot pages.
+        if (rng() % 100 < 95)
+            return 1 + rng() % hot_pages;
+        return 1 + rng() % number_of_pages;
+    };
+
+    // run the workload until the hit ratio of a window reaches 90%.
+    // @return the number of requests it takes.
+    auto run = [&](storage::BufferPoolManager &pool) {
+        std::mt19937 rng(7);
+        int requests = 0;
+        auto last = pool.stats().total;
+        while (requests < max_requests) {
+            for (int i = 0; i < window; i++, requests++)
+                EXPECT_EQ(true, pool.get_frame(next_page(rng)).has_value());
+            auto now = pool.stats().total;
+            double hits = now.hits - last.hits;
+            double misses = now.misses - last.misses;
+            last = now;
+            if (hits / (hits + misses) >= 0.9)
+                break;
+        }
+        return requests;
+    };
+
+    {
+        storage::BufferPoolManager pool(pool_size, disk);
+        for (int i = 0; i < number_of_pages; i++)
+            ASSERT_EQ(true, pool.allocate_frame().has_value());
+        std::mt19937 rng(42);
+        for (int i = 0; i < 10 * pool_size; i++)
+            pool.get_frame(next_page(rng));
+        pool.set_dump_file("test_restart.dump");
+    }
+
+    storage::BufferPoolManager cold_pool(pool_size, disk);
+    auto cold = run(cold_pool);
+
+    storage::BufferPoolManager warm_pool(pool_size, disk);
+    warm_pool.start_warm_up("test_restart.dump");
+    ASSERT_EQ(ErrorCode::Success, warm_pool.wait_warm_up());
+    auto warm = run(warm_pool);
+    ASSERT_LT(warm, cold);
+
+    std::filesystem::remove("test_restart.dump");
+    std::filesystem::remove("test_restart.db");
+}
+
+TEST(BufferPoolTest, SwizzleTest) {
+    auto disk = std::make_shared<storage::DiskManager>("test_swizzle.db");
+    storage::BufferPoolManager pool(4, disk);
+
+    auto parent = pool.allocate_frame();
+    ASSERT_EQ(true, parent.has_value());
+    ASSERT_EQ(ErrorCode::Success, pool.protect_frame(parent.value()));
+    auto child = pool.allocate_frame();
+    ASSERT_EQ(true, child.has_value());
+    storage::page_id_t pgno = child.value()->pgno();
+    ASSERT_EQ(nullptr, parent.value()->swizzled_child(pgno));
+
+    // the first access swizzles the child, later ones bypass the pool.
+    auto result = pool.get_child_frame(parent.value(), pgno);
+    ASSERT_EQ(true, result.has_value());
+    ASSERT_EQ(child.value(), result.value());
+    ASSERT_EQ(child.value(), parent.value()->swizzled_child(pgno));
+    result = pool.get_child_frame(parent.value(), pgno);
+    ASSERT_EQ(child.value(), result.value());
+
+    // the eviction of the child unswizzles it.
+    for (int i = 0; i < 8; i++) {
+        ASSERT_EQ(true, pool.allocate_frame().has_value());
+    }
+    ASSERT_EQ(nullptr, parent.value()->swizzled_child(pgno));
+
+    result = pool.get_child_frame(parent.value(), pgno);
+    ASSERT_EQ(true, result.has_value());
+    ASSERT_EQ(pgno, result.value()->pgno());
+    ASSERT_EQ(result.value(), parent.value()->swizzled_child(pgno));
+    std::filesystem::remove("test_swizzle.db");
+}
+
+TEST(BufferPoolTest, SharedPoolTest) {
+    storage::BufferPoolManager pool(8);
+    auto a = pool.add_file(
+        std::make_shared<storage::DiskManager>("test_shared_a.db"));
+    auto b = pool.add_file(
+        std::make_shared<storage::DiskManager>("test_shared_b.db"));
+    ASSERT_NE(a, b);
+    ASSERT_EQ(ErrorCode::Success, pool.reserve(a, 4));
+
+    // both files start at page 1, the frames must not collide.
+    auto fa = pool.allocate_frame(a);
+    auto fb = pool.allocate_frame(b);
+    ASSERT_EQ(true, fa.has_value() && fb.has_value());
+    ASSERT_EQ(fa.value()->pgno(), fb.value()->pgno());
+    ASSERT_NE(fa.value(), fb.value());
+    for (int i = 0; i < 3; i++)
+        ASSERT_EQ(true, pool.allocate_frame(a).has_value());
+
+    // a scan of file b cannot push file a below its reservation.
+    for (int i = 0; i < 32; i++)
+        ASSERT_EQ(true, pool.allocate_frame(b).has_value());
+    ASSERT_EQ(4, pool.resident_size(a));
+    ASSERT_EQ(4, pool.resident_size(b));
+
+    auto result = pool.get_frame(a, fa.value()->pgno());
+    ASSERT_EQ(true, result.has_value());
+    ASSERT_EQ(a, result.value()->file());
+
+    // a file with a page pinned is left as it was.
+    ASSERT_EQ(ErrorCode::Success, pool.pin_frame(a, fa.value()->pgno()));
+    ASSERT_EQ(ErrorCode::FramePinned, pool.remove_file(a));
+    ASSERT_EQ(4, pool.resident_size(a));
+    ASSERT_EQ(ErrorCode::Success, pool.unpin_frame(a, fa.value()->pgno()));
+
+    // removing a file hands its frames back to the others.
+    ASSERT_EQ(ErrorCode::Success, pool.remove_file(a));
+    ASSERT_EQ(0, pool.resident_size(a));
+    for (int i = 0; i < 8; i++)
+        ASSERT_EQ(true, pool.allocate_frame(b).has_value());
+    ASSERT_EQ(8, pool.resident_size(b));
+    std::filesystem::remove("test_shared_a.db");
+    std::filesystem::remove("test_shared_b.db");
+}
+
+TEST(BufferPoolTest, AllocationFreeTest) {
+    constexpr int number_of_pages = 64;
+    constexpr int pool_size = 16;
+    constexpr int rounds = 20;
+
+    auto disk = std::make_shared<storage::DiskManager>("test_alloc.db");
+    storage::BufferPoolManager pool(pool_size, disk);
+    std::vector<storage::page_id_t> pages;
+    for (int i = 0; i < number_of_pages; i++) {
+        auto result = pool.allocate_frame();
+        ASSERT_EQ(true, result.has_value());
+        pages.push_back(result.value()->pgno());
+    }
+
+    // every access misses and evicts, half of the victims are dirty.
+    auto run = [&]() {
+        for (int r = 0; r < rounds; r++) {
+            for (auto pgno : pages) {
+                auto result = pool.get_frame(pgno);
+                ASSERT_EQ(true, result.has_value());
+                if (pgno % 2)
+                    result.value()->mark_dirty();
+            }
+        }
+    };
+    // reach the steady state first.
+    run();
+
+    size_t before = allocations.load();
+    run();
+    ASSERT_EQ(0, allocations.load() - before);
+    ASSERT_EQ(rounds * number_of_pages * 2, pool.stats().total.misses);
+    std::filesystem::remove("test_alloc.db");
+}
+
+TEST(BufferPoolTest, SecondaryCacheTest) {
+    // the pool and the second-level cache hold all the pages together.
+    constexpr int number_of_pages = 12;
+    auto disk = std::make_shared<storage::DiskManager>("test_l2.db");
+    storage::BufferPoolManager pool(4, disk);
+    ASSERT_EQ(ErrorCode::Success, pool.set_secondary_cache("test_l2.cache", 8));
+
+    std::vector<storage::page_id_t> pages;
+    for (int i = 0; i < number_of_pages; i++) {
+        auto result = pool.allocate_frame();
+        ASSERT_EQ(true, result.has_value());
+        auto frame = result.value();
+        frame->page()->hdr.number_of_records = i;
+        frame->page()->payload[0] = 'a' + i;
+        pages.push_back(frame->pgno());
+    }
+    // dirty victims go back to the database file only.
+    ASSERT_EQ(0, pool.secondary_size());
+    pool.flush_all();
+
+    auto read_all = [&]() {
+        for (int i = 0; i < number_of_pages; i++) {
+            auto result = pool.get_frame(pages[i]);
+            ASSERT_EQ(true, result.has_value());
+            ASSERT_EQ(i, result.value()->number_of_records());
+            ASSERT_EQ('a' + i, result.value()->page()->payload[0]);
+        }
+    };
+    read_all();
+    ASSERT_EQ(8, pool.secondary_size());
+    pool.reset_stats();
+    // every miss is served by the second-level cache now.
+    read_all();
+    auto stats = pool.stats();
+    ASSERT_EQ(number_of_pages, stats.total.misses);
+    ASSERT_EQ(number_of_pages, stats.total.secondary_hits);
+    ASSERT_EQ(0, stats.total.secondary_misses);
+    ASSERT_EQ(0, stats.total.disk_reads);
+    ASSERT_EQ(number_of_pages, stats.total.secondary_writes);
+
+    // a page written back leaves no stale copy behind.
+    auto result = pool.get_frame(pages[0]);
+    ASSERT_EQ(true, result.has_value());
+    result.value()->page()->payload[0] = 'z';
+    result.value()->mark_dirty();
+    for (int i = 1; i < number_of_pages; i++)
+        ASSERT_EQ(true, pool.get_frame(pages[i]).has_value());
+    result = pool.get_frame(pages[0]);
+    ASSERT_EQ(true, result.has_value());
+    ASSERT_EQ('z', result.value()->page()->payload[0]);
+
+    ASSERT_EQ(ErrorCode::Success, pool.set_secondary_cache("", 0));
+    ASSERT_EQ(false, std::filesystem::exists("test_l2.cache"));
+    std::filesystem::remove("test_l2.db");
+}
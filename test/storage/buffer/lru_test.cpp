@@ -30,3 +30,30 @@ TEST(LruTest, BasicTest) {
     ASSERT_EQ(true, result.has_value());
     ASSERT_EQ(10, result.value());
 }
+
+TEST(LruTest, PinAndProtectTest) {
+    using Cache = storage::LRUCacheWithPin<int, int>;
+
+    Cache cache(4);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(ErrorCode::Success, cache.put(i, i));
+    }
+    ASSERT_EQ(ErrorCode::Success, cache.pin(0));
+    ASSERT_EQ(ErrorCode::Success, cache.protect(1));
+    ASSERT_EQ(1, cache.protected_size());
+
+    // neither the pinned nor the protected entry is victimized.
+    auto result = cache.victim();
+    ASSERT_EQ(true, result.has_value());
+    ASSERT_EQ(2, result.value());
+    result = cache.victim();
+    ASSERT_EQ(true, result.has_value());
+    ASSERT_EQ(3, result.value());
+    ASSERT_EQ(false, cache.victim().has_value());
+
+    ASSERT_EQ(ErrorCode::Success, cache.unprotect(1));
+    result = cache.victim();
+    ASSERT_EQ(true, result.has_value());
+    ASSERT_EQ(1, result.value());
+    ASSERT_EQ(1, cache.size());
+}
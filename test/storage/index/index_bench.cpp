@@ -0,0 +1,362 @@
+#include "error.h"
+#include "index/index.h"
+#include "index/index_builder.h"
+#include "index/index_iterator.h"
+#include "types.h"
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <gtest/gtest.h>
+#include <random>
+#include <thread>
+#include <vector>
+
+// timings of the index, next to the baselines they are meant to beat. the
+// numbers are printed only, the behaviour is checked by index_test.
+
+using namespace storage;
+using clock_type = std::chrono::steady_clock;
+
+static long long elapsed_us(clock_type::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               clock_type::now() - start)
+        .count();
+}
+
+static KeyMeta int_key = {"id", storage::key_t(KeyType::Int)};
+static std::vector<FieldMeta> int_fields = {
+    {"score", storage::key_t(KeyType::Int)}};
+
+TEST(IndexBench, UrlKeys) {
+    KeyMeta key_meta = {"url", storage::key_t(KeyType::String)};
+    auto index = Index::make_index(0, "bench.db", key_meta, int_fields,
+                                   std::cerr);
+
+    std::vector<std::string> urls;
+    for (int tenant = 0; tenant < 20; tenant++) {
+        for (int user = 0; user < 50; user++) {
+            for (auto path : {"/events/click", "/events/view", "/profile",
+                              "/settings/notifications", "/sessions"}) {
+                urls.push_back(std::format(
+                    "https://www.example.com/tenants/{:04}/users/{:06}{}",
+                    tenant, user, path));
+            }
+        }
+    }
+    auto rng = std::default_random_engine{};
+    std::shuffle(std::begin(urls), std::end(urls), rng);
+    size_t full_bytes = 0;
+    for (size_t i = 0; i < urls.size(); i++) {
+        ASSERT_EQ(ErrorCode::Success,
+                  index->insert_record(urls[i], {int(i)}));
+        full_bytes += RecordView::encoded_len(Key{urls[i]}, Column{int(i)}) +
+                      Frame::SLOT_LEN;
+    }
+
+    auto usage = index->page_usage();
+    std::cout << "[ BENCH    ] " << urls.size() << " url keys: depth "
+              << index->depth() << ", " << usage.pages << " pages, "
+              << usage.used_bytes << " bytes used (" << usage.internal_bytes
+              << " in internal pages), " << full_bytes
+              << " bytes of leaf records with full keys" << std::endl;
+    std::filesystem::remove("bench.db");
+}
+
+TEST(IndexBench, UpdateChurn) {
+    KeyMeta key_meta = {"user", storage::key_t(KeyType::String)};
+    auto index = Index::make_index(0, "bench.db", key_meta, int_fields,
+                                   std::cerr);
+
+    std::vector<std::string> users;
+    for (int i = 0; i < 3000; i++)
+        users.push_back(std::format("user:{:06}", i));
+    auto rng = std::default_random_engine{};
+    std::shuffle(std::begin(users), std::end(users), rng);
+    for (auto &user : users)
+        ASSERT_EQ(ErrorCode::Success, index->insert_record(user, {0}));
+    auto before = index->page_usage();
+
+    auto start = clock_type::now();
+    for (int round = 1; round <= 10; round++) {
+        std::shuffle(std::begin(users), std::end(users), rng);
+        for (auto &user : users) {
+            ASSERT_EQ(ErrorCode::Success, index->remove_record(user));
+            ASSERT_EQ(ErrorCode::Success, index->insert_record(user, {round}));
+        }
+    }
+    auto us = elapsed_us(start);
+    auto after = index->page_usage();
+    std::cout << "[ BENCH    ] " << users.size() << " keys updated 10 times in "
+              << us << " us: " << before.pages << " pages before, "
+              << after.pages << " pages after, " << after.deleted_bytes
+              << " deleted bytes left" << std::endl;
+    std::filesystem::remove("bench.db");
+}
+
+TEST(IndexBench, BulkLoad) {
+    const int n = 100000;
+    auto loaded = Index::make_index(0, "bench.db", int_key, int_fields,
+                                    std::cerr);
+    int i = 0;
+    auto start = clock_type::now();
+    ASSERT_EQ(ErrorCode::Success,
+              loaded->bulk_load([&](Key &key, Column &value) {
+                  if (i >= n)
+                      return false;
+                  key = i * 2;
+                  value = {i};
+                  i++;
+                  return true;
+              }));
+    auto load_us = elapsed_us(start);
+
+    auto inserted = Index::make_index(1, "bench1.db", int_key, int_fields,
+                                      std::cerr);
+    start = clock_type::now();
+    for (int i = 0; i < n; i++)
+        ASSERT_EQ(ErrorCode::Success, inserted->insert_record(i * 2, {i}));
+    auto insert_us = elapsed_us(start);
+
+    std::cout << "[ BENCH    ] " << n << " int keys: bulk load in "
+              << load_us / 1000 << " ms, " << loaded->page_usage().pages
+              << " pages at depth " << loaded->depth() << ", inserts in "
+              << insert_us / 1000 << " ms, " << inserted->page_usage().pages
+              << " pages at depth " << inserted->depth() << std::endl;
+    std::filesystem::remove("bench.db");
+    std::filesystem::remove("bench1.db");
+}
+
+TEST(IndexBench, BuildFromUnsortedRows) {
+    const int n = 60000;
+    std::vector<int> keys;
+    auto rng = std::default_random_engine{};
+    std::uniform_int_distribution<int> key(0, 50000);
+    for (int i = 0; i < n; i++)
+        keys.push_back(key(rng));
+
+    auto inserted = Index::make_index(0, "bench.db", int_key, int_fields,
+                                      std::cerr);
+    auto start = clock_type::now();
+    for (int i = 0; i < n; i++)
+        inserted->insert_record(keys[i], {i});
+    auto insert_us = elapsed_us(start);
+
+    auto built = Index::make_index(1, "bench1.db", int_key, int_fields,
+                                   std::cerr);
+    IndexBuilder builder(*built, std::filesystem::temp_directory_path(),
+                         256 << 10, 4);
+    int next = 0;
+    ASSERT_EQ(ErrorCode::Success,
+              builder.build([&](Key &key, Column &value) {
+                  if (next == n)
+                      return false;
+                  key = keys[next];
+                  value = {next++};
+                  return true;
+              }));
+    auto &stats = builder.stats();
+    std::cout << "[ BENCH    ] " << n << " unsorted rows: built in "
+              << (stats.run_ns + stats.merge_ns) / 1000000 << " ms ("
+              << stats.run_ns / 1000000 << " ms into " << stats.runs
+              << " runs, " << stats.spilled_runs << " spilled, "
+              << stats.merge_ns / 1000000 << " ms merged), inserts in "
+              << insert_us / 1000 << " ms" << std::endl;
+    std::filesystem::remove("bench.db");
+    std::filesystem::remove("bench1.db");
+}
+
+TEST(IndexBench, RangeScan) {
+    auto index = Index::make_index(0, "bench.db", int_key, int_fields,
+                                   std::cerr);
+    const int n = 20000;
+    std::vector<int> keys;
+    for (int i = 0; i < n; i += 2)
+        keys.push_back(i);
+    auto rng = std::default_random_engine{};
+    std::shuffle(std::begin(keys), std::end(keys), rng);
+    for (auto key : keys)
+        ASSERT_EQ(ErrorCode::Success, index->insert_record(key, {key}));
+
+    // the scan visits the leaves of the range only, the traversal all of
+    // them.
+    const int rounds = 200;
+    auto start = clock_type::now();
+    for (int i = 0; i < rounds; i++) {
+        IndexIterator it(*index, {i * 50, true, i * 50 + 198, true});
+        LeafClusteredRecord record;
+        size_t found = 0;
+        while (it.next(record).value())
+            found++;
+        ASSERT_EQ(100, found);
+    }
+    auto scan_us = elapsed_us(start);
+    start = clock_type::now();
+    for (int i = 0; i < rounds; i++) {
+        size_t found = 0;
+        index->traverse([&](LeafClusteredRecord &record) {
+            int key = std::get<int>(record.key);
+            found += key >= i * 50 && key <= i * 50 + 198;
+        });
+        ASSERT_EQ(100, found);
+    }
+    auto traverse_us = elapsed_us(start);
+    std::cout << "[ BENCH    ] " << rounds << " scans of 100 of " << n / 2
+              << " keys: " << scan_us << " us, by traversals "
+              << traverse_us << " us" << std::endl;
+    std::filesystem::remove("bench.db");
+}
+
+TEST(IndexBench, ReverseRangeScan) {
+    auto index = Index::make_index(0, "bench.db", int_key, int_fields,
+                                   std::cerr);
+    const int n = 20000;
+    std::vector<int> keys;
+    for (int i = 0; i < n; i += 2)
+        keys.push_back(i);
+    auto rng = std::default_random_engine{};
+    std::shuffle(std::begin(keys), std::end(keys), rng);
+    for (auto key : keys)
+        ASSERT_EQ(ErrorCode::Success, index->insert_record(key, {key}));
+
+    // the latest events, read backwards from the end instead of reversing a
+    // full forward scan.
+    const int rounds = 200;
+    auto start = clock_type::now();
+    for (int i = 0; i < rounds; i++) {
+        IndexIterator it(*index, {.limit = 100, .reverse = true});
+        LeafClusteredRecord record;
+        size_t found = 0;
+        while (it.next(record).value())
+            found++;
+        ASSERT_EQ(100, found);
+    }
+    auto reverse_us = elapsed_us(start);
+    start = clock_type::now();
+    for (int i = 0; i < rounds; i++) {
+        std::vector<LeafClusteredRecord> all;
+        IndexIterator it(*index, {});
+        LeafClusteredRecord record;
+        while (it.next(record).value())
+            all.push_back(record);
+        std::reverse(all.begin(), all.end());
+        all.resize(100);
+        ASSERT_EQ(Key{n - 2}, all.front().key);
+    }
+    auto forward_us = elapsed_us(start);
+    std::cout << "[ BENCH    ] " << rounds << " reads of the latest 100 of "
+              << n / 2 << " events: " << reverse_us << " us, by forward scans "
+              << forward_us << " us" << std::endl;
+    std::filesystem::remove("bench.db");
+}
+
+TEST(IndexBench, MultiGet) {
+    auto pool = std::make_shared<BufferPoolManager>(config::DEFAULT_POOL_SIZE);
+    auto index = Index::make_index(0, "bench.db", int_key, int_fields,
+                                   std::cerr, pool);
+    const int n = 100000;
+    std::vector<int> keys;
+    for (int i = 0; i < n; i += 2)
+        keys.push_back(i);
+    auto rng = std::default_random_engine{};
+    std::shuffle(std::begin(keys), std::end(keys), rng);
+    for (auto key : keys)
+        ASSERT_EQ(ErrorCode::Success, index->insert_record(key, {key}));
+
+    // requests of random keys, and of keys close to each other.
+    const int rounds = 200, batch = 500;
+    std::uniform_int_distribution<int> dist(-10, n + 10);
+    std::vector<std::vector<Key>> requests(rounds), clustered(rounds);
+    for (auto &request : requests) {
+        for (int i = 0; i < batch; i++)
+            request.push_back(dist(rng));
+    }
+    for (auto &request : clustered) {
+        int from = dist(rng);
+        std::uniform_int_distribution<int> near(from, from + batch * 4);
+        for (int i = 0; i < batch; i++)
+            request.push_back(near(rng));
+    }
+
+    auto bench = [&](const std::vector<std::vector<Key>> &requests,
+                     const char *workload) {
+        auto start = clock_type::now();
+        for (auto &request : requests)
+            index->multi_get(request);
+        auto multi_us = elapsed_us(start);
+        start = clock_type::now();
+        for (auto &request : requests) {
+            for (auto &key : request)
+                index->search_record(key);
+        }
+        auto single_us = elapsed_us(start);
+        std::cout << "[ BENCH    ] " << rounds << " requests of " << batch
+                  << " " << workload << ": " << multi_us
+                  << " us, by single lookups " << single_us << " us"
+                  << std::endl;
+    };
+    bench(requests, "random keys");
+    bench(clustered, "close keys");
+    // most leaves miss, the misses of a level are read together.
+    ASSERT_EQ(ErrorCode::Success, pool->resize(100));
+    bench(requests, "random keys, 100 frames");
+    std::filesystem::remove("bench.db");
+}
+
+TEST(IndexBench, InsertBatch) {
+    auto batched = Index::make_index(0, "bench.db", int_key, int_fields,
+                                     std::cerr);
+    auto single = Index::make_index(1, "bench1.db", int_key, int_fields,
+                                    std::cerr);
+
+    const int n = 100000, batch = 5000;
+    std::vector<std::pair<Key, Column>> rows;
+    for (int i = 0; i < n; i++)
+        rows.push_back({i, {i * 3}});
+    auto rng = std::default_random_engine{};
+    std::shuffle(std::begin(rows), std::end(rows), rng);
+
+    auto start = clock_type::now();
+    for (int i = 0; i < n; i += batch)
+        batched->insert_batch(
+            std::span(rows).subspan(i, std::min(batch, n - i)));
+    auto batch_us = elapsed_us(start);
+    start = clock_type::now();
+    for (auto &row : rows)
+        single->insert_record(row.first, row.second);
+    auto single_us = elapsed_us(start);
+    std::cout << "[ BENCH    ] " << n << " rows in batches of " << batch
+              << ": " << batch_us << " us, row by row " << single_us << " us"
+              << std::endl;
+    std::filesystem::remove("bench.db");
+    std::filesystem::remove("bench1.db");
+}
+
+TEST(IndexBench, ConcurrentReads) {
+    auto index = Index::make_index(0, "bench.db", int_key, int_fields,
+                                   std::cerr);
+    const int n = 4000;
+    for (int i = 0; i < n; i++)
+        ASSERT_EQ(ErrorCode::Success, index->insert_record(i, {90}));
+
+    // read-only throughput.
+    for (int threads = 1; threads <= 4; threads *= 2) {
+        const int lookups = 20000;
+        auto start = clock_type::now();
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([&, t]() {
+                auto rng = std::default_random_engine(t);
+                std::uniform_int_distribution<int> dist(0, n - 1);
+                for (int i = 0; i < lookups; i++)
+                    index->search_record(dist(rng));
+            });
+        }
+        for (auto &worker : workers)
+            worker.join();
+        std::chrono::duration<double> elapsed = clock_type::now() - start;
+        std::cout << "[ BENCH    ] " << threads << " reader(s): "
+                  << static_cast<int>(threads * lookups / elapsed.count())
+                  << " lookups/s" << std::endl;
+    }
+    std::filesystem::remove("bench.db");
+}
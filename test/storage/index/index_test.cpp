@@ -1,9 +1,14 @@
 #include "error.h"
 #include "index/index.h"
+#include "index/index_builder.h"
+#include "index/index_iterator.h"
 #include "types.h"
+#include <atomic>
 #include <filesystem>
+#include <format>
 #include <gtest/gtest.h>
 #include <random>
+#include <thread>
 #include <vector>
 
 using namespace storage;
@@ -152,3 +157,966 @@ TEST(IndexTest, ManyDelete) {
     }
     std::filesystem::remove("test.db");
 }
+
+TEST(IndexTest, GetCursor) {
+    KeyMeta key_meta = {"id", storage::key_t(KeyType::Int)};
+    FieldMeta field_meta = {"score", storage::key_t(KeyType::Int)};
+    std::vector<FieldMeta> fields_meta = {field_meta};
+
+    auto index =
+        Index::make_index(0, "test.db", key_meta, fields_meta, std::cerr);
+
+    std::vector<int> keys;
+    for (int i = 0; i < 1000; i++)
+        keys.push_back(i * 10);
+    auto rng = std::default_random_engine{};
+    std::shuffle(std::begin(keys), std::end(keys), rng);
+    for (auto key : keys) {
+        ASSERT_EQ(ErrorCode::Success, index->insert_record(key, {key}));
+    }
+
+    // the record whose key is <= the desired one.
+    for (int i = 0; i < 1000; i++) {
+        auto exact = index->get_cursor(i * 10);
+        ASSERT_EQ(true, exact.has_value());
+        ASSERT_EQ(Key{i * 10}, exact.value().record.key);
+        auto after = index->get_cursor(i * 10 + 5);
+        ASSERT_EQ(true, after.has_value());
+        ASSERT_EQ(Key{i * 10}, after.value().record.key);
+        ASSERT_EQ(Column{i * 10}, after.value().record.value);
+    }
+    // the first record if there is none.
+    auto before = index->get_cursor(-5);
+    ASSERT_EQ(true, before.has_value());
+    ASSERT_EQ(Key{0}, before.value().record.key);
+    ASSERT_EQ(ErrorCode::KeyNotFound, index->search_record(5).error());
+    ASSERT_EQ(ErrorCode::InvalidKeyType,
+              index->search_record(std::string("5")).error());
+    std::filesystem::remove("test.db");
+}
+
+TEST(IndexTest, CompositeKey) {
+    std::vector<KeyMeta> key_meta = {
+        {"tenant_id", storage::key_t(KeyType::Int)},
+        {"timestamp", storage::key_t(KeyType::Double), KeyOrder::Desc},
+        {"event_id", storage::key_t(KeyType::String)}};
+    FieldMeta field_meta = {"score", storage::key_t(KeyType::Int)};
+    std::vector<FieldMeta> fields_meta = {field_meta};
+
+    auto index =
+        Index::make_index(0, "test.db", key_meta, fields_meta, std::cerr);
+    auto &meta = index->record_meta();
+
+    std::vector<Key> keys;
+    for (int tenant = 0; tenant < 10; tenant++) {
+        for (int time = 0; time < 50; time++) {
+            for (auto event : {"a", "b"})
+                keys.push_back(meta.make_key({tenant, time * 1.5, event}));
+        }
+    }
+    auto rng = std::default_random_engine{};
+    std::shuffle(std::begin(keys), std::end(keys), rng);
+    for (size_t i = 0; i < keys.size(); i++) {
+        ASSERT_EQ(ErrorCode::Success,
+                  index->insert_record(keys[i], {int(i)}));
+    }
+    for (size_t i = 0; i < keys.size(); i++) {
+        auto result = index->search_record(keys[i]);
+        ASSERT_EQ(true, result.has_value());
+        ASSERT_EQ(Column{int(i)}, result.value().value);
+    }
+
+    // all the rows of a tenant, the latest first.
+    std::vector<Key> scanned;
+    ASSERT_EQ(ErrorCode::Success,
+              index->scan_prefix(meta.make_key({7}),
+                                 [&](LeafClusteredRecord &record) {
+                                     scanned.push_back(record.key);
+                                 }));
+    ASSERT_EQ(100, scanned.size());
+    for (int time = 49, i = 0; time >= 0; time--) {
+        for (auto event : {"a", "b"})
+            ASSERT_EQ(Key{meta.make_key({7, time * 1.5, event})},
+                      scanned[i++]);
+    }
+    scanned.clear();
+    ASSERT_EQ(ErrorCode::Success,
+              index->scan_prefix(meta.make_key({3, 12.0}),
+                                 [&](LeafClusteredRecord &record) {
+                                     scanned.push_back(record.key);
+                                 }));
+    ASSERT_EQ(2, scanned.size());
+
+    // the columns must be of the types and the orders of the key.
+    ASSERT_EQ(ErrorCode::InvalidKeyType,
+              index->search_record(CompositeKey({7, 1.5, "a"})).error());
+    ASSERT_EQ(ErrorCode::InvalidKeyType,
+              index->insert_record(meta.make_key({7, 1.5}), {0}));
+    ASSERT_EQ(ErrorCode::InvalidKeyType,
+              index->insert_record(meta.make_key({7, 1, "a"}), {0}));
+    ASSERT_EQ(ErrorCode::InvalidKeyType, index->insert_record(7, {0}));
+
+    for (auto &key : keys)
+        ASSERT_EQ(ErrorCode::Success, index->remove_record(key));
+    std::filesystem::remove("test.db");
+}
+
+TEST(IndexTest, UrlKeys) {
+    KeyMeta key_meta = {"url", storage::key_t(KeyType::String)};
+    FieldMeta field_meta = {"hits", storage::key_t(KeyType::Int)};
+    std::vector<FieldMeta> fields_meta = {field_meta};
+
+    auto index =
+        Index::make_index(0, "test.db", key_meta, fields_meta, std::cerr);
+
+    // urls sharing long prefixes page by page.
+    std::vector<std::string> urls;
+    for (int tenant = 0; tenant < 20; tenant++) {
+        for (int user = 0; user < 50; user++) {
+            for (auto path : {"/events/click", "/events/view", "/profile",
+                              "/settings/notifications", "/sessions"}) {
+                urls.push_back(std::format(
+                    "https://www.example.com/tenants/{:04}/users/{:06}{}",
+                    tenant, user, path));
+            }
+        }
+    }
+    auto rng = std::default_random_engine{};
+    std::shuffle(std::begin(urls), std::end(urls), rng);
+    size_t full_bytes = 0;
+    for (size_t i = 0; i < urls.size(); i++) {
+        ASSERT_EQ(ErrorCode::Success,
+                  index->insert_record(urls[i], {int(i)}));
+        full_bytes += RecordView::encoded_len(Key{urls[i]}, Column{int(i)}) +
+                      Frame::SLOT_LEN;
+    }
+    for (size_t i = 0; i < urls.size(); i++) {
+        auto result = index->search_record(urls[i]);
+        ASSERT_EQ(true, result.has_value());
+        ASSERT_EQ(Column{int(i)}, result.value().value);
+    }
+
+    ASSERT_LT(index->page_usage().used_bytes, full_bytes);
+
+    // a key out of the key prefix of its page.
+    ASSERT_EQ(ErrorCode::Success, index->insert_record(std::string("h"), {0}));
+    ASSERT_EQ(ErrorCode::Success, index->insert_record(std::string("z"), {0}));
+    for (size_t i = 0; i < urls.size(); i += 2)
+        ASSERT_EQ(ErrorCode::Success, index->remove_record(urls[i]));
+    for (size_t i = 0; i < urls.size(); i++)
+        ASSERT_EQ(i % 2 == 1, index->search_record(urls[i]).has_value());
+    ASSERT_EQ(true, index->search_record(std::string("h")).has_value());
+    ASSERT_EQ(true, index->search_record(std::string("z")).has_value());
+    std::filesystem::remove("test.db");
+}
+
+TEST(IndexTest, LongKeys) {
+    KeyMeta key_meta = {"path", storage::key_t(KeyType::String)};
+    FieldMeta field_meta = {"size", storage::key_t(KeyType::Int)};
+    std::vector<FieldMeta> fields_meta = {field_meta};
+
+    auto index =
+        Index::make_index(0, "test.db", key_meta, fields_meta, std::cerr);
+
+    // a few keys to a page, and separators as long as the keys in the
+    // internal pages.
+    auto rng = std::default_random_engine{};
+    std::uniform_int_distribution<int> len(500, 1200);
+    std::vector<std::string> keys;
+    for (int i = 0; i < 400; i++) {
+        std::string key(len(rng), 'a');
+        key += std::format("{:04}", (i * 7919) % 400);
+        keys.push_back(std::move(key));
+    }
+    for (size_t i = 0; i < keys.size(); i++)
+        ASSERT_EQ(ErrorCode::Success, index->insert_record(keys[i], {int(i)}));
+
+    // a record larger than a page fails without touching the index.
+    std::string huge(Page::payload_len(), 'b');
+    ASSERT_EQ(ErrorCode::NodeFull, index->insert_record(huge, {0}));
+    ASSERT_EQ(false, index->search_record(huge).has_value());
+    // so does one whose length doesn't fit in 16 bits.
+    std::string wrapping(UINT16_MAX + 2, 'c');
+    ASSERT_EQ(ErrorCode::NodeFull, index->insert_record(wrapping, {0}));
+    ASSERT_EQ(std::vector<ErrorCode>{ErrorCode::NodeFull},
+              index->insert_batch(
+                  std::vector<std::pair<Key, Column>>{{wrapping, {0}}}));
+    ASSERT_EQ(false, index->search_record(wrapping).has_value());
+    // the builder checks the whole record too, not only its key.
+    std::string almost(Page::payload_len() - 8, 'd');
+    ASSERT_EQ(ErrorCode::NodeFull, index->insert_record(almost, {0}));
+    auto built =
+        Index::make_index(1, "test1.db", key_meta, fields_meta, std::cerr);
+    IndexBuilder builder(*built, std::filesystem::temp_directory_path(),
+                         256 << 10, 1);
+    bool sent = false;
+    ASSERT_EQ(ErrorCode::NodeFull,
+              builder.build([&](Key &key, Column &value) {
+                  if (sent)
+                      return false;
+                  key = almost;
+                  value = {0};
+                  return sent = true;
+              }));
+    ASSERT_EQ(false, built->search_record(almost).has_value());
+    std::filesystem::remove("test1.db");
+
+    for (size_t i = 0; i < keys.size(); i++) {
+        auto result = index->search_record(keys[i]);
+        ASSERT_EQ(true, result.has_value());
+        ASSERT_EQ(Column{int(i)}, result.value().value);
+    }
+    for (size_t i = 0; i < keys.size(); i += 2)
+        ASSERT_EQ(ErrorCode::Success, index->remove_record(keys[i]));
+    for (size_t i = 0; i < keys.size(); i++)
+        ASSERT_EQ(i % 2 == 1, index->search_record(keys[i]).has_value());
+    std::filesystem::remove("test.db");
+}
+
+TEST(IndexTest, UpdateChurn) {
+    KeyMeta key_meta = {"user", storage::key_t(KeyType::String)};
+    FieldMeta field_meta = {"visits", storage::key_t(KeyType::Int)};
+    std::vector<FieldMeta> fields_meta = {field_meta};
+
+    auto index =
+        Index::make_index(0, "test.db", key_meta, fields_meta, std::cerr);
+
+    std::vector<std::string> users;
+    for (int i = 0; i < 3000; i++)
+        users.push_back(std::format("user:{:06}", i));
+    auto rng = std::default_random_engine{};
+    std::shuffle(std::begin(users), std::end(users), rng);
+    for (auto &user : users)
+        ASSERT_EQ(ErrorCode::Success, index->insert_record(user, {0}));
+    auto before = index->page_usage();
+
+    // an update is a remove and an insert of the key, the deleted records are
+    // taken back in place.
+    for (int round = 1; round <= 10; round++) {
+        std::shuffle(std::begin(users), std::end(users), rng);
+        for (auto &user : users) {
+            ASSERT_EQ(ErrorCode::Success, index->remove_record(user));
+            ASSERT_EQ(ErrorCode::Success, index->insert_record(user, {round}));
+        }
+    }
+    auto after = index->page_usage();
+    ASSERT_LE(after.pages, before.pages);
+    ASSERT_LE(after.used_bytes + after.deleted_bytes,
+              after.pages * Page::payload_len());
+    for (auto &user : users) {
+        auto result = index->search_record(user);
+        ASSERT_EQ(true, result.has_value());
+        ASSERT_EQ(Column{10}, result.value().value);
+    }
+    std::filesystem::remove("test.db");
+}
+
+TEST(IndexTest, BulkLoad) {
+    KeyMeta key_meta = {"id", storage::key_t(KeyType::Int)};
+    FieldMeta field_meta = {"score", storage::key_t(KeyType::Int)};
+    std::vector<FieldMeta> fields_meta = {field_meta};
+
+    // even keys, the odd ones go in afterwards.
+    const int n = 100000;
+    auto source = [](int &i, int end) {
+        return [&i, end](Key &key, Column &value) {
+            if (i >= end)
+                return false;
+            key = i * 2;
+            value = {i};
+            i++;
+            return true;
+        };
+    };
+
+    auto loaded =
+        Index::make_index(0, "test.db", key_meta, fields_meta, std::cerr);
+    int i = 0;
+    ASSERT_EQ(ErrorCode::Success, loaded->bulk_load(source(i, n)));
+
+    auto inserted =
+        Index::make_index(1, "test1.db", key_meta, fields_meta, std::cerr);
+    for (int i = 0; i < n; i++)
+        ASSERT_EQ(ErrorCode::Success, inserted->insert_record(i * 2, {i}));
+    ASSERT_LT(loaded->page_usage().pages, inserted->page_usage().pages);
+
+    for (int i = 0; i < n; i++) {
+        auto result = loaded->search_record(i * 2);
+        ASSERT_EQ(true, result.has_value()) << i;
+        ASSERT_EQ(Column{i}, result.value().value);
+    }
+    ASSERT_EQ(false, loaded->search_record(1).has_value());
+    ASSERT_EQ(ErrorCode::IndexNotEmpty, loaded->bulk_load(source(i, n)));
+
+    // the loaded pages split and merge like any other ones.
+    for (int i = 1; i < 4000; i += 2)
+        ASSERT_EQ(ErrorCode::Success, loaded->insert_record(i, {i}));
+    for (int i = 0; i < 4000; i += 4)
+        ASSERT_EQ(ErrorCode::Success, loaded->remove_record(i));
+    for (int i = 0; i < 4000; i++)
+        ASSERT_EQ(i % 4 != 0, loaded->search_record(i).has_value()) << i;
+    std::filesystem::remove("test.db");
+    std::filesystem::remove("test1.db");
+
+    // a row out of order stops the load, the rows before it are in.
+    auto partial =
+        Index::make_index(2, "test2.db", key_meta, fields_meta, std::cerr);
+    std::vector<int> keys = {1, 2, 3, 5, 4, 6};
+    size_t next = 0;
+    ASSERT_EQ(ErrorCode::InvalidInsertPos,
+              partial->bulk_load([&](Key &key, Column &value) {
+                  if (next == keys.size())
+                      return false;
+                  key = keys[next++];
+                  value = {0};
+                  return true;
+              }));
+    for (int key : {1, 2, 3, 5})
+        ASSERT_EQ(true, partial->search_record(key).has_value());
+    ASSERT_EQ(false, partial->search_record(4).has_value());
+    std::filesystem::remove("test2.db");
+}
+
+TEST(IndexTest, BuildFromUnsortedRows) {
+    KeyMeta key_meta = {"id", storage::key_t(KeyType::Int)};
+    FieldMeta field_meta = {"row", storage::key_t(KeyType::Int)};
+    std::vector<FieldMeta> fields_meta = {field_meta};
+
+    // a dump in no order, with keys repeated.
+    const int n = 60000;
+    std::vector<int> keys;
+    auto rng = std::default_random_engine{};
+    std::uniform_int_distribution<int> key(0, 50000);
+    for (int i = 0; i < n; i++)
+        keys.push_back(key(rng));
+
+    auto inserted =
+        Index::make_index(0, "test.db", key_meta, fields_meta, std::cerr);
+    for (int i = 0; i < n; i++) {
+        auto ec = inserted->insert_record(keys[i], {i});
+        ASSERT_TRUE(ec == ErrorCode::Success ||
+                    ec == ErrorCode::KeyAlreadyExist);
+    }
+
+    // a budget much smaller than the input, most runs spill.
+    auto built =
+        Index::make_index(1, "test1.db", key_meta, fields_meta, std::cerr);
+    IndexBuilder builder(*built, std::filesystem::temp_directory_path(),
+                         256 << 10, 4);
+    int next = 0;
+    ASSERT_EQ(ErrorCode::Success,
+              builder.build([&](Key &key, Column &value) {
+                  if (next == n)
+                      return false;
+                  key = keys[next];
+                  value = {next++};
+                  return true;
+              }));
+    auto &stats = builder.stats();
+    stats.export_text(std::cerr);
+    ASSERT_EQ(n, stats.rows);
+    ASSERT_GT(stats.spilled_runs, 0);
+
+    // the first row of a key wins, as with the inserts.
+    size_t distinct = 0;
+    for (int k = 0; k <= 50000; k++) {
+        auto expected = inserted->search_record(k);
+        auto result = built->search_record(k);
+        ASSERT_EQ(expected.has_value(), result.has_value()) << k;
+        if (!expected)
+            continue;
+        distinct++;
+        ASSERT_EQ(expected.value().value, result.value().value) << k;
+    }
+    ASSERT_EQ(n - distinct, stats.duplicates);
+    std::filesystem::remove("test.db");
+    std::filesystem::remove("test1.db");
+}
+
+TEST(IndexTest, RangeScan) {
+    KeyMeta key_meta = {"id", storage::key_t(KeyType::Int)};
+    FieldMeta field_meta = {"score", storage::key_t(KeyType::Int)};
+    std::vector<FieldMeta> fields_meta = {field_meta};
+
+    auto index =
+        Index::make_index(0, "test.db", key_meta, fields_meta, std::cerr);
+
+    // even keys only, the odd ones are the bounds between them.
+    const int n = 20000;
+    std::vector<int> keys;
+    for (int i = 0; i < n; i += 2)
+        keys.push_back(i);
+    auto rng = std::default_random_engine{};
+    std::shuffle(std::begin(keys), std::end(keys), rng);
+    for (auto key : keys)
+        ASSERT_EQ(ErrorCode::Success, index->insert_record(key, {key}));
+
+    auto scan = [&](ScanRange range) {
+        std::vector<int> keys;
+        IndexIterator it(*index, std::move(range));
+        LeafClusteredRecord record;
+        while (true) {
+            auto more = it.next(record);
+            EXPECT_EQ(true, more.has_value());
+            if (!more || !more.value())
+                break;
+            keys.push_back(std::get<int>(record.key));
+            EXPECT_EQ(Column{keys.back()}, record.value);
+        }
+        return keys;
+    };
+    auto expected = [](int from, int to) {
+        std::vector<int> keys;
+        for (int i = from; i <= to; i += 2)
+            keys.push_back(i);
+        return keys;
+    };
+
+    ASSERT_EQ(expected(0, n - 2), scan({}));
+    ASSERT_EQ(expected(1000, 3000), scan({1000, true, 3000, true}));
+    ASSERT_EQ(expected(1002, 2998), scan({1000, false, 3000, false}));
+    ASSERT_EQ(expected(1000, 2998), scan({999, false, 2999, true}));
+    ASSERT_EQ(expected(0, 500), scan({std::nullopt, true, 500, true}));
+    ASSERT_EQ(expected(n - 500, n - 2),
+              scan({n - 500, true, std::nullopt, true}));
+    ASSERT_EQ(expected(1000, 1012), scan({1000, true, 3000, true, 7}));
+    ASSERT_EQ(std::vector<int>{}, scan({1001, true, 1001, true}));
+    ASSERT_EQ(std::vector<int>{}, scan({1000, false, 1000, true}));
+    ASSERT_EQ(std::vector<int>{}, scan({n, true, std::nullopt, true}));
+    ASSERT_EQ(std::vector<int>{}, scan({0, true, std::nullopt, true, 0}));
+
+    // batches never exceed the batch size, and cross the leaves.
+    IndexIterator it(*index, {100, true, 4000, true, 1000, 64});
+    std::vector<LeafClusteredRecord> batch;
+    size_t records = 0, batches = 0;
+    while (true) {
+        auto more = it.next_batch(batch);
+        ASSERT_EQ(true, more.has_value());
+        if (!more.value())
+            break;
+        ASSERT_LE(batch.size(), 64);
+        ASSERT_EQ(100 + 2 * records, std::get<int>(batch.front().key));
+        records += batch.size();
+        batches++;
+    }
+    ASSERT_EQ(1000, records);
+    ASSERT_EQ(16, batches);
+
+    IndexIterator bad(*index, {std::string("a"), true, std::nullopt, true});
+    ASSERT_EQ(ErrorCode::InvalidKeyType, bad.next_batch(batch).error());
+
+    // ranges starting all over the leaves.
+    for (int i = 0; i < 200; i++)
+        ASSERT_EQ(expected(i * 50, i * 50 + 198),
+                  scan({i * 50, true, i * 50 + 198, true}));
+
+    // the odd keys go in during the scans: the even keys are all visited, in
+    // order, whatever the splits under the scans.
+    std::atomic<bool> writing = true;
+    std::atomic<int> failures = 0;
+    std::thread reader([&]() {
+        while (writing) {
+            IndexIterator it(*index, {2000, true, 12000, false, n, 16});
+            LeafClusteredRecord record;
+            int last = 1999, evens = 0;
+            while (true) {
+                auto more = it.next(record);
+                if (!more) {
+                    failures++;
+                    break;
+                }
+                if (!more.value())
+                    break;
+                int key = std::get<int>(record.key);
+                if (key <= last || key >= 12000)
+                    failures++;
+                evens += key % 2 == 0;
+                last = key;
+            }
+            if (evens != 5000)
+                failures++;
+        }
+    });
+    std::vector<int> odd;
+    for (int i = 1; i < n; i += 2)
+        odd.push_back(i);
+    std::shuffle(std::begin(odd), std::end(odd), rng);
+    for (auto key : odd)
+        ASSERT_EQ(ErrorCode::Success, index->insert_record(key, {key}));
+    writing = false;
+    reader.join();
+    ASSERT_EQ(0, failures);
+    ASSERT_EQ(999, scan({1000, false, 2000, false}).size());
+    std::filesystem::remove("test.db");
+}
+
+TEST(IndexTest, ReverseRangeScan) {
+    KeyMeta key_meta = {"time", storage::key_t(KeyType::Int)};
+    FieldMeta field_meta = {"event", storage::key_t(KeyType::Int)};
+    std::vector<FieldMeta> fields_meta = {field_meta};
+
+    auto index =
+        Index::make_index(0, "test.db", key_meta, fields_meta, std::cerr);
+
+    // events at even times, the odd ones are the bounds between them.
+    const int n = 20000;
+    std::vector<int> keys;
+    for (int i = 0; i < n; i += 2)
+        keys.push_back(i);
+    auto rng = std::default_random_engine{};
+    std::shuffle(std::begin(keys), std::end(keys), rng);
+    for (auto key : keys)
+        ASSERT_EQ(ErrorCode::Success, index->insert_record(key, {key}));
+
+    auto scan = [&](ScanRange range) {
+        range.reverse = true;
+        std::vector<int> keys;
+        IndexIterator it(*index, std::move(range));
+        LeafClusteredRecord record;
+        while (true) {
+            auto more = it.next(record);
+            EXPECT_EQ(true, more.has_value());
+            if (!more || !more.value())
+                break;
+            keys.push_back(std::get<int>(record.key));
+            EXPECT_EQ(Column{keys.back()}, record.value);
+        }
+        return keys;
+    };
+    auto expected = [](int from, int to) {
+        std::vector<int> keys;
+        for (int i = from; i >= to; i -= 2)
+            keys.push_back(i);
+        return keys;
+    };
+
+    ASSERT_EQ(expected(n - 2, 0), scan({}));
+    ASSERT_EQ(expected(n - 2, n - 20), scan({.limit = 10}));
+    ASSERT_EQ(expected(3000, 1000), scan({.lower = 1000, .upper = 3000}));
+    ASSERT_EQ(expected(2998, 1002),
+              scan({.lower = 1000,
+                    .lower_inclusive = false,
+                    .upper = 3000,
+                    .upper_inclusive = false}));
+    ASSERT_EQ(expected(2998, 1000),
+              scan({.lower = 999, .upper = 2999, .upper_inclusive = false}));
+    ASSERT_EQ(expected(500, 0), scan({.upper = 500}));
+    ASSERT_EQ(expected(n - 2, n - 500), scan({.lower = n - 500}));
+    ASSERT_EQ(expected(3000, 2988), scan({.upper = 3000, .limit = 7}));
+    ASSERT_EQ(std::vector<int>{}, scan({.lower = 1001, .upper = 1001}));
+    ASSERT_EQ(std::vector<int>{},
+              scan({.upper = 1000, .upper_inclusive = false, .limit = 0}));
+    ASSERT_EQ(std::vector<int>{}, scan({.upper = -1}));
+
+    // batches never exceed the batch size, and cross the leaves.
+    IndexIterator it(*index, {.upper = 4000,
+                              .limit = 1000,
+                              .batch = 64,
+                              .reverse = true});
+    std::vector<LeafClusteredRecord> batch;
+    size_t records = 0, batches = 0;
+    while (true) {
+        auto more = it.next_batch(batch);
+        ASSERT_EQ(true, more.has_value());
+        if (!more.value())
+            break;
+        ASSERT_LE(batch.size(), 64);
+        ASSERT_EQ(4000 - 2 * records, std::get<int>(batch.front().key));
+        records += batch.size();
+        batches++;
+    }
+    ASSERT_EQ(1000, records);
+    ASSERT_EQ(16, batches);
+
+    std::vector<int> traversed;
+    index->traverse_r([&](LeafClusteredRecord &record) {
+        traversed.push_back(std::get<int>(record.key));
+    });
+    ASSERT_EQ(expected(n - 2, 0), traversed);
+
+    // the latest events, read backwards from the end.
+    ASSERT_EQ(expected(n - 2, n - 200), scan({.limit = 100}));
+
+    // the odd keys go in and out during the scans: the even keys are all
+    // visited, in order, whatever the splits and merges under the scans.
+    std::atomic<bool> writing = true;
+    std::atomic<int> failures = 0;
+    std::thread reader([&]() {
+        while (writing) {
+            IndexIterator it(*index, {.lower = 2000,
+                                      .upper = 12000,
+                                      .upper_inclusive = false,
+                                      .batch = 16,
+                                      .reverse = true});
+            LeafClusteredRecord record;
+            int last = 12000, evens = 0;
+            while (true) {
+                auto more = it.next(record);
+                if (!more) {
+                    failures++;
+                    break;
+                }
+                if (!more.value())
+                    break;
+                int key = std::get<int>(record.key);
+                if (key >= last || key < 2000)
+                    failures++;
+                evens += key % 2 == 0;
+                last = key;
+            }
+            if (evens != 5000)
+                failures++;
+        }
+    });
+    std::vector<int> odd;
+    for (int i = 1; i < n; i += 2)
+        odd.push_back(i);
+    std::shuffle(std::begin(odd), std::end(odd), rng);
+    for (auto key : odd)
+        ASSERT_EQ(ErrorCode::Success, index->insert_record(key, {key}));
+    std::shuffle(std::begin(odd), std::end(odd), rng);
+    for (auto key : odd)
+        ASSERT_EQ(ErrorCode::Success, index->remove_record(key));
+    writing = false;
+    reader.join();
+    ASSERT_EQ(0, failures);
+    ASSERT_EQ(expected(n - 2, 0), scan({}));
+    std::filesystem::remove("test.db");
+}
+
+TEST(IndexTest, MultiGet) {
+    KeyMeta key_meta = {"id", storage::key_t(KeyType::Int)};
+    FieldMeta field_meta = {"score", storage::key_t(KeyType::Int)};
+    std::vector<FieldMeta> fields_meta = {field_meta};
+
+    // a pool of its own, resized without touching the shared one.
+    auto pool = std::make_shared<BufferPoolManager>(config::DEFAULT_POOL_SIZE);
+    auto index = Index::make_index(0, "test.db", key_meta, fields_meta,
+                                   std::cerr, pool);
+
+    // even keys only, the odd ones are misses.
+    const int n = 100000;
+    std::vector<int> keys;
+    for (int i = 0; i < n; i += 2)
+        keys.push_back(i);
+    auto rng = std::default_random_engine{};
+    std::shuffle(std::begin(keys), std::end(keys), rng);
+    for (auto key : keys)
+        ASSERT_EQ(ErrorCode::Success, index->insert_record(key, {key}));
+
+    // requests of random keys, some of them repeated, and of keys close to
+    // each other.
+    const int rounds = 200, batch = 500;
+    std::uniform_int_distribution<int> dist(-10, n + 10);
+    std::vector<std::vector<Key>> requests(rounds), clustered(rounds);
+    for (auto &request : requests) {
+        for (int i = 0; i < batch; i++)
+            request.push_back(dist(rng));
+        request[batch - 1] = request[0];
+    }
+    for (auto &request : clustered) {
+        int from = dist(rng);
+        std::uniform_int_distribution<int> near(from, from + batch * 4);
+        for (int i = 0; i < batch; i++)
+            request.push_back(near(rng));
+    }
+    auto check = [&](const std::vector<Key> &request) {
+        auto results = index->multi_get(request);
+        ASSERT_EQ(request.size(), results.size());
+        for (size_t i = 0; i < request.size(); i++) {
+            int key = std::get<int>(request[i]);
+            bool hit = key >= 0 && key < n && key % 2 == 0;
+            ASSERT_EQ(hit, results[i].has_value()) << key;
+            if (hit)
+                ASSERT_EQ(Column{key}, results[i].value().value);
+            else
+                ASSERT_EQ(ErrorCode::KeyNotFound, results[i].error());
+        }
+    };
+    for (auto &request : requests)
+        check(request);
+    for (auto &request : clustered)
+        check(request);
+    ASSERT_EQ(0, index->multi_get({}).size());
+    auto mixed = index->multi_get(std::vector<Key>{std::string("4"), 4});
+    ASSERT_EQ(ErrorCode::InvalidKeyType, mixed[0].error());
+    ASSERT_EQ(Column{4}, mixed[1].value().value);
+
+    // most leaves miss, the misses of a level are read together.
+    ASSERT_EQ(ErrorCode::Success, pool->resize(100));
+    for (auto &request : requests)
+        check(request);
+
+    // the pages split under the lookups of the keys already there.
+    std::atomic<bool> writing = true;
+    std::atomic<int> failures = 0;
+    std::thread reader([&]() {
+        std::vector<Key> request;
+        for (int i = 0; i < n; i += 20)
+            request.push_back(i);
+        while (writing) {
+            for (auto &result : index->multi_get(request)) {
+                if (!result)
+                    failures++;
+            }
+        }
+    });
+    for (int i = 1; i < n / 4; i += 2)
+        ASSERT_EQ(ErrorCode::Success, index->insert_record(i, {i}));
+    writing = false;
+    reader.join();
+    ASSERT_EQ(0, failures);
+    std::filesystem::remove("test.db");
+}
+
+TEST(IndexTest, InsertBatch) {
+    KeyMeta key_meta = {"id", storage::key_t(KeyType::Int)};
+    FieldMeta field_meta = {"score", storage::key_t(KeyType::Int)};
+    std::vector<FieldMeta> fields_meta = {field_meta};
+
+    auto batched =
+        Index::make_index(0, "test.db", key_meta, fields_meta, std::cerr);
+    auto single =
+        Index::make_index(1, "test2.db", key_meta, fields_meta, std::cerr);
+
+    const int n = 100000, batch = 5000;
+    std::vector<std::pair<Key, Column>> rows;
+    for (int i = 0; i < n; i++)
+        rows.push_back({i, {i * 3}});
+    auto rng = std::default_random_engine{};
+    std::shuffle(std::begin(rows), std::end(rows), rng);
+
+    for (int i = 0; i < n; i += batch) {
+        auto results = batched->insert_batch(
+            std::span(rows).subspan(i, std::min(batch, n - i)));
+        for (auto result : results)
+            ASSERT_EQ(ErrorCode::Success, result);
+    }
+    for (auto &row : rows)
+        ASSERT_EQ(ErrorCode::Success,
+                  single->insert_record(row.first, row.second));
+
+    // the same records. the rows of a batch go into a leaf in key order, the
+    // halves of a split are filled less evenly than by random inserts.
+    std::vector<LeafClusteredRecord> records;
+    LeafClusteredRecord record;
+    IndexIterator iterator(*batched, {});
+    while (iterator.next(record).value())
+        records.push_back(record);
+    ASSERT_EQ(n, records.size());
+    for (int i = 0; i < n; i++) {
+        ASSERT_EQ(Key{i}, records[i].key);
+        ASSERT_EQ(Column{i * 3}, records[i].value);
+    }
+    auto batched_pages = batched->page_usage().pages;
+    auto single_pages = single->page_usage().pages;
+    ASSERT_LE(batched_pages, single_pages * 5 / 4);
+
+    // the first row of a key wins, within the batch and against the index.
+    std::vector<std::pair<Key, Column>> mixed = {
+        {n + 1, {1}}, {std::string("x"), {0}}, {5, {0}},
+        {n + 1, {2}}, {n, {0}}};
+    auto results = batched->insert_batch(mixed);
+    std::vector<ErrorCode> expected = {
+        ErrorCode::Success, ErrorCode::InvalidKeyType,
+        ErrorCode::KeyAlreadyExist, ErrorCode::KeyAlreadyExist,
+        ErrorCode::Success};
+    ASSERT_EQ(expected, results);
+    ASSERT_EQ(Column{1}, batched->search_record(n + 1).value().value);
+    ASSERT_EQ(Column{15}, batched->search_record(5).value().value);
+    ASSERT_EQ(0, batched->insert_batch({}).size());
+    std::filesystem::remove("test.db");
+    std::filesystem::remove("test2.db");
+
+    // long keys split a leaf for every few rows, a record larger than a page
+    // fails alone.
+    KeyMeta path_meta = {"path", storage::key_t(KeyType::String)};
+    auto paths =
+        Index::make_index(2, "test.db", path_meta, fields_meta, std::cerr);
+    std::uniform_int_distribution<int> len(500, 1200);
+    std::vector<std::pair<Key, Column>> long_rows;
+    for (int i = 0; i < 400; i++) {
+        std::string key(len(rng), 'a');
+        key += std::format("{:04}", (i * 7919) % 400);
+        long_rows.push_back({std::move(key), {i}});
+    }
+    std::string huge(Page::payload_len(), 'b');
+    long_rows.push_back({huge, {0}});
+    results = paths->insert_batch(long_rows);
+    for (size_t i = 0; i + 1 < long_rows.size(); i++) {
+        ASSERT_EQ(ErrorCode::Success, results[i]);
+        auto result = paths->search_record(long_rows[i].first);
+        ASSERT_EQ(true, result.has_value());
+        ASSERT_EQ(long_rows[i].second, result.value().value);
+    }
+    ASSERT_EQ(ErrorCode::NodeFull, results.back());
+    ASSERT_EQ(false, paths->search_record(huge).has_value());
+    std::filesystem::remove("test.db");
+}
+
+TEST(IndexTest, ProtectUpperLevels) {
+    KeyMeta key_meta = {"id", storage::key_t(KeyType::Int)};
+    FieldMeta field_meta = {"score", storage::key_t(KeyType::Int)};
+    std::vector<FieldMeta> fields_meta = {field_meta};
+
+    // a pool of its own, resized without touching the shared one.
+    auto pool = std::make_shared<BufferPoolManager>(config::DEFAULT_POOL_SIZE);
+    auto index = Index::make_index(0, "test.db", key_meta, fields_meta,
+                                   std::cerr, pool);
+
+    // pages a fifth full, three levels out of a few keys.
+    const int n = 10000;
+    int next = 0;
+    ASSERT_EQ(ErrorCode::Success, index->bulk_load(
+                                      [&](Key &key, Column &value) {
+                                          if (next == n)
+                                              return false;
+                                          key = next++;
+                                          value = {90};
+                                          return true;
+                                      },
+                                      20));
+    ASSERT_EQ(3, index->depth());
+    std::vector<int> keys;
+    for (int i = 0; i < n; i++)
+        keys.push_back(i);
+    auto rng = std::default_random_engine{};
+    std::shuffle(std::begin(keys), std::end(keys), rng);
+
+    // a pool much smaller than the index, leaf pages keep churning.
+    ASSERT_GT(index->page_usage().pages, 120);
+    ASSERT_EQ(ErrorCode::Success, pool->resize(60));
+    for (auto key : keys) {
+        ASSERT_EQ(true, index->search_record(key).has_value());
+    }
+    ASSERT_GT(pool->protected_size(), 0);
+
+    // the internal pages stay resident: a lookup reads at most the leaf.
+    std::shuffle(std::begin(keys), std::end(keys), rng);
+    for (auto key : keys) {
+        auto before = pool->stats().total.misses;
+        auto result = index->search_record(key);
+        ASSERT_EQ(true, result.has_value());
+        ASSERT_EQ(Column{90}, result.value().value);
+        ASSERT_LE(pool->stats().total.misses - before, 1);
+    }
+    std::filesystem::remove("test.db");
+}
+
+TEST(IndexTest, ConcurrentReads) {
+    KeyMeta key_meta = {"id", storage::key_t(KeyType::Int)};
+    FieldMeta field_meta = {"score", storage::key_t(KeyType::Int)};
+    std::vector<FieldMeta> fields_meta = {field_meta};
+
+    auto index =
+        Index::make_index(0, "test.db", key_meta, fields_meta, std::cerr);
+
+    // even keys are there from the start, odd keys come during the reads.
+    const int n = 4000;
+    std::vector<int> keys;
+    for (int i = 0; i < n; i += 2)
+        keys.push_back(i);
+    auto rng = std::default_random_engine{};
+    std::shuffle(std::begin(keys), std::end(keys), rng);
+    for (auto key : keys) {
+        ASSERT_EQ(ErrorCode::Success, index->insert_record(key, {90}));
+    }
+    // keep replacing pages under the readers.
+    ASSERT_EQ(ErrorCode::Success, index->pool()->resize(100));
+
+    std::atomic<bool> writing = true;
+    std::atomic<int> failures = 0;
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&, t]() {
+            auto rng = std::default_random_engine(t);
+            std::uniform_int_distribution<int> dist(0, n / 2 - 1);
+            while (writing) {
+                auto result = index->search_record(dist(rng) * 2);
+                if (!result || result.value().value != Column{90})
+                    failures++;
+            }
+        });
+    }
+
+    std::vector<int> odd;
+    for (int i = 1; i < n; i += 2)
+        odd.push_back(i);
+    std::shuffle(std::begin(odd), std::end(odd), rng);
+    for (auto key : odd) {
+        ASSERT_EQ(ErrorCode::Success, index->insert_record(key, {80}));
+    }
+    writing = false;
+    for (auto &reader : readers)
+        reader.join();
+    ASSERT_EQ(0, failures);
+
+    for (int i = 0; i < n; i++) {
+        auto result = index->search_record(i);
+        ASSERT_EQ(true, result.has_value());
+        ASSERT_EQ(Column{i % 2 ? 80 : 90}, result.value().value);
+    }
+
+    // the shared pool gets its frames back.
+    ASSERT_EQ(ErrorCode::Success,
+              index->pool()->resize(config::DEFAULT_POOL_SIZE));
+    std::filesystem::remove("test.db");
+}
+
+TEST(IndexTest, SharedPoolWriters) {
+    KeyMeta key_meta = {"id", storage::key_t(KeyType::Int)};
+    FieldMeta field_meta = {"score", storage::key_t(KeyType::Int)};
+    std::vector<FieldMeta> fields_meta = {field_meta};
+
+    // two indices write into a pool too small for both, taking each other's
+    // frames, while their lookups go on.
+    auto pool = std::make_shared<BufferPoolManager>(100);
+    std::vector<std::shared_ptr<Index>> indices = {
+        Index::make_index(0, "test.db", key_meta, fields_meta, std::cerr,
+                          pool),
+        Index::make_index(1, "test2.db", key_meta, fields_meta, std::cerr,
+                          pool)};
+
+    const int n = 20000;
+    std::atomic<int> failures = 0;
+    std::atomic<int> done = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 2; t++) {
+        threads.emplace_back([&, t]() {
+            std::vector<int> keys;
+            for (int i = 0; i < n; i++)
+                keys.push_back(i);
+            std::shuffle(std::begin(keys), std::end(keys),
+                         std::default_random_engine(t));
+            for (auto key : keys) {
+                if (indices[t]->insert_record(key, {key + t}) !=
+                    ErrorCode::Success)
+                    failures++;
+            }
+            done++;
+        });
+        threads.emplace_back([&, t]() {
+            auto rng = std::default_random_engine(t);
+            std::uniform_int_distribution<int> dist(0, n - 1);
+            while (done < 2) {
+                int key = dist(rng);
+                auto result = indices[t]->search_record(key);
+                if (result && result.value().value != Column{key + t})
+                    failures++;
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    ASSERT_EQ(0, failures);
+
+    for (int t = 0; t < 2; t++) {
+        for (int i = 0; i < n; i++) {
+            auto result = indices[t]->search_record(i);
+            ASSERT_EQ(true, result.has_value());
+            ASSERT_EQ(Column{i + t}, result.value().value);
+        }
+    }
+    std::filesystem::remove("test.db");
+    std::filesystem::remove("test2.db");
+}
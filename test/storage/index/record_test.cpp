@@ -1,9 +1,11 @@
 #include "cereal/archives/binary.hpp"
 #include "index/record.h"
+#include "index/record_view.h"
 #include "serialization.h"
 #include "types.h"
 #include <fstream>
 #include <gtest/gtest.h>
+#include <limits>
 
 using namespace storage;
 
@@ -106,3 +108,117 @@ TEST(RecordTest, SerializationTest) {
     }
     fs.close();
 }
+
+TEST(RecordTest, RecordViewTest) {
+    char page[256] = {0};
+
+    // leaf record
+    {
+        Column value = {true, 80, 1.5, "test"};
+        auto record = RecordView::write(page, Key{"key"}, value);
+        ASSERT_EQ(RecordView::encoded_len(Key{"key"}, value), record.length());
+
+        RecordView view(page, sizeof(page));
+        ASSERT_EQ(true, view.key().same_type(Key{"abc"}));
+        ASSERT_EQ(false, view.key().same_type(Key{1}));
+        ASSERT_EQ(0, view.key().compare(Key{"key"}));
+        ASSERT_GT(view.key().compare(Key{"ke"}), 0);
+        ASSERT_LT(view.key().compare(Key{"kez"}), 0);
+        ASSERT_EQ(value.size(), view.column().size());
+        ASSERT_EQ(Value{std::string("test")}, view.column().field(3));
+
+        auto materialized = view.materialize<LeafClusteredRecord>();
+        ASSERT_EQ(Key{"key"}, materialized.key);
+        ASSERT_EQ(value, materialized.value);
+
+        // copied into a page of the key prefix "ke".
+        char other[256] = {0};
+        auto copied = RecordView::copy(other, view, 2);
+        ASSERT_EQ(record.length() - 2, copied.length());
+        RecordView prefixed(other, sizeof(other), "ke");
+        ASSERT_EQ(std::string_view("y\0\0", 3), prefixed.key().suffix());
+        ASSERT_EQ(0, prefixed.key().compare(Key{"key"}));
+        ASSERT_LT(prefixed.key().compare(Key{"kez"}), 0);
+        ASSERT_EQ(true, prefixed.key().has_prefix("key"));
+        ASSERT_EQ(2, prefixed.key().common_prefix_len("kez"));
+        ASSERT_EQ(materialized.key,
+                  prefixed.materialize<LeafClusteredRecord>().key);
+        ASSERT_EQ(value, prefixed.column().column());
+    }
+    // internal record
+    {
+        RecordView::write(page, Key{-7}, page_id_t(33));
+
+        RecordView view(page, sizeof(page));
+        ASSERT_GT(view.key().compare(Key{-8}), 0);
+        ASSERT_EQ(page_id_t(33), view.child());
+        view.set_child(34);
+
+        auto materialized = view.materialize<InternalClusteredRecord>();
+        ASSERT_EQ(Key{-7}, materialized.key);
+        ASSERT_EQ(page_id_t(34), materialized.value);
+        ASSERT_EQ(RecordView::encoded_len(Key{-7}, page_id_t(33)),
+                  materialized.len());
+    }
+    // a record beyond the page, as a torn read sees it.
+    {
+        RecordView::write(page, Key{1}, page_id_t(1));
+        ASSERT_THROW(RecordView(page, RecordView::HDR_LEN), std::out_of_range);
+        ASSERT_THROW(RecordView(page, 2), std::out_of_range);
+    }
+}
+
+TEST(RecordTest, NormalizedKeyTest) {
+    auto check_order = [](const std::vector<Key> &sorted) {
+        for (size_t i = 0; i < sorted.size(); i++) {
+            NormalizedKey key(sorted[i]);
+            ASSERT_EQ(sorted[i],
+                      NormalizedKey::decode(key.type(), key.bytes()));
+            for (size_t j = 0; j < sorted.size(); j++) {
+                NormalizedKey other(sorted[j]);
+                int cmp = NormalizedKey::compare(key.bytes(), other.bytes());
+                ASSERT_EQ(i < j, cmp < 0) << i << " vs " << j;
+                ASSERT_EQ(i == j, cmp == 0) << i << " vs " << j;
+            }
+        }
+    };
+
+    check_order({std::numeric_limits<int>::min(), -70000, -1, 0, 1, 255, 256,
+                 std::numeric_limits<int>::max()});
+    check_order({-std::numeric_limits<double>::infinity(), -1e10, -1.5,
+                 -std::numeric_limits<double>::denorm_min(), 0.0, 1e-300, 1.5,
+                 1e10, std::numeric_limits<double>::infinity()});
+    check_order({std::string(""), std::string("\0", 1), std::string("\0a", 2),
+                 std::string("a"), std::string("a\0", 2),
+                 std::string("a\0\0", 3), std::string("a\x01"),
+                 std::string("ab"), std::string("b"), std::string("\xff")});
+
+    // (tenant asc, time desc, event asc), a prefix before the keys it's a
+    // prefix of.
+    auto key = [](std::vector<KeyColumn> columns) {
+        std::vector<KeyOrder> orders = {KeyOrder::Asc, KeyOrder::Desc,
+                                        KeyOrder::Asc};
+        orders.resize(columns.size());
+        return Key{CompositeKey(std::move(columns), std::move(orders))};
+    };
+    check_order({key({}), key({-1}), key({-1, 2.5}), key({-1, 2.5, "a"}),
+                 key({-1, -3.0, std::string("")}), key({7}),
+                 key({7, 1e9, "z"}), key({7, 0.0}), key({7, 0.0, "a"}),
+                 key({7, 0.0, std::string("a\0", 2)}), key({7, 0.0, "ab"}),
+                 key({7, -1.0, "a"}), key({8, 5.0, "a"})});
+
+    // -0.0 == 0.0
+    ASSERT_EQ(NormalizedKey(Key{-0.0}).bytes(),
+              NormalizedKey(Key{0.0}).bytes());
+
+    // separators
+    ASSERT_EQ(Key{"abx"}, NormalizedKey::separator(Key{"abcd"}, Key{"abxy"}));
+    ASSERT_EQ(Key{"abc"}, NormalizedKey::separator(Key{"ab"}, Key{"abcd"}));
+    ASSERT_EQ(Key{7}, NormalizedKey::separator(Key{3}, Key{7}));
+    ASSERT_EQ(key({7, 0.0}), NormalizedKey::separator(key({7, 1.0, "z"}),
+                                                      key({7, 0.0, "a"})));
+    ASSERT_EQ(key({7, 0.0, "ab"}),
+              NormalizedKey::separator(key({7, 0.0, "aa"}),
+                                       key({7, 0.0, "abc"})));
+    ASSERT_EQ(key({8}), NormalizedKey::separator(key({7}), key({8, 5.0})));
+}